@@ -0,0 +1,219 @@
+#include "bgzfcompressor.h"
+#include "bgzfdecompressor.h"
+#include "util.h"
+#include <string.h>
+#include <functional>
+#ifdef DYNAMIC_ZLIB
+  #include <zlib.h>
+#else
+  #include "zlib/zlib.h"
+#endif
+
+// uncompressed bytes per member, as bgzip uses, so that even stored data fits the 16 bit BSIZE
+static const size_t BGZF_BLOCK_LEN = 0xff00;
+static const size_t BGZF_MAX_MEMBER_LEN = 0x10000;
+// gzip header with FEXTRA, then the 'BC' subfield holding BSIZE, the member size minus 1
+static const size_t BGZF_HEADER_LEN = 18;
+static const size_t GZIP_TRAILER_LEN = 8;
+static const unsigned char BGZF_HEADER[BGZF_HEADER_LEN] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0};
+// an empty member marks the end of a BGZF file
+static const unsigned char BGZF_EOF[28] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static inline void writeLE32(unsigned char* p, unsigned int v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+BgzfCompressor::BgzfCompressor(string filename, int level, int threads) {
+    mFilename = filename;
+    mLevel = level;
+    mFailed = false;
+    mStop = false;
+    mFile = fopen(filename.c_str(), "wb");
+    if (mFile == NULL)
+        error_exit("Can not open file to write: " + filename);
+    if (threads < 1)
+        threads = 1;
+    // enough blocks ahead to keep every worker busy while the oldest one is written
+    mMaxInFlight = threads * 4;
+    mCurrent = new Block;
+    mCurrent->in.reserve(BGZF_BLOCK_LEN);
+    mCurrent->done = false;
+    for (int t = 0; t < threads; t++) {
+        mWorkers.push_back(new thread(std::bind(&BgzfCompressor::workerTask, this)));
+    }
+}
+
+BgzfCompressor::~BgzfCompressor() {
+    close();
+}
+
+bool BgzfCompressor::write(const char* data, size_t size) {
+    while (size > 0) {
+        size_t len = min(size, BGZF_BLOCK_LEN - mCurrent->in.size());
+        mCurrent->in.append(data, len);
+        data += len;
+        size -= len;
+        if (mCurrent->in.size() == BGZF_BLOCK_LEN)
+            queueBlock();
+    }
+    return !mFailed;
+}
+
+void BgzfCompressor::queueBlock() {
+    Block* block = mCurrent;
+    mCurrent = new Block;
+    mCurrent->in.reserve(BGZF_BLOCK_LEN);
+    mCurrent->done = false;
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mInFlight.push_back(block);
+        mQueue.push_back(block);
+    }
+    mWorkReady.notify_one();
+    writeDone(false);
+}
+
+// writes the compressed blocks at the front, waiting for them while too many are in flight, or for all if wait
+bool BgzfCompressor::writeDone(bool wait) {
+    while (true) {
+        Block* block = NULL;
+        {
+            std::unique_lock<std::mutex> lock(mMtx);
+            if (mInFlight.empty())
+                break;
+            if (wait || mInFlight.size() > mMaxInFlight)
+                mBlockDone.wait(lock, [this] {return mInFlight.front()->done;});
+            if (!mInFlight.front()->done)
+                break;
+            block = mInFlight.front();
+            mInFlight.pop_front();
+        }
+        if (fwrite(block->out.data(), 1, block->out.size(), mFile) != block->out.size())
+            mFailed = true;
+        delete block;
+    }
+    return !mFailed;
+}
+
+void BgzfCompressor::workerTask() {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // raw deflate, the gzip framing of each member is written by compressBlock
+    if (deflateInit2(&stream, mLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        error_exit("Failed to set up compression for file: " + mFilename);
+    while (true) {
+        Block* block = NULL;
+        {
+            std::unique_lock<std::mutex> lock(mMtx);
+            mWorkReady.wait(lock, [this] {return mStop || !mQueue.empty();});
+            if (mQueue.empty())
+                break;
+            block = mQueue.front();
+            mQueue.pop_front();
+        }
+        compressBlock(block, &stream, mLevel);
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            block->done = true;
+        }
+        mBlockDone.notify_all();
+    }
+    deflateEnd(&stream);
+}
+
+void BgzfCompressor::compressBlock(Block* block, void* zstream, int level) {
+    z_stream* stream = (z_stream*) zstream;
+    const string& in = block->in;
+    block->out.resize(BGZF_MAX_MEMBER_LEN);
+    unsigned char* out = (unsigned char*) &block->out[0];
+    size_t room = BGZF_MAX_MEMBER_LEN - BGZF_HEADER_LEN - GZIP_TRAILER_LEN;
+    deflateReset(stream);
+    deflateParams(stream, level, Z_DEFAULT_STRATEGY);
+    stream->next_in = (Bytef*) in.data();
+    stream->avail_in = in.size();
+    stream->next_out = out + BGZF_HEADER_LEN;
+    stream->avail_out = room;
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+        // data that does not compress is stored, which always fits
+        deflateReset(stream);
+        deflateParams(stream, 0, Z_DEFAULT_STRATEGY);
+        stream->next_in = (Bytef*) in.data();
+        stream->avail_in = in.size();
+        stream->next_out = out + BGZF_HEADER_LEN;
+        stream->avail_out = room;
+        deflate(stream, Z_FINISH);
+    }
+    size_t total = BGZF_HEADER_LEN + (room - stream->avail_out) + GZIP_TRAILER_LEN;
+    memcpy(out, BGZF_HEADER, BGZF_HEADER_LEN);
+    out[16] = (total - 1) & 0xff;
+    out[17] = ((total - 1) >> 8) & 0xff;
+    unsigned char* trailer = out + total - GZIP_TRAILER_LEN;
+    writeLE32(trailer, crc32(crc32(0L, Z_NULL, 0), (const Bytef*) in.data(), in.size()));
+    writeLE32(trailer + 4, in.size());
+    block->out.resize(total);
+    block->in.clear();
+}
+
+bool BgzfCompressor::close() {
+    if (mFile == NULL)
+        return !mFailed;
+    if (!mCurrent->in.empty())
+        queueBlock();
+    writeDone(true);
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mStop = true;
+    }
+    mWorkReady.notify_all();
+    for (auto & t : mWorkers) {
+        t->join();
+        delete t;
+    }
+    mWorkers.clear();
+    delete mCurrent;
+    mCurrent = NULL;
+    if (fwrite(BGZF_EOF, 1, sizeof(BGZF_EOF), mFile) != sizeof(BGZF_EOF))
+        mFailed = true;
+    fclose(mFile);
+    mFile = NULL;
+    return !mFailed;
+}
+
+bool BgzfCompressor::test() {
+    // a few blocks of text, with an incompressible stretch that has to be stored
+    string data;
+    for (int i = 0; i < 20000; i++)
+        data += "@read" + to_string(i) + "\nACGTTGCAACGGTACCATGA\n+\nIIIIIIIIIIIIIIIIIIII\n";
+    unsigned int x = 12345;
+    for (int i = 0; i < 100000; i++) {
+        x = x * 1103515245 + 12345;
+        data += (char) (x >> 16);
+    }
+    string filename = "/tmp/seq2fun_bgzf_test_" + to_string(rand()) + ".gz";
+    BgzfCompressor* compressor = new BgzfCompressor(filename, 4, 3);
+    // uneven pieces, so that writes cross the block boundaries
+    size_t pos = 0, piece = 1;
+    while (pos < data.size()) {
+        size_t len = min(piece, data.size() - pos);
+        compressor->write(data.data() + pos, len);
+        pos += len;
+        piece = piece * 7 % 100003 + 1;
+    }
+    bool passed = compressor->close();
+    delete compressor;
+
+    passed &= BgzfDecompressor::isBgzf(filename);
+    gzFile in = gzopen(filename.c_str(), "rb");
+    string back;
+    char buf[65536];
+    int len = 0;
+    while (in && (len = gzread(in, buf, sizeof(buf))) > 0)
+        back.append(buf, len);
+    if (in)
+        gzclose(in);
+    remove(filename.c_str());
+    return passed && back == data;
+}
@@ -0,0 +1,61 @@
+#ifndef BGZF_COMPRESSOR_H
+#define BGZF_COMPRESSOR_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// writes a .gz file as BGZF: the data is cut into blocks of at most 64KB that a pool of threads
+// compresses into independent gzip members carrying their size in a 'BC' extra field.
+// the members are written in order, so gunzip reads the file as usual, and it can be
+// indexed for random access like the output of bgzip
+class BgzfCompressor {
+public:
+    BgzfCompressor(string filename, int level, int threads);
+    ~BgzfCompressor();
+
+    bool write(const char* data, size_t size);
+    // compresses and writes what is left, then the empty EOF member, and closes the file
+    bool close();
+
+    static bool test();
+
+private:
+    struct Block {
+        string in;
+        string out;
+        bool done;
+    };
+
+    void queueBlock();
+    bool writeDone(bool wait);
+    void workerTask();
+    static void compressBlock(Block* block, void* stream, int level);
+
+private:
+    FILE* mFile;
+    string mFilename;
+    int mLevel;
+    bool mFailed;
+    // the block being filled by write()
+    Block* mCurrent;
+    // blocks in file order, waiting for their compression or to be written
+    deque<Block*> mInFlight;
+    size_t mMaxInFlight;
+    // blocks no worker took yet
+    deque<Block*> mQueue;
+
+    vector<thread*> mWorkers;
+    mutex mMtx;
+    condition_variable mWorkReady;
+    condition_variable mBlockDone;
+    bool mStop;
+};
+
+#endif
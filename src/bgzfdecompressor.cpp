@@ -0,0 +1,218 @@
+#include "bgzfdecompressor.h"
+#include "util.h"
+#include "uringreader.h"
+#include <string.h>
+#include <functional>
+#ifdef DYNAMIC_ZLIB
+  #include <zlib.h>
+#else
+  #include "zlib/zlib.h"
+#endif
+
+// gzip member header: ID1 ID2 CM FLG MTIME(4) XFL OS XLEN(2), then XLEN bytes of extra subfields
+static const size_t GZIP_HEADER_LEN = 12;
+// CRC32 and ISIZE
+static const size_t GZIP_TRAILER_LEN = 8;
+
+static inline unsigned int readLE16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline unsigned int readLE32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+// the BSIZE of the 'BC' subfield, total member size minus 1, or -1 if there is none
+static long findBlockSize(const unsigned char* extra, size_t xlen) {
+    size_t i = 0;
+    while (i + 4 <= xlen) {
+        unsigned int slen = readLE16(extra + i + 2);
+        if (extra[i] == 'B' && extra[i + 1] == 'C' && slen == 2 && i + 6 <= xlen)
+            return readLE16(extra + i + 4);
+        i += 4 + slen;
+    }
+    return -1;
+}
+
+static inline bool isGzipWithExtra(const unsigned char* header) {
+    return header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4);
+}
+
+BgzfDecompressor::BgzfDecompressor(FILE* file, string filename, int threads, UringReader* uring) {
+    mFile = file;
+    mUring = uring;
+    mFilename = filename;
+    mInTotal = 0;
+    mOut = NULL;
+    mMembers = 0;
+    mNextMember = 0;
+    mPendingMembers = 0;
+    mFailed = false;
+    mGeneration = 0;
+    mStop = false;
+    // the calling thread inflates too
+    for (int t = 1; t < threads; t++) {
+        mWorkers.push_back(new thread(std::bind(&BgzfDecompressor::workerTask, this)));
+    }
+}
+
+BgzfDecompressor::~BgzfDecompressor() {
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mStop = true;
+    }
+    mWorkReady.notify_all();
+    for (auto & t : mWorkers) {
+        t->join();
+        delete t;
+    }
+    mWorkers.clear();
+}
+
+bool BgzfDecompressor::isBgzf(string filename) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+    unsigned char header[GZIP_HEADER_LEN];
+    bool bgzf = false;
+    if (fread(header, 1, GZIP_HEADER_LEN, fp) == GZIP_HEADER_LEN && isGzipWithExtra(header)) {
+        size_t xlen = readLE16(header + 10);
+        vector<unsigned char> extra(xlen);
+        if (fread(extra.data(), 1, xlen, fp) == xlen)
+            bgzf = findBlockSize(extra.data(), xlen) >= 0;
+    }
+    fclose(fp);
+    return bgzf;
+}
+
+size_t BgzfDecompressor::readInput(unsigned char* buf, size_t len) {
+    if (mUring)
+        return mUring->read((char*) buf, len);
+    return fread(buf, 1, len, mFile);
+}
+
+bool BgzfDecompressor::readMember() {
+    size_t start = mIn.size();
+    mIn.resize(start + GZIP_HEADER_LEN);
+    size_t readLen = readInput(mIn.data() + start, GZIP_HEADER_LEN);
+    if (readLen == 0) {
+        mIn.resize(start);
+        return false;
+    }
+    if (readLen < GZIP_HEADER_LEN || !isGzipWithExtra(mIn.data() + start))
+        error_exit("Truncated or non-BGZF gzip member in file: " + mFilename);
+
+    size_t xlen = readLE16(mIn.data() + start + 10);
+    mIn.resize(start + GZIP_HEADER_LEN + xlen);
+    if (readInput(mIn.data() + start + GZIP_HEADER_LEN, xlen) != xlen)
+        error_exit("Truncated BGZF block in file: " + mFilename);
+    long bsize = findBlockSize(mIn.data() + start + GZIP_HEADER_LEN, xlen);
+    size_t memberLen = bsize + 1;
+    if (bsize < 0 || memberLen < GZIP_HEADER_LEN + xlen + GZIP_TRAILER_LEN)
+        error_exit("Missing or invalid BGZF block size in file: " + mFilename);
+
+    size_t rest = memberLen - GZIP_HEADER_LEN - xlen;
+    mIn.resize(start + memberLen);
+    if (readInput(mIn.data() + start + GZIP_HEADER_LEN + xlen, rest) != rest)
+        error_exit("Truncated BGZF block in file: " + mFilename);
+    mInTotal += memberLen;
+
+    // ISIZE tells where the next member's output starts before anything is inflated
+    unsigned int isize = readLE32(mIn.data() + start + memberLen - 4);
+    mInOffsets.push_back(start);
+    mOutOffsets.push_back(mOutOffsets.back() + isize);
+    return true;
+}
+
+bool BgzfDecompressor::inflateMember(size_t i, char* out) {
+    const unsigned char* member = mIn.data() + mInOffsets[i];
+    size_t memberLen = (i + 1 < mInOffsets.size() ? mInOffsets[i + 1] : mIn.size()) - mInOffsets[i];
+    size_t xlen = readLE16(member + 10);
+    size_t outLen = mOutOffsets[i + 1] - mOutOffsets[i];
+    const unsigned char* trailer = member + memberLen - GZIP_TRAILER_LEN;
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // raw deflate data, the gzip header and trailer are handled here
+    if (inflateInit2(&strm, -15) != Z_OK)
+        return false;
+    strm.next_in = (Bytef*) (member + GZIP_HEADER_LEN + xlen);
+    strm.avail_in = (uInt) (trailer - strm.next_in);
+    strm.next_out = (Bytef*) (out + mOutOffsets[i]);
+    strm.avail_out = (uInt) outLen;
+    int ret = inflate(&strm, Z_FINISH);
+    bool ok = ret == Z_STREAM_END && strm.total_out == outLen;
+    inflateEnd(&strm);
+    if (ok && crc32(crc32(0L, Z_NULL, 0), (const Bytef*) (out + mOutOffsets[i]), (uInt) outLen) != readLE32(trailer))
+        ok = false;
+    return ok;
+}
+
+void BgzfDecompressor::inflateBatch() {
+    while (true) {
+        // take the next member only while a batch is published, a worker that wakes up late
+        // must not take members of a batch that is not completely set up
+        size_t i = mNextMember.load();
+        do {
+            if (i >= mMembers.load())
+                return;
+        } while (!mNextMember.compare_exchange_weak(i, i + 1));
+
+        if (!inflateMember(i, mOut))
+            mFailed = true;
+        if (--mPendingMembers == 0) {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mBatchDone.notify_one();
+        }
+    }
+}
+
+void BgzfDecompressor::workerTask() {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMtx);
+            mWorkReady.wait(lock, [&] { return mStop || mGeneration != seen; });
+            if (mStop)
+                return;
+            seen = mGeneration;
+        }
+        inflateBatch();
+    }
+}
+
+size_t BgzfDecompressor::decompress(vector<char>& out, size_t targetLen) {
+    mIn.clear();
+    mInOffsets.clear();
+    mOutOffsets.clear();
+    mOutOffsets.push_back(0);
+    while (mOutOffsets.back() < targetLen && readMember()) {
+    }
+    size_t members = mInOffsets.size();
+    size_t outLen = mOutOffsets.back();
+    if (members == 0)
+        return 0;
+    if (out.size() < outLen)
+        out.resize(outLen);
+
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mOut = out.data();
+        mFailed = false;
+        mPendingMembers = members;
+        mNextMember = 0;
+        // publishing the member count hands out the members, everything above is visible to whoever takes one
+        mMembers = members;
+        mGeneration++;
+    }
+    mWorkReady.notify_all();
+    inflateBatch();
+    {
+        std::unique_lock<std::mutex> lock(mMtx);
+        mBatchDone.wait(lock, [this] { return mPendingMembers == 0; });
+        mMembers = 0;
+    }
+    if (mFailed)
+        error_exit("Failed to decompress BGZF block in file: " + mFilename);
+    return outLen;
+}
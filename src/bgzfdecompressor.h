@@ -0,0 +1,64 @@
+#ifndef BGZF_DECOMPRESSOR_H
+#define BGZF_DECOMPRESSOR_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+class UringReader;
+
+// BGZF files are a series of independent gzip members that each carry their
+// compressed size in a 'BC' extra field, so a batch of members can be located
+// up front and inflated in parallel into precomputed output offsets.
+class BgzfDecompressor {
+public:
+    // the compressed data comes from uring when it is given, from file otherwise
+    BgzfDecompressor(FILE* file, string filename, int threads, UringReader* uring = NULL);
+    ~BgzfDecompressor();
+
+    // decompress the next members, at least targetLen bytes unless the file ends, into out.
+    // returns the decompressed length, 0 at the end of the file
+    size_t decompress(vector<char>& out, size_t targetLen);
+    // compressed bytes consumed so far
+    inline size_t compressedOffset() {return mInTotal;}
+
+    static bool isBgzf(string filename);
+
+private:
+    size_t readInput(unsigned char* buf, size_t len);
+    bool readMember();
+    bool inflateMember(size_t i, char* out);
+    void inflateBatch();
+    void workerTask();
+
+private:
+    FILE* mFile;
+    UringReader* mUring;
+    string mFilename;
+    size_t mInTotal;
+
+    // the current batch: compressed members back to back, and where each one starts and decompresses to
+    vector<unsigned char> mIn;
+    vector<size_t> mInOffsets;
+    vector<size_t> mOutOffsets;
+    char* mOut;
+    atomic<size_t> mMembers;
+    atomic<size_t> mNextMember;
+    atomic<size_t> mPendingMembers;
+    atomic<bool> mFailed;
+
+    vector<thread*> mWorkers;
+    mutex mMtx;
+    condition_variable mWorkReady;
+    condition_variable mBatchDone;
+    size_t mGeneration;
+    bool mStop;
+};
+
+#endif
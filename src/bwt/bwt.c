@@ -188,11 +188,24 @@ static SI *alloc_SI(IndexType *si, int query_pos, int query_len){
 
 
 
+/* Frees the whole next/samelen tree without recursion: a samelen child is
+	 rotated up in front of its parent (linked through its next pointer) until
+	 the current node has none, then the node is freed and we move on to next. */
 void recursive_free_SI(SI *si) {
-	if (!si) return;
-	if (si->next) recursive_free_SI(si->next);
-	if (si->samelen) recursive_free_SI(si->samelen);
-	free(si);
+	SI *tmp;
+	while (si) {
+		if (si->samelen) {
+			tmp = si->samelen;
+			si->samelen = tmp->next;
+			tmp->next = si;
+			si = tmp;
+		}
+		else {
+			tmp = si->next;
+			free(si);
+			si = tmp;
+		}
+	}
 }
 
 
@@ -2,6 +2,7 @@
 
 BwtFmiDB::BwtFmiDB(Options * & opt) {
     mOptions = opt;
+    tnuma = NULL;
     init();
 }
 
@@ -17,6 +18,11 @@ BwtFmiDB::~BwtFmiDB() {
         tbwt = NULL;
     }
 
+    if (tnuma) {
+        delete tnuma;
+        tnuma = NULL;
+    }
+
     if (tastruct->trans) free(tastruct->trans);
     if (tastruct->a) free(tastruct->a);
     if (tastruct) free(tastruct);
@@ -37,6 +43,15 @@ void BwtFmiDB::init() {
         Transsearch = true;
         fclose(tfile);
         tfmi = tbwt->f;
+
+        NumaIndex::Mode numaMode = NumaIndex::NUMA_OFF;
+        NumaIndex::parseMode(mOptions->numa, numaMode);
+        tnuma = new NumaIndex(numaMode);
+        tnuma->place(tfmi, tbwt->s);
+        if (mOptions->verbose || numaMode != NumaIndex::NUMA_OFF) {
+            std::string msg = tnuma->describe();
+            mOptions->longlog ? loginfolong(msg) : loginfo(msg);
+        }
         //if (mOptions->verbose) {
             std::stringstream msgs;
             msgs << "Protein (trans search) BWT of length " << tbwt->len << " has been read with " << tbwt->nseq << " sequences, alphabet = " << tbwt->alphabet;
@@ -51,6 +66,14 @@ void BwtFmiDB::init() {
 
         tastruct = alloc_AlphabetStruct(tbwt->alphabet, 0, 0);
 
+        // looked up once here, so the searchers vote by sequence number
+        tseqOrth.assign(tbwt->s->nseq, -1);
+        for (int i = 0; i < tbwt->s->nseq; i++) {
+            auto itd = mOptions->db->idDbMap.find(tbwt->s->ids[i]);
+            if (itd != mOptions->db->idDbMap.end())
+                tseqOrth[i] = itd->second;
+        }
+
         //need to be conformed.
         if (mOptions->transSearch.SEG) {
             tblast_seg_params = SegParametersNewAa(); //need to be conformed;
@@ -9,6 +9,7 @@
 
 #include "util.h"
 #include "options.h"
+#include "numaindex.h"
 
 #include "include/ncbi-blast+/algo/blast/core/blast_seg.h"
 #include "include/ncbi-blast+/algo/blast/core/blast_filter.h"
@@ -32,7 +33,11 @@ public:
     AlphabetStruct * tastruct;
     SegParameters * tblast_seg_params;
     double tdb_length;
+    // the index in db->orthIdVec of the ortholog of each sequence, -1 where its id is not in the gene map
+    std::vector<int> tseqOrth;
     bool Transsearch;
+    // where the index lives on NUMA machines and which copy each worker searches
+    NumaIndex * tnuma;
     
 private:
     void init();
@@ -30,14 +30,31 @@ const char ATCG_BASES[] = {'A', 'T', 'C', 'G'};
 // error may happen if it generates more packs than this number
 static const int PACK_NUM_LIMIT  = 10000000; 
 
-// how many reads one pack has
+// how many reads one pack has at the start, PackSizer then sizes the packs between
+// PACK_SIZE_MIN and PACK_SIZE_MAX so that each takes about PACK_TARGET_SECONDS of worker time
 static const int PACK_SIZE = 1000;//1000000
+static const int PACK_SIZE_MIN = 250;
+static const int PACK_SIZE_MAX = 4000;
+static const double PACK_TARGET_SECONDS = 0.05;
 
 // if one pack is produced, but not consumed, it will be kept in the memory
-// this number limit the number of in memory packs
+// this number limit the number of in memory packs, counted in packs of PACK_SIZE reads
 // if the number of in memory packs is full, the producer thread should sleep
 static const int PACK_IN_MEM_LIMIT = 80;//500000
 
+// how many fragments each worker keeps in its SEG result cache, MemoryPlan may lower it
+static const int SEG_CACHE_LIMIT = 100000;
+
+// paired-end mates are parsed ahead by their own threads in chunks of this many reads,
+// holding at most MATE_QUEUE_DEPTH chunks per mate
+static const int MATE_CHUNK_SIZE = 1000;
+static const int MATE_QUEUE_DEPTH = 16;
+// the names of the first pair and of every pair at this interval are checked to match
+static const int MATE_CHECK_INTERVAL = 1024;
+
+// the search stage of a pack is split into tasks of this many reads, which idle worker threads can steal
+static const int SEARCH_TASK_SIZE = 250;
+
 // if read number is more than this, warn it
 static const int WARN_STANDALONE_READ_LIMIT = 500000;//5000000
 
@@ -52,6 +69,8 @@ static const int FAIL_LENGTH = 16;
 static const int FAIL_TOO_LONG = 17;
 static const int FAIL_QUALITY = 20;
 static const int FAIL_COMPLEXITY = 24;
+// not a filter result, marks the reads dropped by the index filter before the others were applied
+static const int FILTERED_BY_INDEX = -1;
 
 // how many types in total we support
 static const int FILTER_RESULT_TYPES = 32;
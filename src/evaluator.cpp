@@ -7,77 +7,143 @@
 
 Evaluator::Evaluator(Options* & opt){
     mOptions = opt;
+    mIn1 = opt->in1;
+    mIn2 = opt->in2;
+    mKeepReads = opt->shallDetectAdapter(false) || opt->shallDetectAdapter(true) || opt->overRepAnalysis.enabled;
+    mSample1 = NULL;
+    mSample2 = NULL;
 }
 
 
 Evaluator::~Evaluator(){
-}
-
-bool Evaluator::isTwoColorSystem() {
-    FastqReader reader(mOptions->in1);
-
-    Read* r = reader.read();
-
-    if(!r)
-        return false;
-
-    // NEXTSEQ500, NEXTSEQ 550, NOVASEQ
-    if(starts_with(r->mName, "@NS") || starts_with(r->mName, "@NB") || starts_with(r->mName, "@NDX") || starts_with(r->mName, "@A0")) {
-        delete r;
-        return true;
+    EvaluationSample* samples[2] = {mSample1, mSample2};
+    for(int s=0; s<2; s++) {
+        if(!samples[s])
+            continue;
+        for(size_t i=0; i<samples[s]->reads.size(); i++)
+            delete samples[s]->reads[i];
+        delete samples[s];
     }
-
-    delete r;
-    return false;
 }
 
-void Evaluator::evaluateSeqLen() {
-    if(!mOptions->in1.empty())
-        mOptions->seqLen1 = computeSeqLen(mOptions->in1);
-    if(!mOptions->in2.empty())
-        mOptions->seqLen2 = computeSeqLen(mOptions->in2);
+void Evaluator::loadSamples() {
+    if(mSample1)
+        return;
+    mSample1 = new EvaluationSample;
+    if(!mIn1.empty())
+        loadSample(mIn1, mSample1);
+    mSample2 = new EvaluationSample;
+    if(!mIn2.empty())
+        loadSample(mIn2, mSample2);
 }
 
-int Evaluator::computeSeqLen(string filename) {
+// one pass over the head of the file, stopping where the last evaluation would have stopped reading it
+void Evaluator::loadSample(string filename, EvaluationSample* sample) {
     FastqReader reader(filename);
 
+    const long SEQLEN_READ_LIMIT = 1000000;
+    const long ADAPTER_READ_LIMIT = 256*1024;
+    const long ADAPTER_BASE_LIMIT = 151 * ADAPTER_READ_LIMIT;
+    const long READNUM_READ_LIMIT = 512*1024;
+    const long READNUM_BASE_LIMIT = 151 * 512*1024;
+    const long OVERREP_BASE_LIMIT = 151 * 10000;
+
     long records = 0;
-    bool reachedEOF = false;
+    long bases = 0;
+    size_t firstReadPos = 0;
+    size_t bytesRead;
+    size_t bytesTotal;
+    bool adapterDone = false;
+    bool readNumDone = false;
+
+    sample->adapterRecords = 0;
+    sample->seqLen = 0;
+    sample->adapterReadNum = 0;
+    sample->readNum = 0;
+
+    while(true) {
+        bool seqLenActive = records < SEQLEN_READ_LIMIT;
+        bool adapterActive = !adapterDone && records < ADAPTER_READ_LIMIT && bases < ADAPTER_BASE_LIMIT;
+        bool readNumActive = !readNumDone && records < READNUM_READ_LIMIT && bases < READNUM_BASE_LIMIT;
+        bool overRepActive = bases < OVERREP_BASE_LIMIT;
+
+        // a limit is reached, estimate the read number from the compressed bytes used so far
+        if((!adapterDone && !adapterActive) || (!readNumDone && !readNumActive)) {
+            long estimate = 0;
+            if(records > 0) {
+                reader.getBytes(bytesRead, bytesTotal);
+                double bytesPerRead = (double)(bytesRead - firstReadPos) / (double) records;
+                // increase it by 1% since the evaluation is usually a bit lower due to bad quality causes lower compression rate
+                estimate = (long) (bytesTotal*1.01 / bytesPerRead);
+            }
+            if(!adapterDone && !adapterActive) {
+                sample->adapterReadNum = estimate;
+                adapterDone = true;
+            }
+            if(!readNumDone && !readNumActive) {
+                sample->readNum = estimate;
+                readNumDone = true;
+            }
+        }
+        if(!seqLenActive && !adapterActive && !readNumActive && !overRepActive)
+            break;
 
-    // get seqlen
-    int seqlen=0;
-    while(records < 1000000) {
         Read* r = reader.read();
         if(!r) {
-            reachedEOF = true;
+            if(!adapterDone)
+                sample->adapterReadNum = records;
+            if(!readNumDone)
+                sample->readNum = records;
             break;
         }
+        if(records == 0) {
+            reader.getBytes(bytesRead, bytesTotal);
+            firstReadPos = bytesRead;
+            sample->firstName = r->mName;
+        }
         int rlen = r->length();
-        if(rlen > seqlen)
-            seqlen = rlen;
-        records ++;
-        delete r;
+        if(seqLenActive && rlen > sample->seqLen)
+            sample->seqLen = rlen;
+        bases += rlen;
+        records++;
+        if(mKeepReads && (adapterActive || overRepActive)) {
+            sample->reads.push_back(r);
+            if(adapterActive)
+                sample->adapterRecords++;
+        } else {
+            delete r;
+        }
     }
+}
 
-    return seqlen;
+bool Evaluator::isTwoColorSystem() {
+    loadSamples();
+    const string& name = mSample1->firstName;
+
+    // NEXTSEQ500, NEXTSEQ 550, NOVASEQ
+    if(starts_with(name, "@NS") || starts_with(name, "@NB") || starts_with(name, "@NDX") || starts_with(name, "@A0"))
+        return true;
+
+    return false;
 }
 
-void Evaluator::computeOverRepSeq(string filename, map<string, long>& hotseqs, int seqlen) {
-    FastqReader reader(filename);
+void Evaluator::evaluateSeqLen() {
+    loadSamples();
+    if(!mIn1.empty())
+        mOptions->seqLen1 = mSample1->seqLen;
+    if(!mIn2.empty())
+        mOptions->seqLen2 = mSample2->seqLen;
+}
 
+void Evaluator::computeOverRepSeq(EvaluationSample* sample, map<string, long>& hotseqs, int seqlen) {
     map<string, long> seqCounts;
 
     const long BASE_LIMIT = 151 * 10000;
-    long records = 0;
+    size_t records = 0;
     long bases = 0;
-    bool reachedEOF = false;
 
-    while(bases < BASE_LIMIT) {
-        Read* r = reader.read();
-        if(!r) {
-            reachedEOF = true;
-            break;
-        }
+    while(bases < BASE_LIMIT && records < sample->reads.size()) {
+        Read* r = sample->reads[records];
         int rlen = r->length();
         bases += rlen;
         records ++;
@@ -95,8 +161,6 @@ void Evaluator::computeOverRepSeq(string filename, map<string, long>& hotseqs, i
                     seqCounts[seq]=1;
             }
         }
-
-        delete r;
     }
     
     map<string, long>::iterator iter;
@@ -156,52 +220,16 @@ void Evaluator::computeOverRepSeq(string filename, map<string, long>& hotseqs, i
 }
 
 void Evaluator::evaluateOverRepSeqs() {
-    if(!mOptions->in1.empty())
-        computeOverRepSeq(mOptions->in1, mOptions->overRepSeqs1, mOptions->seqLen1);
-    if(!mOptions->in2.empty())
-        computeOverRepSeq(mOptions->in2, mOptions->overRepSeqs2, mOptions->seqLen2);
+    loadSamples();
+    if(!mIn1.empty())
+        computeOverRepSeq(mSample1, mOptions->overRepSeqs1, mOptions->seqLen1);
+    if(!mIn2.empty())
+        computeOverRepSeq(mSample2, mOptions->overRepSeqs2, mOptions->seqLen2);
 }
 
 void Evaluator::evaluateReadNum(long& readNum) {
-    FastqReader reader(mOptions->in1);
-
-    const long READ_LIMIT = 512*1024;
-    const long BASE_LIMIT = 151 * 512*1024;
-    long records = 0;
-    long bases = 0;
-    size_t firstReadPos = 0;
-
-    size_t bytesRead;
-    size_t bytesTotal;
-
-    bool reachedEOF = false;
-    bool first = true;
-    while(records < READ_LIMIT && bases < BASE_LIMIT) {
-        Read* r = reader.read();
-        if(!r) {
-            reachedEOF = true;
-            break;
-        }
-        if(first) {
-            reader.getBytes(bytesRead, bytesTotal);
-            firstReadPos = bytesRead;
-            first = false;
-        }
-        records++;
-        bases += r->length();
-        delete r;
-    }
-
-    readNum = 0;
-    if(reachedEOF){
-        readNum = records;
-    } else if(records>0) {
-        // by the way, update readNum so we don't need to evaluate it if splitting output is enabled
-        reader.getBytes(bytesRead, bytesTotal);
-        double bytesPerRead = (double)(bytesRead - firstReadPos) / (double) records;
-        // increase it by 1% since the evaluation is usually a bit lower due to bad quality causes lower compression rate
-        readNum = (long) (bytesTotal*1.01 / bytesPerRead);
-    }
+    loadSamples();
+    readNum = mSample1->readNum;
 }
 
 // Depreciated
@@ -408,60 +436,15 @@ string Evaluator::evalAdapterAndReadNumDepreciated(long& readNum) {
 }
 
 string Evaluator::evalAdapterAndReadNum(long& readNum, bool isR2) {
-    string filename = mOptions->in1;
-    if(isR2)
-        filename = mOptions->in2;
-    FastqReader reader(filename);
-    // stat up to 256K reads
-    const long READ_LIMIT = 256*1024;
-    const long BASE_LIMIT = 151 * READ_LIMIT;
-    long records = 0;
-    long bases = 0;
-    size_t firstReadPos = 0;
-
-    size_t bytesRead;
-    size_t bytesTotal;
-
-    Read** loadedReads = new Read*[READ_LIMIT];
-    memset(loadedReads, 0, sizeof(Read*)*READ_LIMIT);
-    bool reachedEOF = false;
-    bool first = true;
-
-    while(records < READ_LIMIT && bases < BASE_LIMIT) {
-        Read* r = reader.read();
-        if(!r) {
-            reachedEOF = true;
-            break;
-        }
-        if(first) {
-            reader.getBytes(bytesRead, bytesTotal);
-            firstReadPos = bytesRead;
-            first = false;
-        }
-        int rlen = r->length();
-        bases += rlen;
-        loadedReads[records] = r;
-        records++;
-    }
-
-    readNum = 0;
-    if(reachedEOF){
-        readNum = records;
-    } else if(records>0) {
-        // by the way, update readNum so we don't need to evaluate it if splitting output is enabled
-        reader.getBytes(bytesRead, bytesTotal);
-        double bytesPerRead = (double)(bytesRead - firstReadPos) / (double) records;
-        // increase it by 1% since the evaluation is usually a bit lower due to bad quality causes lower compression rate
-        readNum = (long) (bytesTotal*1.01 / bytesPerRead);
-    }
+    loadSamples();
+    EvaluationSample* sample = isR2 ? mSample2 : mSample1;
+    // up to 256K reads, loaded by loadSample
+    readNum = sample->adapterReadNum;
+    long records = sample->adapterRecords;
+    Read** loadedReads = sample->reads.data();
 
     // we need at least 10000 valid records to evaluate
     if(records < 10000) {
-        for(int r=0; r<records; r++) {
-            delete loadedReads[r];
-            loadedReads[r] = NULL;
-        }
-        delete[] loadedReads;
         return "";
     }
 
@@ -555,21 +538,11 @@ string Evaluator::evalAdapterAndReadNum(long& readNum, bool isR2) {
         string adapter = getAdapterWithSeed(key, loadedReads, records, keylen);
         if(!adapter.empty()){
             delete[] counts;
-            for(int r=0; r<records; r++) {
-                delete loadedReads[r];
-                loadedReads[r] = NULL;
-            }
-            delete[] loadedReads;
             return adapter;
         }
     }
 
     delete[] counts;
-    for(int r=0; r<records; r++) {
-        delete loadedReads[r];
-        loadedReads[r] = NULL;
-    }
-    delete[] loadedReads;
     return "";
 
 }
@@ -717,4 +690,6 @@ bool Evaluator::test() {
 //    string s = "ATCGATCGAT";
 //    cerr << eval.int2seq(eval.seq2int(s, 0, 10, -1), 10) << endl;
 //    return eval.int2seq(eval.seq2int(s, 0, 10, -1), 10) == s;
+    // the test above is disabled, falling off the end of a bool function crashed the test runner
+    return true;
 }
\ No newline at end of file
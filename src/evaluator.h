@@ -10,10 +10,28 @@
 
 using namespace std;
 
+// the head of one input file, read once and shared by all evaluations of it
+struct EvaluationSample {
+    // the first reads, kept for adapter and overrepresented sequence detection
+    vector<Read*> reads;
+    // how many of them the adapter detection uses
+    long adapterRecords;
+    // the longest of the first 1M reads
+    int seqLen;
+    // read number estimated when the adapter sample was complete, and from up to 512K reads
+    long adapterReadNum;
+    long readNum;
+    string firstName;
+};
+
 class Evaluator{
 public:
+    // takes the input files from opt, they can change after this
     Evaluator(Options* & opt);
     ~Evaluator();
+    // reads the head of each input file once, the evaluations below only use these samples.
+    // does not touch opt, so it can run while the index is loading
+    void loadSamples();
     // evaluate how many reads are stored in the input file
     void evaluateReadNum(long& readNum);
     string evalAdapterAndReadNumDepreciated(long& readNum);
@@ -21,13 +39,19 @@ public:
     bool isTwoColorSystem();
     void evaluateSeqLen();
     void evaluateOverRepSeqs();
-    void computeOverRepSeq(string filename, map<string, long>& hotseqs, int seqLen);
-    int computeSeqLen(string filename);
+    void computeOverRepSeq(EvaluationSample* sample, map<string, long>& hotseqs, int seqLen);
 
     static bool test();
     static string matchKnownAdapter(string seq);
 private:
+    void loadSample(string filename, EvaluationSample* sample);
+
     Options* mOptions;
+    string mIn1;
+    string mIn2;
+    bool mKeepReads;
+    EvaluationSample* mSample1;
+    EvaluationSample* mSample2;
     string int2seq(unsigned int val, int seqlen);
     int seq2int(string& seq, int pos, int seqlen, int lastVal = -1);
     string getAdapterWithSeed(int seed, Read** loadedReads, long records, int keylen);
@@ -99,6 +99,56 @@ void FastaReader::readAll() {
     }
 }
 
+FastaWindowReader::FastaWindowReader(string fastaFile, int windowLen, int step) {
+    mReader = new FastaReader(fastaFile);
+    mWindowLen = windowLen;
+    mStep = step;
+    mNextStart = 0;
+    mSequenceDone = true;
+}
+
+FastaWindowReader::~FastaWindowReader() {
+    if (mReader) {
+        delete mReader;
+        mReader = NULL;
+    }
+}
+
+Read* FastaWindowReader::read(Read* reuse) {
+    while (mSequenceDone) {
+        if (!mReader->hasNext())
+            return NULL;
+        mReader->readNext();
+        // the id is the header up to the first space
+        mName = mReader->mCurrentID.substr(0, mReader->mCurrentID.find_first_of(" \t"));
+        mSequence.swap(mReader->mCurrentSequence);
+        mNextStart = 0;
+        mSequenceDone = mSequence.empty();
+    }
+
+    size_t start = mNextStart;
+    size_t len = min(mWindowLen, mSequence.length() - start);
+    if (start + len >= mSequence.length()) {
+        mSequenceDone = true;
+    } else {
+        mNextStart = start + mStep;
+        // align the last window to the end of the sequence
+        if (mNextStart + mWindowLen > mSequence.length())
+            mNextStart = mSequence.length() - mWindowLen;
+    }
+
+    string name = "@" + mName + ":" + to_string(start + 1) + "-" + to_string(start + len);
+    if (reuse) {
+        reuse->mName = name;
+        reuse->mSeq.mStr.assign(mSequence, start, len);
+        reuse->mStrand = "+";
+        reuse->mQuality.assign(len, 'I');
+        reuse->mHasQuality = true;
+        return reuse;
+    }
+    return new Read(name, mSequence.substr(start, len), "+", string(len, 'I'));
+}
+
 bool FastaReader::test(){
     FastaReader reader("testdata/tinyref.fa");
     reader.readAll();
@@ -10,6 +10,7 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include "read.h"
 
 
 using namespace std;
@@ -62,6 +63,27 @@ private:
     bool mForceUpperCase;
 };
 
+// cuts each sequence of a FASTA file into windows of windowLen bases that start every step bases,
+// the last window of a sequence ends at its end. only one sequence is held in memory at a time
+class FastaWindowReader
+{
+public:
+    FastaWindowReader(string fastaFile, int windowLen, int step);
+    ~FastaWindowReader();
+    // the next window as a read named <sequence id>:<start>-<end>, NULL after the last one.
+    // the window is written into reuse when it is given
+    Read* read(Read* reuse = NULL);
+
+private:
+    FastaReader* mReader;
+    size_t mWindowLen;
+    size_t mStep;
+    string mName;
+    string mSequence;
+    size_t mNextStart;
+    bool mSequenceDone;
+};
+
 
 #endif
 
@@ -1,10 +1,17 @@
 #include "fastqreader.h"
 #include "util.h"
+#include "linescanner.h"
+#include "mappedfastq.h"
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
 
 //#define FQ_BUF_SIZE (1<<20)
 
-FastqReader::FastqReader(string filename, bool hasQuality, bool phred64, size_t fastqBufferSize) {
+FastqReader::FastqReader(string filename, bool hasQuality, bool phred64, size_t fastqBufferSize, int readahead, int decompressThreads, int ioUringDepth) {
     mFilename = filename;
     mZipFile = NULL;
     mZipped = false;
@@ -17,13 +24,85 @@ FastqReader::FastqReader(string filename, bool hasQuality, bool phred64, size_t
     mBuf = new char[mFastqBufSize];
     mBufDataLen = 0;
     mBufUsedLen = 0;
+    mInputEnd = false;
+    mMemoryMode = false;
     mHasNoLineBreakAtEnd = false;
+    mReadahead = readahead;
+    mDecompressThreads = decompressThreads;
+    mBgzf = NULL;
+    mDecompressThread = NULL;
+    mBlockSize = 0;
+    mBlockHead = 0;
+    mBlockOffset = 0;
+    mBlocksFilled = 0;
+    mDecompressDone = false;
+    mStopDecompress = false;
+    mZipOffset = 0;
+    mStallSeconds = 0;
+    mIoUringDepth = ioUringDepth;
+    mUring = NULL;
+    mZipMemberStart = true;
+    mZipMembers = 0;
+    mZipEnd = false;
+    mChunkPool = NULL;
+    mChunk = NULL;
     init();
 }
 
+FastqReader::FastqReader(const char* data, size_t len, bool hasQuality, bool phred64) {
+    mFilename = "";
+    mZipFile = NULL;
+    mZipped = false;
+    mFile = NULL;
+    mStdinMode = false;
+    mPhred64 = phred64;
+    mHasQuality = hasQuality;
+    // the whole input is in the buffer already, so readToBuf is never called
+    mFastqBufSize = len;
+    mFileSize = len;
+    mBuf = const_cast<char*>(data);
+    mBufDataLen = len;
+    mBufUsedLen = 0;
+    mInputEnd = true;
+    mMemoryMode = true;
+    mHasNoLineBreakAtEnd = len > 0 && data[len - 1] != '\n';
+    mReadahead = 0;
+    mDecompressThreads = 1;
+    mBgzf = NULL;
+    mDecompressThread = NULL;
+    mBlockSize = 0;
+    mBlockHead = 0;
+    mBlockOffset = 0;
+    mBlocksFilled = 0;
+    mDecompressDone = false;
+    mStopDecompress = false;
+    mZipOffset = 0;
+    mStallSeconds = 0;
+    mIoUringDepth = 0;
+    mUring = NULL;
+    mZipMemberStart = true;
+    mZipMembers = 0;
+    mZipEnd = false;
+    mChunkPool = NULL;
+    mChunk = NULL;
+}
+
 FastqReader::~FastqReader() {
     close();
-    delete mBuf;
+    if (mChunk)
+        mChunkPool->unref(mChunk);
+    else if (!mMemoryMode)
+        delete[] mBuf;
+}
+
+void FastqReader::viewInto(ReadChunkPool* pool) {
+    if (mMemoryMode || mChunkPool)
+        return;
+    mChunkPool = pool;
+    mChunk = pool->acquire(mFastqBufSize);
+    memcpy(mChunk->data, mBuf, mBufDataLen);
+    delete[] mBuf;
+    mBuf = mChunk->data;
 }
 
 bool FastqReader::hasNoLineBreakAtEnd() {
@@ -31,37 +110,225 @@ bool FastqReader::hasNoLineBreakAtEnd() {
 }
 
 void FastqReader::readToBuf() {
+    size_t left = mBufDataLen - mBufUsedLen;
+    // reads still view the chunk, the record in progress continues in another one
+    if (mChunk && (mChunk->refs > 1 || left == mFastqBufSize)) {
+        if (left == mFastqBufSize)
+            mFastqBufSize *= 2;
+        ReadChunk* chunk = mChunkPool->acquire(mFastqBufSize);
+        memcpy(chunk->data, mBuf + mBufUsedLen, left);
+        mChunkPool->unref(mChunk);
+        mChunk = chunk;
+        mBuf = chunk->data;
+    } else if (left > 0 && mBufUsedLen > 0) {
+        // move the unparsed tail to the front, the record in progress continues there
+        memmove(mBuf, mBuf + mBufUsedLen, left);
+    }
+    mBufDataLen = left;
+    mBufUsedLen = 0;
+
+    // a single record does not fit, grow the buffer
+    if (mBufDataLen == mFastqBufSize) {
+        char* buf = new char[mFastqBufSize * 2];
+        memcpy(buf, mBuf, mBufDataLen);
+        delete[] mBuf;
+        mBuf = buf;
+        mFastqBufSize *= 2;
+    }
+
+    size_t toRead = mFastqBufSize - mBufDataLen;
+    long readLen = 0;
     if (mZipped) {
-        mBufDataLen = gzread(mZipFile, mBuf, mFastqBufSize);
-        //mBufDataLen = gzread(mZipFile, mBuf, FQ_BUF_SIZE);
-        if (mBufDataLen == -1) {
-            cerr << "Error to read gzip file" << endl;
-        }
-        int z_errnum = 0;
-        const char *errmsg = gzerror(mZipFile, &z_errnum);
-        //if (z_errnum == Z_BUF_ERROR) {
-        if ((z_errnum == Z_BUF_ERROR) || (z_errnum == Z_ERRNO) || (z_errnum == Z_DATA_ERROR) || (z_errnum == Z_STREAM_ERROR) || (z_errnum == Z_MEM_ERROR)) {
-            cerr << errmsg << endl;
-            exit(-1);
-        }
+        if (mDecompressThread)
+            readLen = readDecompressed(mBuf + mBufDataLen, toRead);
+        else
+            readLen = zipRead(mBuf + mBufDataLen, toRead);
     } else {
         //mBufDataLen = fread(mBuf, 1, FQ_BUF_SIZE, mFile);
-        mBufDataLen = fread(mBuf, 1, mFastqBufSize, mFile);
+        if (mUring)
+            readLen = mUring->read(mBuf + mBufDataLen, toRead);
+        else
+            readLen = fread(mBuf + mBufDataLen, 1, toRead, mFile);
     }
-    mBufUsedLen = 0;
+    if (readLen < 0)
+        readLen = 0;
+    mBufDataLen += readLen;
 
     //if (mBufDataLen < FQ_BUF_SIZE) {
-    if(mBufDataLen < mFastqBufSize) {
-        if (mBuf[mBufDataLen - 1] != '\n')
+    if((size_t) readLen < toRead) {
+        mInputEnd = true;
+        if (mBufDataLen > 0 && mBuf[mBufDataLen - 1] != '\n')
             mHasNoLineBreakAtEnd = true;
     }
 }
 
+long FastqReader::zipRead(char* buf, size_t len) {
+    if (mUring)
+        return uringZipRead(buf, len);
+    long readLen = gzread(mZipFile, buf, len);
+    //mBufDataLen = gzread(mZipFile, mBuf, FQ_BUF_SIZE);
+    if (readLen == -1) {
+        cerr << "Error to read gzip file" << endl;
+    }
+    int z_errnum = 0;
+    const char *errmsg = gzerror(mZipFile, &z_errnum);
+    //if (z_errnum == Z_BUF_ERROR) {
+    if ((z_errnum == Z_BUF_ERROR) || (z_errnum == Z_ERRNO) || (z_errnum == Z_DATA_ERROR) || (z_errnum == Z_STREAM_ERROR) || (z_errnum == Z_MEM_ERROR)) {
+        cerr << errmsg << endl;
+        exit(-1);
+    }
+    return readLen;
+}
+
+// inflates like gzread does, including concatenated gzip members, from the data io_uring read
+long FastqReader::uringZipRead(char* buf, size_t len) {
+    mZipStream.next_out = (Bytef*) buf;
+    mZipStream.avail_out = len;
+    while (mZipStream.avail_out > 0 && !mZipEnd) {
+        if (mZipStream.avail_in == 0) {
+            size_t n = mUring->read(mZipIn.data(), mZipIn.size());
+            if (n == 0) {
+                if (!mZipMemberStart)
+                    error_exit("unexpected end of file: " + mFilename);
+                mZipEnd = true;
+                break;
+            }
+            mZipStream.next_in = (Bytef*) mZipIn.data();
+            mZipStream.avail_in = n;
+        }
+        int ret = inflate(&mZipStream, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            inflateReset(&mZipStream);
+            mZipMemberStart = true;
+            mZipMembers++;
+        } else if (ret == Z_DATA_ERROR && mZipMemberStart && mZipMembers > 0) {
+            // trailing bytes that are not another gzip member are ignored, as gzread does
+            mZipEnd = true;
+        } else if (ret == Z_OK || (ret == Z_BUF_ERROR && mZipStream.avail_in == 0)) {
+            mZipMemberStart = false;
+        } else {
+            error_exit("Error to read gzip file: " + mFilename);
+        }
+    }
+    return len - mZipStream.avail_out;
+}
+
+void FastqReader::decompressTask() {
+    size_t slot = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mBlockMtx);
+            mBlockFree.wait(lock, [this] { return mStopDecompress || mBlocksFilled < mBlocks.size(); });
+            if (mStopDecompress)
+                return;
+        }
+        // the slot is not visible to the reader until it is counted as filled
+        ReadaheadBlock& block = mBlocks[slot];
+        bool last = false;
+        size_t offset = 0;
+        if (mBgzf) {
+            block.len = mBgzf->decompress(block.data, mBlockSize);
+            last = block.len == 0;
+            offset = mBgzf->compressedOffset();
+        } else {
+            long readLen = zipRead(block.data.data(), mBlockSize);
+            block.len = readLen > 0 ? readLen : 0;
+            last = block.len < mBlockSize;
+            offset = mUring ? mUring->offset() : gzoffset(mZipFile);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mBlockMtx);
+            mZipOffset = offset;
+            if (block.len > 0)
+                mBlocksFilled++;
+            if (last)
+                mDecompressDone = true;
+        }
+        mBlockReady.notify_one();
+        if (last)
+            return;
+        slot = (slot + 1) % mBlocks.size();
+    }
+}
+
+long FastqReader::readDecompressed(char* buf, size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        std::unique_lock<std::mutex> lock(mBlockMtx);
+        if (mBlocksFilled == 0) {
+            if (mDecompressDone)
+                break;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            mBlockReady.wait(lock, [this] { return mBlocksFilled > 0 || mDecompressDone; });
+            mStallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (mBlocksFilled == 0)
+                break;
+        }
+        lock.unlock();
+
+        ReadaheadBlock& block = mBlocks[mBlockHead];
+        size_t n = min(len - copied, block.len - mBlockOffset);
+        memcpy(buf + copied, block.data.data() + mBlockOffset, n);
+        copied += n;
+        mBlockOffset += n;
+        if (mBlockOffset == block.len) {
+            // hand the slot back to the decompression thread, it may be refilled right away
+            mBlockOffset = 0;
+            mBlockHead = (mBlockHead + 1) % mBlocks.size();
+            lock.lock();
+            mBlocksFilled--;
+            lock.unlock();
+            mBlockFree.notify_one();
+        }
+    }
+    return copied;
+}
+
 void FastqReader::init() {
+    struct stat st;
+    mFileSize = stat(mFilename.c_str(), &st) == 0 ? st.st_size : 0;
+    if (mIoUringDepth > 0 && UringReader::canUse(mFilename) && UringReader::available()) {
+        mUring = new UringReader(mFilename, mIoUringDepth);
+        // e.g. seccomp in a container or a ring above the locked memory limit, the file is read as without io_uring
+        if (!mUring->ok()) {
+            cerr << "WARNING: " << mUring->error() << ", reading it without io_uring" << endl;
+            delete mUring;
+            mUring = NULL;
+        }
+    }
     if (ends_with(mFilename, ".gz")) {
-        mZipFile = gzopen(mFilename.c_str(), "r");
         mZipped = true;
-        gzrewind(mZipFile);
+        // BGZF members can be inflated in parallel, plain gzip goes through one zlib stream
+        if (mReadahead > 0 && mDecompressThreads > 1 && BgzfDecompressor::isBgzf(mFilename)) {
+            if (!mUring) {
+                mFile = fopen(mFilename.c_str(), "rb");
+                if (mFile == NULL) {
+                    error_exit("Failed to open file: " + mFilename);
+                }
+            }
+            mBgzf = new BgzfDecompressor(mFile, mFilename, mDecompressThreads, mUring);
+        } else if (mUring) {
+            memset(&mZipStream, 0, sizeof(mZipStream));
+            // 32 lets zlib detect the gzip header
+            if (inflateInit2(&mZipStream, 15 + 32) != Z_OK)
+                error_exit("Failed to initialize zlib for file: " + mFilename);
+            mZipIn.resize(1<<20);
+        } else {
+            mZipFile = gzopen(mFilename.c_str(), "r");
+            gzrewind(mZipFile);
+        }
+        if (mReadahead > 0) {
+            mBlockSize = mFastqBufSize;
+            mBlocks.resize(mReadahead);
+            for (auto & block : mBlocks) {
+                if (!mBgzf)
+                    block.data.resize(mBlockSize);
+                block.len = 0;
+            }
+            mDecompressThread = new std::thread(std::bind(&FastqReader::decompressTask, this));
+        }
+    } else if (mUring) {
+        mZipped = false;
     } else {
         if (mFilename == "/dev/stdin") {
             mFile = stdin;
@@ -77,15 +344,21 @@ void FastqReader::init() {
 
 void FastqReader::getBytes(size_t& bytesRead, size_t& bytesTotal) {
     if (mZipped) {
-        bytesRead = gzoffset(mZipFile);
+        if (mDecompressThread) {
+            // the decompression thread owns the gz stream, this runs ahead by up to the readahead depth
+            std::lock_guard<std::mutex> lock(mBlockMtx);
+            bytesRead = mZipOffset;
+        } else if (mUring) {
+            bytesRead = mUring->offset();
+        } else {
+            bytesRead = gzoffset(mZipFile);
+        }
+    } else if (mUring) {
+        bytesRead = mUring->offset();
     } else {
         bytesRead = ftell(mFile); //mFile.tellg();
     }
-
-    // use another ifstream to not affect current reader
-    ifstream is(mFilename);
-    is.seekg(0, is.end);
-    bytesTotal = is.tellg();
+    bytesTotal = mFileSize;
 }
 
 void FastqReader::clearLineBreaks(char* line) {
@@ -101,135 +374,165 @@ void FastqReader::clearLineBreaks(char* line) {
     }
 }
 
-string FastqReader::getLine() {
-    static int c = 0;
-    c++;
-    int copied = 0;
+bool FastqReader::nextLine(size_t& pos, LineView& line) {
+    size_t end = mBufDataLen;
+    if (findLineEnds(mBuf + pos, mBufDataLen - pos, &end, 1) == 1)
+        end += pos;
 
-    int start = mBufUsedLen;
-    int end = start;
-
-    while (end < mBufDataLen) {
-        if (mBuf[end] != '\r' && mBuf[end] != '\n')
-            end++;
-        else
-            break;
+    // the line continues in data not read yet, also when only the \n of a \r\n is missing
+    if (!mInputEnd) {
+        if (end == mBufDataLen || (mBuf[end] == '\r' && end + 1 == mBufDataLen))
+            return false;
     }
 
-    // this line well contained in this buf, or this is the last buf
-    //if (end < mBufDataLen || mBufDataLen < FQ_BUF_SIZE) {
-    if(end < mBufDataLen || mBufDataLen < mFastqBufSize) {
-        int len = end - start;
-        string line(mBuf + start, len);
+    line.data = mBuf + pos;
+    line.len = end - pos;
 
+    if (end < mBufDataLen) {
         // skip \n or \r
         end++;
         // handle \r\n
-        if (end < mBufDataLen - 1 && mBuf[end - 1] == '\r' && mBuf[end] == '\n')
+        if (end < mBufDataLen && mBuf[end - 1] == '\r' && mBuf[end] == '\n')
             end++;
-
-        mBufUsedLen = end;
-
-        return line;
     }
+    pos = end;
+    return true;
+}
 
-    // this line is not contained in this buf, we need to read new buf
-    string str(mBuf + start, mBufDataLen - start);
-
-    while (true) {
-        readToBuf();
-        start = 0;
-        end = 0;
-        while (end < mBufDataLen) {
-            if (mBuf[end] != '\r' && mBuf[end] != '\n')
-                end++;
-            else
-                break;
-        }
-        // this line well contained in this buf, we need to read new buf
-        //if (end < mBufDataLen || mBufDataLen < FQ_BUF_SIZE) {
-        if(end < mBufDataLen || mBufDataLen < mFastqBufSize) {
-            int len = end - start;
-            str.append(mBuf + start, len);
-
-            // skip \n or \r
-            end++;
-            // handle \r\n
-            if (end < mBufDataLen - 1 && mBuf[end] == '\n')
-                end++;
+bool FastqReader::nextRecord(size_t& pos, LineView* lines, int count) {
+    size_t ends[4];
+    if (findLineEnds(mBuf + pos, mBufDataLen - pos, ends, count) < (size_t) count)
+        return false;
+    // the \n of a \r\n ending the last line may not be read yet
+    size_t last = pos + ends[count - 1];
+    if (!mInputEnd && mBuf[last] == '\r' && last + 1 == mBufDataLen)
+        return false;
 
-            mBufUsedLen = end;
-            return str;
-        }
-        // even this new buf is not enough, although impossible
-        str.append(mBuf + start, mBufDataLen);
+    size_t start = pos;
+    for (int i = 0; i < count; i++) {
+        size_t end = pos + ends[i];
+        lines[i].data = mBuf + start;
+        lines[i].len = end - start;
+        start = end + 1;
+        if (mBuf[end] == '\r' && start < mBufDataLen && mBuf[start] == '\n')
+            start++;
     }
-
-    return string();
+    pos = start;
+    return true;
 }
 
 bool FastqReader::eof() {
-    if (mZipped) {
-        return gzeof(mZipFile);
-    } else {
-        return feof(mFile); //mFile.eof();
-    }
+    return mInputEnd && mBufUsedLen >= mBufDataLen;
 }
 
-Read* FastqReader::read() {
+Read* FastqReader::read(Read* reuse) {
     if (mZipped) {
-        if (mZipFile == NULL)
+        if (mZipFile == NULL && mBgzf == NULL && mUring == NULL)
             return NULL;
     }
 
-    if (mBufUsedLen >= mBufDataLen && eof()) {
-        return NULL;
-    }
-
-    string name = getLine();
-    // name should start with @
-    while ((name.empty() && !(mBufUsedLen >= mBufDataLen && eof())) || (!name.empty() && name[0] != '@')) {
-        name = getLine();
+    // the four lines of a record are parsed in place and only copied once, into the Read, or not at all
+    // while viewing into chunks. if the record is cut by the end of the buffer, the buffer is refilled and it is parsed again
+    LineView name, sequence, strand, quality;
+    while (true) {
+        size_t pos = mBufUsedLen;
+        // usually a whole record follows, its line ends are found in one scan
+        if (pos < mBufDataLen && mBuf[pos] == '@') {
+            LineView lines[4];
+            if (nextRecord(pos, lines, mHasQuality ? 4 : 3)) {
+                name = lines[0];
+                sequence = lines[1];
+                strand = lines[2];
+                if (mHasQuality)
+                    quality = lines[3];
+                mBufUsedLen = pos;
+                break;
+            }
+        }
+        bool complete = false;
+        bool gotName = false;
+        // name should start with @
+        while (nextLine(pos, name)) {
+            if (name.len == 0 && pos >= mBufDataLen && mInputEnd)
+                break;
+            if (name.len > 0 && name.data[0] == '@') {
+                gotName = true;
+                break;
+            }
+        }
+        if (gotName && nextLine(pos, sequence) && nextLine(pos, strand)) {
+            if (mHasQuality)
+                complete = nextLine(pos, quality);
+            else
+                complete = true;
+        }
+        if (complete) {
+            mBufUsedLen = pos;
+            break;
+        }
+        if (mInputEnd) {
+            // only empty or junk lines left
+            mBufUsedLen = mBufDataLen;
+            return NULL;
+        }
+        readToBuf();
     }
 
-    if (name.empty())
-        return NULL;
-
-    string sequence = getLine();
-    string strand = getLine();
-
-    // WAR for FQ with no quality
-    if (!mHasQuality) {
-        string quality = string(sequence.length(), 'K');
-        return new Read(name, sequence, strand, quality, mPhred64);
-    } else {
-        string quality = getLine();
-        if (quality.length() != sequence.length()) {
-            cerr << "ERROR: sequence and quality have different length:" << endl;
-            cerr << name << endl;
-            cerr << sequence << endl;
-            cerr << strand << endl;
-            cerr << quality << endl;
-            //return NULL;
-            exit(-1);
-        }
-        return new Read(name, sequence, strand, quality, mPhred64);
+    if (mHasQuality && quality.len != sequence.len) {
+        cerr << "ERROR: sequence and quality have different length:" << endl;
+        cerr << string(name.data, name.len) << endl;
+        cerr << string(sequence.data, sequence.len) << endl;
+        cerr << string(strand.data, strand.len) << endl;
+        cerr << string(quality.data, quality.len) << endl;
+        //return NULL;
+        exit(-1);
     }
 
-    return NULL;
+    // a recycled read keeps the capacity of its strings
+    Read* read = reuse ? reuse : new Read(string(), string(), string(), string());
+    ReadView& view = read->mView;
+    view.name = name.data;
+    view.nameLen = name.len;
+    view.seq = sequence.data;
+    view.seqLen = sequence.len;
+    view.strand = strand.data;
+    view.strandLen = strand.len;
+    view.quality = mHasQuality ? quality.data : NULL;
+    view.phred64 = mPhred64;
+    read->mViewed = true;
+    if (!mChunkPool)
+        read->own();
+    return read;
 }
 
 void FastqReader::close() {
-    if (mZipped) {
-        if (mZipFile) {
-            gzclose(mZipFile);
-            mZipFile = NULL;
-        }
-    } else {
-        if (mFile) {
-            fclose(mFile); //mFile.close();
-            mFile = NULL;
+    if (mDecompressThread) {
+        {
+            std::lock_guard<std::mutex> lock(mBlockMtx);
+            mStopDecompress = true;
         }
+        mBlockFree.notify_one();
+        mDecompressThread->join();
+        delete mDecompressThread;
+        mDecompressThread = NULL;
+        mBlocks.clear();
+    }
+    if (mBgzf) {
+        delete mBgzf;
+        mBgzf = NULL;
+    }
+    if (mUring) {
+        if (mZipped && !mZipIn.empty())
+            inflateEnd(&mZipStream);
+        delete mUring;
+        mUring = NULL;
+    }
+    if (mZipped && mZipFile) {
+        gzclose(mZipFile);
+        mZipFile = NULL;
+    } else if (mFile) {
+        fclose(mFile); //mFile.close();
+        mFile = NULL;
     }
 }
 
@@ -263,40 +566,157 @@ bool FastqReader::isZipped() {
     return mZipped;
 }
 
+// a read viewing a chunk of reader, pinned like a pack pins it
+static Read* readPinned(FastqReader& reader, ReadChunkPool& pool, vector<ReadChunk*>& pins) {
+    Read* r = reader.read();
+    if (r && (pins.empty() || pins.back() != reader.chunk())) {
+        pool.ref(reader.chunk());
+        pins.push_back(reader.chunk());
+    }
+    return r;
+}
+
 bool FastqReader::test() {
-    FastqReader reader1("testdata/R1.fq");
-    FastqReader reader2("testdata/R1.fq.gz");
-    Read* r1 = NULL;
-    Read* r2 = NULL;
-    while (true) {
-        r1 = reader1.read();
-        r2 = reader2.read();
-        if (r1 == NULL || r2 == NULL)
-            break;
-        if (r1->mSeq.mStr != r2->mSeq.mStr) {
-            return false;
+    const int records = 3000;
+    string prefix = "/tmp/seq2fun_reader_test_" + to_string(getpid());
+    string plain = prefix + ".fq", zipped = prefix + ".fq.gz";
+    {
+        ofstream ofs(plain);
+        gzFile gz = gzopen(zipped.c_str(), "wb");
+        for (int i = 0; i < records; i++) {
+            string seq = string(50 + i % 101, "ACGT"[i % 4]);
+            string record = "@r" + to_string(i) + " comment\n" + seq + "\n+\n" + string(seq.length(), (char) ('#' + i % 40)) + "\n";
+            ofs << record;
+            gzwrite(gz, record.data(), record.length());
         }
-        delete r1;
-        delete r2;
+        gzclose(gz);
     }
-    return true;
+
+    bool passed = true;
+    vector<Read*> reads;
+    {
+        FastqReader reader1(plain);
+        FastqReader reader2(zipped);
+        while (true) {
+            Read* r1 = reader1.read();
+            Read* r2 = reader2.read();
+            if (r1 == NULL || r2 == NULL) {
+                passed &= r1 == r2;
+                delete r1;
+                delete r2;
+                break;
+            }
+            passed &= r1->mSeq.mStr == r2->mSeq.mStr && r1->mQuality == r2->mQuality && !r1->mViewed;
+            reads.push_back(r1);
+            delete r2;
+        }
+    }
+    passed &= reads.size() == (size_t) records;
+
+    // all chunks pinned, the reader moves to new ones and the views stay valid, also where it grows them
+    {
+        ReadChunkPool pool;
+        vector<ReadChunk*> pins;
+        vector<Read*> viewed;
+        {
+            FastqReader reader(plain, true, false, 256);
+            reader.viewInto(&pool);
+            while (Read* r = readPinned(reader, pool, pins))
+                viewed.push_back(r);
+        }
+        passed &= viewed.size() == reads.size() && pool.created() > 1;
+        for (size_t i = 0; i < viewed.size() && i < reads.size(); i++) {
+            passed &= viewed[i]->mViewed;
+            viewed[i]->own();
+            passed &= viewed[i]->mName == reads[i]->mName && viewed[i]->mSeq.mStr == reads[i]->mSeq.mStr
+                    && viewed[i]->mStrand == reads[i]->mStrand && viewed[i]->mQuality == reads[i]->mQuality;
+            delete viewed[i];
+        }
+        for (auto chunk : pins)
+            pool.unref(chunk);
+    }
+
+    // pins let go right after the copy, the same chunks are filled again
+    {
+        ReadChunkPool pool;
+        FastqReader reader(plain, true, false, 4096);
+        reader.viewInto(&pool);
+        size_t count = 0;
+        vector<ReadChunk*> pins;
+        while (Read* r = readPinned(reader, pool, pins)) {
+            r->own();
+            passed &= count < reads.size() && r->mSeq.mStr == reads[count]->mSeq.mStr && r->mQuality == reads[count]->mQuality;
+            count++;
+            delete r;
+            for (auto chunk : pins)
+                pool.unref(chunk);
+            pins.clear();
+        }
+        passed &= count == reads.size() && pool.created() <= 2;
+    }
+
+    for (auto r : reads)
+        delete r;
+    unlink(plain.c_str());
+    unlink(zipped.c_str());
+    return passed;
+}
+
+void FastqReader::benchmark(string filename) {
+    if (!MappedFastq::canMap(filename))
+        error_exit("the parser benchmark needs an uncompressed FASTQ file: " + filename);
+    MappedFastq mapped(filename);
+    // the first pass pages the file in, the fastest of the timed ones is reported
+    const int timedPasses = 3;
+    double best = 0;
+    size_t reads = 0;
+    for (int pass = 0; pass <= timedPasses; pass++) {
+        FastqReader reader(mapped.data(), mapped.size());
+        reads = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (Read* r = reader.read()) {
+            delete r;
+            reads++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (pass == 1 || (pass > 1 && seconds < best))
+            best = seconds;
+    }
+    cerr << "parsed " << reads << " reads, " << mapped.size() << " bytes in " << best << " seconds (best of " << timedPasses << " passes) with the "
+            << lineScannerName() << " line scanner, " << (best > 0 ? mapped.size() / best / 1e9 : 0) << " GB/s" << endl;
 }
 
 FastqReaderPair::FastqReaderPair(FastqReader* left, FastqReader* right) {
     mLeft = left;
     mRight = right;
+    mInterleaved = false;
+    mConcurrent = false;
+    mPairs = 0;
 }
 
-FastqReaderPair::FastqReaderPair(string leftName, string rightName, bool hasQuality, bool phred64, bool interleaved, size_t fastqBufferSize) {
+FastqReaderPair::FastqReaderPair(string leftName, string rightName, bool hasQuality, bool phred64, bool interleaved, size_t fastqBufferSize, int readahead, int decompressThreads, bool concurrent, int ioUringDepth) {
     mInterleaved = interleaved;
-    mLeft = new FastqReader(leftName, hasQuality, phred64, fastqBufferSize);
+    mLeft = new FastqReader(leftName, hasQuality, phred64, fastqBufferSize, readahead, decompressThreads, ioUringDepth);
     if (mInterleaved)
         mRight = NULL;
     else
-        mRight = new FastqReader(rightName, hasQuality, phred64, fastqBufferSize);
+        mRight = new FastqReader(rightName, hasQuality, phred64, fastqBufferSize, readahead, decompressThreads, ioUringDepth);
+    mPairs = 0;
+    // both mates of interleaved input come from one file and stay on the calling thread
+    mConcurrent = concurrent && !mInterleaved;
+    if (mConcurrent) {
+        mLeftStream.reader = mLeft;
+        mRightStream.reader = mRight;
+        startMateThread(&mLeftStream);
+        startMateThread(&mRightStream);
+    }
 }
 
 FastqReaderPair::~FastqReaderPair() {
+    if (mConcurrent) {
+        stopMateThread(&mLeftStream);
+        stopMateThread(&mRightStream);
+    }
     if (mLeft) {
         delete mLeft;
         mLeft = NULL;
@@ -307,16 +727,272 @@ FastqReaderPair::~FastqReaderPair() {
     }
 }
 
-ReadPair* FastqReaderPair::read() {
-    Read* l = mLeft->read();
+void FastqReaderPair::startMateThread(MateStream* stream) {
+    stream->current = NULL;
+    stream->pos = 0;
+    stream->done = false;
+    stream->stop = false;
+    stream->bytesRead = 0;
+    stream->bytesTotal = 0;
+    stream->stallSeconds = 0;
+    stream->thread = new std::thread(std::bind(&FastqReaderPair::mateTask, this, stream));
+}
+
+void FastqReaderPair::stopMateThread(MateStream* stream) {
+    {
+        std::lock_guard<std::mutex> lock(stream->mtx);
+        stream->stop = true;
+    }
+    stream->space.notify_all();
+    stream->thread->join();
+    delete stream->thread;
+    stream->thread = NULL;
+    // reads parsed ahead but never paired, e.g. when only the first N reads are processed
+    if (stream->current) {
+        for (size_t i = stream->pos; i < stream->current->size(); i++)
+            delete (*stream->current)[i];
+        delete stream->current;
+        stream->current = NULL;
+    }
+    while (!stream->chunks.empty()) {
+        vector<Read*>* chunk = stream->chunks.front();
+        stream->chunks.pop_front();
+        for (size_t i = 0; i < chunk->size(); i++)
+            delete (*chunk)[i];
+        delete chunk;
+    }
+    for (size_t i = 0; i < stream->recycled.size(); i++)
+        delete stream->recycled[i];
+    stream->recycled.clear();
+    for (size_t i = 0; i < stream->spare.size(); i++)
+        delete stream->spare[i];
+    stream->spare.clear();
+}
+
+void FastqReaderPair::mateTask(MateStream* stream) {
+    vector<Read*> reuse;
+    while (true) {
+        vector<Read*>* chunk = new vector<Read*>();
+        chunk->reserve(MATE_CHUNK_SIZE);
+        if (reuse.empty()) {
+            std::lock_guard<std::mutex> lock(stream->mtx);
+            reuse.swap(stream->spare);
+        }
+        while (chunk->size() < (size_t) MATE_CHUNK_SIZE) {
+            Read* r = stream->reader->read(reuse.empty() ? NULL : reuse.back());
+            if (!r)
+                break;
+            if (!reuse.empty() && r == reuse.back())
+                reuse.pop_back();
+            chunk->push_back(r);
+        }
+        bool last = chunk->size() < (size_t) MATE_CHUNK_SIZE;
+        size_t bytesRead = 0;
+        size_t bytesTotal = 0;
+        stream->reader->getBytes(bytesRead, bytesTotal);
+        double stallSeconds = stream->reader->getStallSeconds();
+
+        std::unique_lock<std::mutex> lock(stream->mtx);
+        stream->space.wait(lock, [stream]{return stream->stop || stream->chunks.size() < (size_t) MATE_QUEUE_DEPTH;});
+        if (stream->stop) {
+            for (size_t i = 0; i < chunk->size(); i++)
+                delete (*chunk)[i];
+            delete chunk;
+            for (size_t i = 0; i < reuse.size(); i++)
+                delete reuse[i];
+            return;
+        }
+        if (chunk->empty())
+            delete chunk;
+        else
+            stream->chunks.push_back(chunk);
+        stream->bytesRead = bytesRead;
+        stream->bytesTotal = bytesTotal;
+        stream->stallSeconds = stallSeconds;
+        stream->done = last;
+        lock.unlock();
+        stream->ready.notify_one();
+        if (last) {
+            for (size_t i = 0; i < reuse.size(); i++)
+                delete reuse[i];
+            return;
+        }
+    }
+}
+
+Read* FastqReaderPair::nextMate(MateStream* stream) {
+    if (!stream->current || stream->pos >= stream->current->size()) {
+        if (stream->current) {
+            delete stream->current;
+            stream->current = NULL;
+        }
+        std::unique_lock<std::mutex> lock(stream->mtx);
+        stream->ready.wait(lock, [stream]{return stream->done || !stream->chunks.empty();});
+        if (stream->chunks.empty())
+            return NULL;
+        stream->current = stream->chunks.front();
+        stream->chunks.pop_front();
+        stream->pos = 0;
+        stream->spare.insert(stream->spare.end(), stream->recycled.begin(), stream->recycled.end());
+        stream->recycled.clear();
+        lock.unlock();
+        stream->space.notify_one();
+    }
+    return (*stream->current)[stream->pos++];
+}
+
+void FastqReaderPair::getBytes(size_t& bytesRead, size_t& bytesTotal) {
+    if (!mConcurrent) {
+        mLeft->getBytes(bytesRead, bytesTotal);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mLeftStream.mtx);
+    bytesRead = mLeftStream.bytesRead;
+    bytesTotal = mLeftStream.bytesTotal;
+}
+
+void FastqReaderPair::getStallSeconds(double& left, double& right) {
+    if (!mConcurrent) {
+        left = mLeft->getStallSeconds();
+        right = mRight ? mRight->getStallSeconds() : 0;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLeftStream.mtx);
+        left = mLeftStream.stallSeconds;
+    }
+    std::lock_guard<std::mutex> lock(mRightStream.mtx);
+    right = mRightStream.stallSeconds;
+}
+
+// the length of the name up to the first whitespace, which drops the Casava 1:N:0 comment, without a trailing /1 or /2.
+// a dotted number is kept, in SRA names like @SRR001.1 it is the spot and not the mate
+static size_t mateKeyLength(const string& name) {
+    size_t end = 0;
+    while (end < name.length() && name[end] != ' ' && name[end] != '\t')
+        end++;
+    if (end >= 2 && name[end - 2] == '/' && (name[end - 1] == '1' || name[end - 1] == '2'))
+        end -= 2;
+    return end;
+}
+
+// compared in place, as it runs for every pair
+bool FastqReaderPair::isMateName(const string& left, const string& right) {
+    size_t len = mateKeyLength(left);
+    return len == mateKeyLength(right) && left.compare(0, len, right, 0, len) == 0;
+}
+
+void FastqReaderPair::outOfPair(const string& where, const string& leftName, const string& rightName, const string& leftFile, const string& rightFile) {
+    error_exit("read1 and read2 are out of pair at " + where + ": " + leftName + " vs " + rightName
+            + ", please check that " + leftFile + " and " + rightFile + " are the two files of one library");
+}
+
+ReadPair* FastqReaderPair::read(ReadPair* reuse) {
+    Read* l = NULL;
     Read* r = NULL;
-    if (mInterleaved)
-        r = mLeft->read();
-    else
-        r = mRight->read();
+    if (mConcurrent) {
+        l = nextMate(&mLeftStream);
+        r = nextMate(&mRightStream);
+    } else {
+        l = mLeft->read(reuse ? reuse->mLeft : NULL);
+        if (mInterleaved)
+            r = mLeft->read(reuse ? reuse->mRight : NULL);
+        else
+            r = mRight->read(reuse ? reuse->mRight : NULL);
+    }
     if (!l || !r) {
+        // a file with more records than its mate
+        if (l || r)
+            outOfPair("pair " + to_string(mPairs + 1), l ? l->mName : "end of file", r ? r->mName : "end of file",
+                    mLeft->getFilename(), mRight ? mRight->getFilename() : mLeft->getFilename());
         return NULL;
     } else {
-        return new ReadPair(l, r);
+        if (mConcurrent && !isMateName(l->mName, r->mName))
+            outOfPair("pair " + to_string(mPairs + 1), l->mName, r->mName, mLeft->getFilename(), mRight->getFilename());
+        mPairs++;
+        if (!reuse)
+            return new ReadPair(l, r);
+        if (mConcurrent) {
+            // the mate threads parse into the old reads again
+            mLeftStream.recycled.push_back(reuse->mLeft);
+            mRightStream.recycled.push_back(reuse->mRight);
+            reuse->mLeft = l;
+            reuse->mRight = r;
+        }
+        return reuse;
     }
 }
+
+// writes records named @p<i>/mate, with the records at swap and swap + 1 exchanged unless swap is negative
+static void writeMateFile(const string& filename, int count, int mate, int swap) {
+    ofstream ofs(filename);
+    for (int i = 0; i < count; i++) {
+        int id = i == swap ? i + 1 : (i == swap + 1 && swap >= 0 ? swap : i);
+        ofs << "@p" << id << "/" << mate << "\nACGTACGTAC\n+\nIIIIIIIIII\n";
+    }
+}
+
+// whether pairing the two files with the mate threads ends the process with an error.
+// it is read in a child, which must not flush the output buffered so far again
+static bool failsToPair(const string& left, const string& right) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stderr) == NULL)
+            _exit(0);
+        FastqReaderPair reader(left, right, true, false, false, 1 << 20, 0, 1, true);
+        ReadPair* pair = NULL;
+        while ((pair = reader.read()) != NULL)
+            delete pair;
+        _exit(0);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) != 0;
+}
+
+bool FastqReaderPair::test() {
+    bool passed = isMateName("@p0/1", "@p0/2")
+            && isMateName("@A00123:8:H3:1:1101:1000:2000 1:N:0:ACGT", "@A00123:8:H3:1:1101:1000:2000 2:N:0:ACGT")
+            && isMateName("@SRR001.7 HWI-1 length=100", "@SRR001.7 HWI-1 length=98")
+            && !isMateName("@p0/1", "@p1/2")
+            && !isMateName("@p1/1", "@p12/2")
+            && !isMateName("@SRR001.1", "@SRR001.2")
+            && !isMateName("@SRR001.7", "@SRR001.8");
+
+    // more pairs than fit one chunk of the mate threads
+    const int pairs = 2 * MATE_CHUNK_SIZE + 500;
+    string prefix = "/tmp/seq2fun_pair_test_" + to_string(getpid());
+    string left = prefix + "_R1.fq", right = prefix + "_R2.fq";
+    string swapped = prefix + "_R2_swapped.fq", swappedEnd = prefix + "_R2_swapped_end.fq", shorter = prefix + "_R2_shorter.fq";
+    writeMateFile(left, pairs, 1, -1);
+    writeMateFile(right, pairs, 2, -1);
+    // a pair out of order in the middle and the last two pairs exchanged
+    writeMateFile(swapped, pairs, 2, MATE_CHUNK_SIZE + 7);
+    writeMateFile(swappedEnd, pairs, 2, pairs - 2);
+    writeMateFile(shorter, pairs - 1, 2, -1);
+
+    {
+        FastqReaderPair reader(left, right, true, false, false, 1 << 20, 0, 1, true);
+        int count = 0;
+        ReadPair* pair = NULL;
+        while ((pair = reader.read()) != NULL) {
+            passed &= pair->mLeft->mName == "@p" + to_string(count) + "/1" && isMateName(pair->mLeft->mName, pair->mRight->mName);
+            count++;
+            delete pair;
+        }
+        passed &= count == pairs;
+    }
+
+    passed &= failsToPair(left, swapped);
+    passed &= failsToPair(left, swappedEnd);
+    passed &= failsToPair(left, shorter);
+    passed &= failsToPair(shorter, left);
+
+    remove(left.c_str());
+    remove(right.c_str());
+    remove(swapped.c_str());
+    remove(swappedEnd.c_str());
+    remove(shorter.c_str());
+    return passed;
+}
@@ -10,12 +10,26 @@
   #include "zlib/zlib.h"
 #endif
 #include "common.h"
+#include "bgzfdecompressor.h"
+#include "uringreader.h"
+#include "readchunk.h"
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 class FastqReader{
 public:
-	FastqReader(string filename, bool hasQuality = true, bool phred64=false, size_t fastqBufferSize=1<<20);
+	// with readahead > 0, .gz input is decompressed by a dedicated thread up to readahead blocks ahead of the parser,
+	// BGZF input is then inflated by decompressThreads threads.
+	// with ioUringDepth > 0, a regular file is read through io_uring with that many reads in flight,
+	// falling back to fread/gzread where io_uring is not available
+	FastqReader(string filename, bool hasQuality = true, bool phred64=false, size_t fastqBufferSize=1<<20, int readahead = 0, int decompressThreads = 1, int ioUringDepth = 0);
+	// parses records from memory, e.g. one range of a MappedFastq
+	FastqReader(const char* data, size_t len, bool hasQuality = true, bool phred64 = false);
 	~FastqReader();
 	bool isZipped();
 
@@ -23,21 +37,43 @@ public:
 
 	//this function is not thread-safe
 	//do not call read() of a same FastqReader object from different threads concurrently
-	Read* read();
+	//the record is parsed into reuse when it is given, which is then returned, a new Read otherwise
+	Read* read(Read* reuse = NULL);
+	// from now on the reads are left as views of chunks of pool, see Read::own().
+	// a caller keeping them past the next read() pins chunk() with a reference of its own
+	void viewInto(ReadChunkPool* pool);
+	inline ReadChunk* chunk() {return mChunk;}
 	bool eof();
 	bool hasNoLineBreakAtEnd();
+	// seconds read() spent waiting for the decompression thread
+	inline double getStallSeconds() {return mStallSeconds;}
+	inline string getFilename() {return mFilename;}
+	inline bool usesIoUring() {return mUring != NULL;}
 
 public:
 	static bool isZipFastq(string filename);
 	static bool isFastq(string filename);
 	static bool test();
+	// parses an uncompressed FASTQ file from memory and reports the throughput
+	static void benchmark(string filename);
 
 private:
 	void init();
 	void close();
-	string getLine();
+	// one line of the record being parsed, pointing into mBuf
+	struct LineView {
+		const char* data;
+		size_t len;
+	};
+	bool nextLine(size_t& pos, LineView& line);
+	// the count lines of the record at pos, false if it is cut by the end of the buffer
+	bool nextRecord(size_t& pos, LineView* lines, int count);
 	void clearLineBreaks(char* line);
 	void readToBuf();
+	long zipRead(char* buf, size_t len);
+	long uringZipRead(char* buf, size_t len);
+	void decompressTask();
+	long readDecompressed(char* buf, size_t len);
 
 private:
 	string mFilename;
@@ -47,23 +83,110 @@ private:
 	bool mHasQuality;
 	bool mPhred64;
 	char* mBuf;
-	int mBufDataLen;
-	int mBufUsedLen;
+	size_t mBufDataLen;
+	size_t mBufUsedLen;
+	bool mInputEnd;
+	// mBuf is not owned in memory mode, and is the data of mChunk when viewing into chunks
+	bool mMemoryMode;
+	ReadChunkPool* mChunkPool;
+	ReadChunk* mChunk;
 	bool mStdinMode;
 	bool mHasNoLineBreakAtEnd;
         size_t mFastqBufSize;
+	// size of the input, taken once when it is opened, for the loading progress
+	size_t mFileSize;
+
+	// readahead ring of decompressed blocks, filled by mDecompressThread
+	struct ReadaheadBlock {
+		vector<char> data;
+		size_t len;
+	};
+	int mReadahead;
+	int mDecompressThreads;
+	BgzfDecompressor* mBgzf;
+	std::thread* mDecompressThread;
+	std::vector<ReadaheadBlock> mBlocks;
+	size_t mBlockSize;
+	size_t mBlockHead;
+	size_t mBlockOffset;
+	size_t mBlocksFilled;
+	bool mDecompressDone;
+	bool mStopDecompress;
+	size_t mZipOffset;
+	std::mutex mBlockMtx;
+	std::condition_variable mBlockReady;
+	std::condition_variable mBlockFree;
+	double mStallSeconds;
+
+	// io_uring input, compressed input is then inflated from mZipIn by mZipStream instead of gzread
+	int mIoUringDepth;
+	UringReader* mUring;
+	z_stream mZipStream;
+	vector<char> mZipIn;
+	bool mZipMemberStart;
+	long mZipMembers;
+	bool mZipEnd;
+};
+
+// the reads of one mate file, parsed ahead by their own thread in chunks of MATE_CHUNK_SIZE
+struct MateStream {
+	FastqReader* reader;
+	std::thread* thread;
+	std::deque<std::vector<Read*>*> chunks;
+	// reads of recycled pairs: collected by the pairing thread, handed over with each chunk taken,
+	// and parsed into again by the mate thread
+	std::vector<Read*> recycled;
+	std::vector<Read*> spare;
+	std::vector<Read*>* current;
+	size_t pos;
+	bool done;
+	bool stop;
+	size_t bytesRead;
+	size_t bytesTotal;
+	// how long the mate thread waited for decompressed blocks, published with each chunk
+	double stallSeconds;
+	std::mutex mtx;
+	std::condition_variable ready;
+	std::condition_variable space;
 };
 
 class FastqReaderPair{
 public:
 	FastqReaderPair(FastqReader* left, FastqReader* right);
-	FastqReaderPair(string leftName, string rightName, bool hasQuality = true, bool phred64 = false, bool interleaved = false, size_t fastqBufferSize = 1<<20);
+	// with concurrent, the two files of non-interleaved input are parsed by one thread each
+	// and their reads paired by position, checking the names of every pair
+	FastqReaderPair(string leftName, string rightName, bool hasQuality = true, bool phred64 = false, bool interleaved = false, size_t fastqBufferSize = 1<<20, int readahead = 0, int decompressThreads = 1, bool concurrent = false, int ioUringDepth = 0);
 	~FastqReaderPair();
-	ReadPair* read();
+	// like FastqReader::read(), the pair is parsed into the reads of reuse when it is given
+	ReadPair* read(ReadPair* reuse = NULL);
+	// bytes of the left file consumed so far, safe to call while the mate threads run
+	void getBytes(size_t& bytesRead, size_t& bytesTotal);
+	// seconds each file waited for decompression, on its mate thread when concurrent, also safe while they run
+	void getStallSeconds(double& left, double& right);
+	inline bool isConcurrent() {return mConcurrent;}
+
+	// whether two read names belong to the same pair, ignoring comments and /1 /2 suffixes
+	static bool isMateName(const string& left, const string& right);
+	// exits with the error for mates that do not belong together
+	static void outOfPair(const string& where, const string& leftName, const string& rightName, const string& leftFile, const string& rightFile);
+	static bool test();
+
+private:
+	void startMateThread(MateStream* stream);
+	void mateTask(MateStream* stream);
+	Read* nextMate(MateStream* stream);
+	void stopMateThread(MateStream* stream);
+
 public:
 	FastqReader* mLeft;
 	FastqReader* mRight;
 	bool mInterleaved;
+
+private:
+	bool mConcurrent;
+	long mPairs;
+	MateStream mLeftStream;
+	MateStream mRightStream;
 };
 
 #endif
@@ -1,53 +1,63 @@
+
 #include "fragment.h"
 
-Fragment::Fragment(const std::string & s) {
+void FragmentSeq::assign(const std::string & s) {
     seq = s;
+    numSeq.clear();
 }
 
-Fragment::Fragment(const std::string & s, bool b) {
- seq = s;
- SEGchecked = true;
+void FragmentSeq::assign(const std::string & s, size_t start, size_t len) {
+    seq.assign(s, start, len);
+    numSeq.clear();
 }
 
-Fragment:: Fragment(const std::string & s, unsigned int n, unsigned int p, int d){
- seq = s;
- num_mm = n;
- diff = d;
- pos_lastmm = p;
+const char * FragmentSeq::encoded(AlphabetStruct * astruct) const {
+    if (numSeq.empty()) {
+        numSeq = seq;
+        translate2numbers((uchar *) &numSeq[0], (IndexType) numSeq.length(), astruct);
+    }
+    return numSeq.data();
 }
 
-Fragment::Fragment(const std::string & s, unsigned int n, unsigned int p, int d, IndexType arg_si0, IndexType arg_si1, int len){
- seq = s;
- num_mm = n;
- diff = d;
- pos_lastmm = p;
- si0 = arg_si0;
- si1 = arg_si1;
- matchlen = len;
- SEGchecked = true;
-} // fragments with substitutions have been checked before
+Fragment::Fragment(FragmentSeq * s) {
+    base = s;
+    len = (unsigned int) s->seq.length();
+}
 
-Fragment::Fragment(const std::string & s, unsigned int n, unsigned int p, int d, SI * si){
- seq = s;
- num_mm = n;
- diff = d;
- pos_lastmm = p;
- si0 = si->start;
- si1 = si->start + (IndexType) si->len;
- matchlen = si->ql;
+Fragment::Fragment(FragmentSeq * s, bool b) {
+    base = s;
+    len = (unsigned int) s->seq.length();
+    SEGchecked = true;
 }
 
-Fragment::Fragment(const std::string & s, unsigned int n, unsigned int p, SI * si){
- seq = s;
- num_mm = n;
- pos_lastmm = p;
- si0 = si->start;
- si1 = si->start + (IndexType) si->len;
- matchlen = si->ql; 
+Fragment::Fragment(const Fragment * parent, unsigned int end, unsigned int p, char aa, int d, IndexType arg_si0, IndexType arg_si1, int len) {
+    base = parent->base;
+    this->len = end;
+    num_mm = parent->num_mm + 1;
+    diff = d;
+    pos_lastmm = p;
+    for (unsigned int i = 0; i < parent->num_mm; i++) {
+        subst[i] = parent->subst[i];
+    }
+    subst[parent->num_mm].pos = p;
+    subst[parent->num_mm].aa = aa;
+    si0 = arg_si0;
+    si1 = arg_si1;
+    matchlen = len;
+    SEGchecked = true;
+} // fragments with substitutions have been checked before
+
+char Fragment::at(size_t i) const {
+    for (unsigned int k = 0; k < num_mm; k++) {
+        if (subst[k].pos == i) return subst[k].aa;
+    }
+    return base->seq[i];
 }
 
-Fragment::Fragment(const std::string & s, unsigned int n, unsigned int p) {
-seq = s;
-num_mm = n;
-pos_lastmm = p; 
-}
\ No newline at end of file
+std::string Fragment::str() const {
+    std::string s = base->seq.substr(0, len);
+    for (unsigned int k = 0; k < num_mm; k++) {
+        s[subst[k].pos] = subst[k].aa;
+    }
+    return s;
+}
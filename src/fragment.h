@@ -5,34 +5,59 @@
 
 extern "C" {
 #include "bwt/bwt.h"
+#include "bwt/sequence.h"
 }
 
 using namespace std;
 
-class Fragment {
+// the maximum number of amino acid substitutions one fragment can carry,
+// this bounds the --mismatch option
+static const unsigned int MAX_FRAGMENT_MISMATCHES = 8;
+
+// one translated ORF (or a piece of it after SEG masking).
+// it is shared read-only by the fragment and all its mismatch variants.
+class FragmentSeq {
 public:
+    // amino acid letters
     std::string seq;
+    // seq in the numeric alphabet of the FM index, encoded on first search
+    mutable std::string numSeq;
+
+    void assign(const std::string & s);
+    void assign(const std::string & s, size_t start, size_t len);
+    const char * encoded(AlphabetStruct * astruct) const;
+};
+
+class Substitution {
+public:
+    unsigned int pos;
+    char aa;
+};
+
+class Fragment {
+public:
+    const FragmentSeq * base;
+    // the fragment covers base->seq[0, len)
+    unsigned int len;
     unsigned int num_mm = 0;
+    // score difference of the substitutions against the unsubstituted base sequence
     int diff = 0;
     unsigned int pos_lastmm = 0;
+    Substitution subst[MAX_FRAGMENT_MISMATCHES];
     IndexType si0, si1, arg_si0, arg_si1;
     int matchlen;
     bool SEGchecked = false;
 
-    Fragment(const std::string & s);
-
-    Fragment(const std::string & s, bool b);
+    Fragment(FragmentSeq * s);
 
-    Fragment(const std::string & s, unsigned int n, unsigned int p, int d);
+    Fragment(FragmentSeq * s, bool b);
 
-    Fragment(const std::string & s, unsigned int n, unsigned int p, int d, IndexType arg_si0, IndexType arg_si1, int len);
+    // mismatch variant of parent with aa at position p, cut to length end
+    Fragment(const Fragment * parent, unsigned int end, unsigned int p, char aa, int d, IndexType arg_si0, IndexType arg_si1, int len);
 
-    Fragment(const std::string & s, unsigned int n, unsigned int p, int d, SI * si);
-
-    Fragment(const std::string & s, unsigned int n, unsigned int p, SI * si);
-
-    Fragment(const std::string & s, unsigned int n, unsigned int p);
+    char at(size_t i) const;
+    // the substituted sequence, only needed for debug and verbose output
+    std::string str() const;
 };
 
 #endif /* FRAGMENT_H */
-
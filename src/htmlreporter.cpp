@@ -518,8 +518,8 @@ void HtmlReporter::reportBarPlotId(ofstream& ofs){
     std::string ko, go, symbol, gene;
     uint32 count;
     for(const auto & it : mOptions->transSearch.totalIdFreqUMapResults){
-        auto itt = mOptions->mHomoSearchOptions.fullDbMap.find(it.first);
-        if(itt == mOptions->mHomoSearchOptions.fullDbMap.end()){
+        auto itt = mOptions->db->fullDbMap.find(it.first);
+        if(itt == mOptions->db->fullDbMap.end()){
             count = 0; ko = "U"; go = "U"; symbol = "U"; gene = "U";
         } else {
             count = it.second;
@@ -275,8 +275,8 @@ void HtmlReporterAll::reportAllTables() {
         }
         idFreqVec.push_back(std::pair<const uint32 *, std::vector<uint32> >(it, tmpIdVec));
 
-        auto itid = mOptions->mHomoSearchOptions.fullDbMap.find(it);
-        if (itid == mOptions->mHomoSearchOptions.fullDbMap.end()) {
+        auto itid = mOptions->db->fullDbMap.find(it);
+        if (itid == mOptions->db->fullDbMap.end()) {
             *fOut << "U\t0\n";
         } else {
             *fOut << itid->second.ko << "|" << itid->second.go << "|" << itid->second.symbol << "|" << itid->second.gene << "\t" << itid->second.coreOrthoPer << "\n";
@@ -331,8 +331,8 @@ void HtmlReporterAll::reportAllTables() {
     *fOut << "s2f_id\tKO\tGO\tSymbol\tGene\tOrthologFreq\n";
     for (const auto & it : idSet) {
         *fOut << "s2f_" << std::setfill('0') << std::setw(10) << *it << "\t";
-        auto itid = mOptions->mHomoSearchOptions.fullDbMap.find(it);
-        if (itid == mOptions->mHomoSearchOptions.fullDbMap.end()) {
+        auto itid = mOptions->db->fullDbMap.find(it);
+        if (itid == mOptions->db->fullDbMap.end()) {
             *fOut << "U\tU\tU\tU\t0\n";
         } else {
             *fOut << itid->second.ko << "\t" << itid->second.go << "\t" << itid->second.symbol << "\t" << itid->second.gene << "\t" << itid->second.coreOrthoPer << "\n";
@@ -719,8 +719,8 @@ void HtmlReporterAll::reportS2fBarPlot(ofstream& ofs){
             ofs << "<td class='ko_col'>" << itt << "</td>";
         }
         
-        auto itr = mOptions->mHomoSearchOptions.fullDbMap.find(const_cast<const uint32 *>(it.first));
-        if(itr == mOptions->mHomoSearchOptions.fullDbMap.end()){
+        auto itr = mOptions->db->fullDbMap.find(const_cast<const uint32 *>(it.first));
+        if(itr == mOptions->db->fullDbMap.end()){
              ofs << "<td class='ko_col'>" << 'U' << "</td>";
              ofs << "<td class='collarge'>" << 'U' << "</td>";
              ofs << "<td class='ko_col'>" << 'U' << "</td>";
@@ -4,6 +4,8 @@ JsonReporter::JsonReporter(Options* & opt){
     mOptions = opt;
     mDupHist = NULL;
     mDupRate = 0;
+    mScheduler = NULL;
+    mSizer = NULL;
 }
 
 JsonReporter::~JsonReporter(){
@@ -20,6 +22,14 @@ void JsonReporter::setInsertHist(atomic_long* insertHist, int insertSizePeak) {
     mInsertSizePeak = insertSizePeak;
 }
 
+void JsonReporter::setScheduler(StageScheduler* scheduler) {
+    mScheduler = scheduler;
+}
+
+void JsonReporter::setPackSizer(PackSizer* sizer) {
+    mSizer = sizer;
+}
+
 extern string command;
 void JsonReporter::report(FilterResult* result, Stats* preStats1, Stats* postStats1, Stats* preStats2, Stats* postStats2) {
     ofstream ofs;
@@ -181,6 +191,16 @@ void JsonReporter::report(FilterResult* result, Stats* preStats1, Stats* postSta
         postStats2 -> reportJson(ofs, "\t");
     }
 
+    if(mScheduler) {
+        ofs << "\t" << "\"worker_stages\": " ;
+        mScheduler->reportJson(ofs, "\t");
+    }
+
+    if(mSizer) {
+        ofs << "\t" << "\"pack_sizing\": " ;
+        mSizer->reportJson(ofs, "\t");
+    }
+
     ofs << "\t\"command\": " << "\"" << command << "\"" << endl;
 
     ofs << "}";
@@ -12,6 +12,8 @@
 #include "filterresult.h"
 #include "common.h"
 #include "util.h"
+#include "stagescheduler.h"
+#include "packsizer.h"
 
 using namespace std;
 
@@ -22,6 +24,8 @@ public:
 
     void setDupHist(int* dupHist, double* dupMeanGC, double dupRate);
     void setInsertHist(atomic_long* insertHist, int insertSizePeak);
+    void setScheduler(StageScheduler* scheduler);
+    void setPackSizer(PackSizer* sizer);
     void report(FilterResult* result, Stats* preStats1, Stats* postStats1, Stats* preStats2 = NULL, Stats* postStats2 = NULL);
 
 private:
@@ -31,6 +35,8 @@ private:
     double mDupRate;
     atomic_long* mInsertHist;
     int mInsertSizePeak;
+    StageScheduler* mScheduler;
+    PackSizer* mSizer;
 };
 
 
@@ -0,0 +1,132 @@
+#include "linescanner.h"
+#include <string.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #define LINE_SCANNER_X86
+  #include <immintrin.h>
+#endif
+
+static const size_t NO_SKIP = (size_t) -1;
+
+// takes the line at offset i, skip is the \n of a \r\n that was already counted with its \r
+static inline bool takeEnd(const char* data, size_t len, size_t i, size_t* ends, size_t& found, size_t maxLines, size_t& skip) {
+    if (i == skip)
+        return false;
+    ends[found++] = i;
+    if (data[i] == '\r' && i + 1 < len && data[i + 1] == '\n')
+        skip = i + 1;
+    return found == maxLines;
+}
+
+static size_t scanTail(const char* data, size_t len, size_t start, size_t* ends, size_t found, size_t maxLines, size_t skip) {
+    for (size_t i = start; i < len; i++) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            if (takeEnd(data, len, i, ends, found, maxLines, skip))
+                break;
+        }
+    }
+    return found;
+}
+
+static size_t findLineEndsMemchr(const char* data, size_t len, size_t* ends, size_t maxLines) {
+    size_t found = 0;
+    size_t pos = 0;
+    // the next \n is kept across lines, so files with bare \r line breaks are not scanned again for every line
+    size_t nl = 0;
+    bool nlValid = false;
+    while (found < maxLines && pos < len) {
+        if (!nlValid || nl < pos) {
+            const char* p = (const char*) memchr(data + pos, '\n', len - pos);
+            nl = p ? p - data : len;
+            nlValid = true;
+        }
+        const char* r = (const char*) memchr(data + pos, '\r', nl - pos);
+        size_t end = r ? r - data : nl;
+        if (end == len)
+            break;
+        ends[found++] = end;
+        pos = end + 1;
+        if (data[end] == '\r' && pos < len && data[pos] == '\n')
+            pos++;
+    }
+    return found;
+}
+
+#ifdef LINE_SCANNER_X86
+static size_t findLineEndsSSE2(const char* data, size_t len, size_t* ends, size_t maxLines) {
+    size_t found = 0;
+    size_t skip = NO_SKIP;
+    size_t i = 0;
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (takeEnd(data, len, pos, ends, found, maxLines, skip))
+                return found;
+        }
+    }
+    return scanTail(data, len, i, ends, found, maxLines, skip);
+}
+
+__attribute__((target("avx2")))
+static size_t findLineEndsAVX2(const char* data, size_t len, size_t* ends, size_t maxLines) {
+    size_t found = 0;
+    size_t skip = NO_SKIP;
+    size_t i = 0;
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (takeEnd(data, len, pos, ends, found, maxLines, skip))
+                return found;
+        }
+    }
+    return scanTail(data, len, i, ends, found, maxLines, skip);
+}
+#endif
+
+typedef size_t (*LineScanner)(const char*, size_t, size_t*, size_t);
+
+struct LineScannerChoice {
+    LineScanner scan;
+    const char* name;
+};
+
+static LineScannerChoice pickLineScanner() {
+    LineScannerChoice choice;
+#ifdef LINE_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        choice.scan = findLineEndsAVX2;
+        choice.name = "avx2";
+        return choice;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        choice.scan = findLineEndsSSE2;
+        choice.name = "sse2";
+        return choice;
+    }
+#endif
+    choice.scan = findLineEndsMemchr;
+    choice.name = "memchr";
+    return choice;
+}
+
+static const LineScannerChoice lineScanner = pickLineScanner();
+
+size_t findLineEnds(const char* data, size_t len, size_t* ends, size_t maxLines) {
+    if (maxLines == 0)
+        return 0;
+    return lineScanner.scan(data, len, ends, maxLines);
+}
+
+const char* lineScannerName() {
+    return lineScanner.name;
+}
@@ -0,0 +1,16 @@
+#ifndef LINE_SCANNER_H
+#define LINE_SCANNER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// finds the ends of up to maxLines lines in [data, data + len) in a single pass.
+// a line ends at '\n', '\r' or "\r\n", the last counting once. ends[i] is the offset
+// of the first terminator byte of line i. returns the number of line ends found.
+// uses AVX2 or SSE2 when the CPU has it and memchr otherwise
+size_t findLineEnds(const char* data, size_t len, size_t* ends, size_t maxLines);
+
+// name of the implementation picked for this CPU: "avx2", "sse2" or "memchr"
+const char* lineScannerName();
+
+#endif
@@ -0,0 +1,114 @@
+#include "mappedfastq.h"
+#include "util.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFastq::MappedFastq(string filename) {
+    mFilename = filename;
+    mData = NULL;
+    mSize = 0;
+    mFd = open(filename.c_str(), O_RDONLY);
+    if (mFd < 0)
+        error_exit("Failed to open file: " + filename);
+    struct stat st;
+    if (fstat(mFd, &st) != 0)
+        error_exit("Failed to stat file: " + filename);
+    mSize = st.st_size;
+    if (mSize > 0) {
+        void* p = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+        if (p == MAP_FAILED)
+            error_exit("Failed to mmap file: " + filename);
+        mData = (char*) p;
+        madvise(mData, mSize, MADV_SEQUENTIAL);
+    }
+}
+
+MappedFastq::~MappedFastq() {
+    if (mData)
+        munmap(mData, mSize);
+    if (mFd >= 0)
+        close(mFd);
+}
+
+bool MappedFastq::canMap(string filename) {
+    if (filename.empty() || filename == "/dev/stdin" || ends_with(filename, ".gz"))
+        return false;
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// start of the line after the one containing pos
+size_t MappedFastq::nextLine(size_t pos) {
+    if (pos >= mSize)
+        return mSize;
+    const char* p = (const char*) memchr(mData + pos, '\n', mSize - pos);
+    return p ? p - mData + 1 : mSize;
+}
+
+// the first record starting at or after pos. a record starts with a '@' line
+// two lines before a '+' line, which tells names from qualities starting with '@'
+size_t MappedFastq::nextRecordStart(size_t pos) {
+    if (pos == 0)
+        return 0;
+    size_t line = (mData[pos - 1] == '\n') ? pos : nextLine(pos);
+    while (line < mSize) {
+        if (mData[line] == '@') {
+            size_t third = nextLine(nextLine(line));
+            if (third < mSize && mData[third] == '+')
+                return line;
+        }
+        line = nextLine(line);
+    }
+    return mSize;
+}
+
+// blank lines between records are skipped like FastqReader does
+size_t MappedFastq::skipBlankLines(size_t pos) {
+    while (pos < mSize && (mData[pos] == '\n' || mData[pos] == '\r'))
+        pos = nextLine(pos);
+    return pos;
+}
+
+// the start of the record after the one at pos
+size_t MappedFastq::skipRecord(size_t pos) {
+    for (int i = 0; i < 4; i++)
+        pos = nextLine(pos);
+    return skipBlankLines(pos);
+}
+
+vector<pair<size_t, size_t> > MappedFastq::split(int n) {
+    vector<pair<size_t, size_t> > ranges;
+    size_t start = 0;
+    for (int i = 1; i <= n; i++) {
+        size_t end = (i == n) ? mSize : nextRecordStart(max(start, mSize / n * i));
+        ranges.push_back(make_pair(start, end));
+        start = end;
+    }
+    return ranges;
+}
+
+void MappedFastq::splitPaired(MappedFastq* left, MappedFastq* right, int n,
+        vector<pair<size_t, size_t> >& leftRanges, vector<pair<size_t, size_t> >& rightRanges) {
+    leftRanges = left->split(n);
+    rightRanges.clear();
+    // index pass: count the records of each left range, then step over as many records in right
+    size_t rightStart = 0;
+    for (int i = 0; i < n; i++) {
+        size_t records = 0;
+        for (size_t pos = left->skipBlankLines(leftRanges[i].first); pos < leftRanges[i].second; pos = left->skipRecord(pos))
+            records++;
+        size_t rightEnd = rightStart;
+        if (i == n - 1) {
+            rightEnd = right->mSize;
+        } else {
+            rightEnd = right->skipBlankLines(rightEnd);
+            for (size_t r = 0; r < records && rightEnd < right->mSize; r++)
+                rightEnd = right->skipRecord(rightEnd);
+        }
+        rightRanges.push_back(make_pair(rightStart, rightEnd));
+        rightStart = rightEnd;
+    }
+}
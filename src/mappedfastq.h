@@ -0,0 +1,45 @@
+#ifndef MAPPED_FASTQ_H
+#define MAPPED_FASTQ_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+// an uncompressed FASTQ file mapped into memory, split into byte ranges that
+// start at record boundaries so that each worker thread can parse its own range
+// with a FastqReader over memory
+class MappedFastq {
+public:
+    MappedFastq(string filename);
+    ~MappedFastq();
+
+    inline const char* data() {return mData;}
+    inline size_t size() {return mSize;}
+
+    // n ranges of about the same size, each starting at a record
+    vector<pair<size_t, size_t> > split(int n);
+    // n ranges of left and right that hold the same records of a pair of files
+    static void splitPaired(MappedFastq* left, MappedFastq* right, int n,
+            vector<pair<size_t, size_t> >& leftRanges, vector<pair<size_t, size_t> >& rightRanges);
+
+    // a regular uncompressed file, not stdin and not .gz
+    static bool canMap(string filename);
+
+private:
+    size_t nextLine(size_t pos);
+    size_t nextRecordStart(size_t pos);
+    size_t skipBlankLines(size_t pos);
+    size_t skipRecord(size_t pos);
+
+private:
+    string mFilename;
+    int mFd;
+    char* mData;
+    size_t mSize;
+};
+
+#endif
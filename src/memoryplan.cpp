@@ -0,0 +1,249 @@
+#include "memoryplan.h"
+#include "numaindex.h"
+#include "util.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+
+// a read of about 150 bases as parsed into the pack pool, with the copy the qc stage trims
+static const size_t PLAN_READ_BYTES = 1024;
+// the fastq text of such a read, which single-end reads view in the input chunks until the qc stage
+static const size_t PLAN_RECORD_BYTES = 350;
+// the fastq text a mapped read adds to the output of its pack
+static const size_t PLAN_OUTPUT_READ_BYTES = 400;
+// stats, filter results and search buffers of a worker, besides its vote vectors over the orthologs
+static const size_t PLAN_THREAD_BYTES = 4 << 20;
+// a BGZF block and its compressed member, and the deflate state of a compressing thread
+static const size_t PLAN_BGZF_BLOCK_BYTES = 128 << 10;
+static const size_t PLAN_DEFLATE_BYTES = 256 << 10;
+// a Duplicate entry is a uint64, a uint16 and a uint8 for each key
+static const size_t PLAN_DUP_ENTRY_BYTES = 11;
+// a SEG cache entry is a hash node holding a fragment of some 20 to 60 amino acids and its regions
+static const size_t PLAN_SEG_ENTRY_BYTES = 160;
+static const int PLAN_MIN_SEG_CACHE = 1000;
+static const int PLAN_MIN_WRITER_QUEUE = 2;
+static const int PLAN_MIN_DUP_KEYLEN = 8;
+
+MemoryPlan::MemoryPlan(Options* opt, size_t budget) {
+    mBudget = budget;
+    mResident = residentBytes();
+
+    mIndex = 0;
+    struct stat st;
+    if (!opt->transSearch.tfmi.empty() && stat(opt->transSearch.tfmi.c_str(), &st) == 0)
+        mIndex = st.st_size;
+    // the copies are made while the loaded index is still there
+    mIndexCopies = 1;
+    NumaIndex::Mode numaMode = NumaIndex::NUMA_OFF;
+    NumaIndex::parseMode(opt->numa, numaMode);
+    if (numaMode != NumaIndex::NUMA_OFF) {
+        NumaIndex numa(NumaIndex::NUMA_OFF);
+        if (numa.nodes() > 1)
+            mIndexCopies = numaMode == NumaIndex::NUMA_REPLICATE ? numa.nodes() : 1;
+    }
+
+    mMates = opt->in2.empty() && !opt->interleavedInput ? 1 : 2;
+    for (size_t i = 0; i < opt->samples.size(); i++) {
+        if (!opt->samples[i].in2.empty())
+            mMates = 2;
+    }
+    mSamples = 1;
+    if (!opt->samples.empty())
+        mSamples = max(1, min((int) opt->samples.size(), opt->concurrentSamples));
+    mWorkers = max(1, opt->thread / mSamples);
+
+    mWriters = 0;
+    if (opt->outputMappedCleanReads)
+        mWriters += mMates;
+    if (opt->outputReadsAnnoMap)
+        mWriters++;
+    if (!opt->failedOut.empty())
+        mWriters++;
+    if (!opt->unpaired1.empty())
+        mWriters++;
+    if (!opt->unpaired2.empty())
+        mWriters++;
+    if (opt->merge.enabled && !opt->merge.out.empty())
+        mWriters++;
+    mCompressThreads = opt->compressThreads;
+
+    // the read buffer of each file, the blocks decompressed ahead and the chunks of parsed mates
+    size_t perFile = opt->fastqBufferSize * (1 + opt->readahead + (opt->readahead > 0 ? opt->decompressThreads : 0));
+    mInput = perFile * mMates;
+    if (mMates == 2)
+        mInput += 2 * (size_t) MATE_QUEUE_DEPTH * MATE_CHUNK_SIZE * PLAN_READ_BYTES / 2;
+
+    mThreads = (size_t) opt->thread * (PLAN_THREAD_BYTES + 2 * sizeof(uint32) * opt->db->orthIdVec.size());
+
+    mDuplicate = opt->duplicate.enabled;
+    mDupKeyLen = opt->duplicate.keylen;
+    mSEG = opt->transSearch.SEG;
+    mSegCacheLimit = opt->segCacheLimit;
+    mPackQueueDepth = opt->packQueueDepth;
+    mWriterQueueDepth = opt->writerQueueDepth;
+    mPackSizeMax = opt->packSizeMax;
+}
+
+size_t MemoryPlan::residentBytes() {
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL)
+        return 0;
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return (size_t) resident * sysconf(_SC_PAGESIZE);
+}
+
+// the queue holds the reads of mPackQueueDepth packs of PACK_SIZE, and about two packs per worker are being processed
+size_t MemoryPlan::packBytes() {
+    size_t perRead = mMates * PLAN_READ_BYTES + (mMates == 1 ? PLAN_RECORD_BYTES : 0);
+    return ((size_t) mPackQueueDepth * PACK_SIZE + (size_t) 2 * mWorkers * mPackSizeMax) * perRead;
+}
+
+size_t MemoryPlan::writerBytes() {
+    size_t queue = (size_t) mWriterQueueDepth * mPackSizeMax * PLAN_OUTPUT_READ_BYTES;
+    size_t compress = mCompressThreads > 1 ? mCompressThreads * (4 * PLAN_BGZF_BLOCK_BYTES + PLAN_DEFLATE_BYTES) : PLAN_DEFLATE_BYTES;
+    return mWriters * (queue + compress);
+}
+
+size_t MemoryPlan::duplicateBytes() {
+    return mDuplicate ? PLAN_DUP_ENTRY_BYTES << (2 * mDupKeyLen) : 0;
+}
+
+// each worker of every sample has a searcher with its own cache
+size_t MemoryPlan::segCacheBytes() {
+    return mSEG ? (size_t) mSamples * mWorkers * mSegCacheLimit * PLAN_SEG_ENTRY_BYTES : 0;
+}
+
+size_t MemoryPlan::total() {
+    size_t buffers = mSamples * (packBytes() + writerBytes() + duplicateBytes() + mInput) + mThreads + segCacheBytes();
+    // while the index is copied to the NUMA nodes the loaded one is still there, but no buffer is yet
+    size_t loading = mIndexCopies > 1 ? mIndex * (mIndexCopies + 1) : 0;
+    return mResident + max(mIndex * mIndexCopies + buffers, loading);
+}
+
+bool MemoryPlan::fit() {
+    if (mBudget == 0)
+        return true;
+    int minPackQueue = min(mPackQueueDepth, max(2, mWorkers));
+    int minWriterQueue = min(mWriterQueueDepth, PLAN_MIN_WRITER_QUEUE);
+    int minSegCache = min(mSegCacheLimit, PLAN_MIN_SEG_CACHE);
+    while (total() > mBudget) {
+        if (mSEG && mSegCacheLimit > minSegCache)
+            mSegCacheLimit = max(minSegCache, mSegCacheLimit / 2);
+        else if (mWriters > 0 && mWriterQueueDepth > minWriterQueue)
+            mWriterQueueDepth = max(minWriterQueue, mWriterQueueDepth / 2);
+        else if (mPackQueueDepth > minPackQueue)
+            mPackQueueDepth = max(minPackQueue, mPackQueueDepth / 2);
+        else if (mPackSizeMax > PACK_SIZE_MIN)
+            mPackSizeMax = max(PACK_SIZE_MIN, mPackSizeMax / 2);
+        else if (mDuplicate && mDupKeyLen > PLAN_MIN_DUP_KEYLEN)
+            mDupKeyLen--;
+        else
+            return false;
+    }
+    return true;
+}
+
+void MemoryPlan::apply(Options* opt) {
+    opt->packQueueDepth = mPackQueueDepth;
+    opt->writerQueueDepth = mWriterQueueDepth;
+    opt->packSizeMax = mPackSizeMax;
+    opt->duplicate.keylen = mDupKeyLen;
+    opt->segCacheLimit = mSegCacheLimit;
+}
+
+string MemoryPlan::describe() {
+    stringstream ss;
+    ss << "memory plan";
+    if (mBudget > 0)
+        ss << " within " << formatSize(mBudget);
+    ss << ": resident " << formatSize(mResident);
+    ss << ", index " << formatSize(mIndex);
+    if (mIndexCopies > 1)
+        ss << " x " << mIndexCopies << " copies";
+    if (mSamples > 1)
+        ss << ", for each of " << mSamples << " samples";
+    ss << ", packs " << mPackQueueDepth << " queued of up to " << mPackSizeMax << " reads " << formatSize(packBytes());
+    ss << ", writer queues " << mWriters << " x " << mWriterQueueDepth << " packs " << formatSize(writerBytes());
+    if (mDuplicate)
+        ss << ", duplication keylen " << mDupKeyLen << " " << formatSize(duplicateBytes());
+    ss << ", input " << formatSize(mInput);
+    if (mSEG)
+        ss << ", SEG caches " << mSamples * mWorkers << " x " << mSegCacheLimit << " fragments " << formatSize(segCacheBytes());
+    ss << ", threads " << formatSize(mThreads);
+    ss << "; total " << formatSize(total());
+    return ss.str();
+}
+
+size_t MemoryPlan::parseSize(string str) {
+    if (str.empty())
+        return 0;
+    size_t unit = 1;
+    char suffix = toupper(str.back());
+    if (suffix == 'B' && str.size() > 1) {
+        str.pop_back();
+        suffix = toupper(str.back());
+    }
+    if (suffix == 'K' || suffix == 'M' || suffix == 'G' || suffix == 'T') {
+        unit = suffix == 'K' ? 1UL << 10 : suffix == 'M' ? 1UL << 20 : suffix == 'G' ? 1UL << 30 : 1UL << 40;
+        str.pop_back();
+    }
+    char* end = NULL;
+    double value = strtod(str.c_str(), &end);
+    if (str.empty() || end == NULL || *end != '\0' || value <= 0)
+        return 0;
+    return (size_t) (value * unit);
+}
+
+string MemoryPlan::formatSize(size_t bytes) {
+    const char* units[] = {"B", "K", "M", "G", "T"};
+    double value = bytes;
+    int u = 0;
+    while (value >= 1024 && u < 4) {
+        value /= 1024;
+        u++;
+    }
+    stringstream ss;
+    ss.precision(value < 10 && u > 0 ? 2 : 0);
+    ss << fixed << value << units[u];
+    return ss.str();
+}
+
+bool MemoryPlan::test() {
+    bool passed = parseSize("4G") == (4UL << 30) && parseSize("512m") == (512UL << 20)
+            && parseSize("1.5GB") == (3UL << 29) && parseSize("100") == 100
+            && parseSize("x") == 0 && parseSize("") == 0 && parseSize("-1G") == 0;
+
+    Options opt;
+    opt.thread = 8;
+    opt.outputMappedCleanReads = true;
+    opt.outputReadsAnnoMap = true;
+    MemoryPlan unlimited(&opt, 0);
+    passed &= unlimited.fit();
+    size_t full = unlimited.total();
+
+    // a little less: only the SEG caches shrink
+    size_t budget = full - unlimited.segCacheBytes() / 4;
+    MemoryPlan cacheOnly(&opt, budget);
+    passed &= cacheOnly.fit() && cacheOnly.total() <= budget;
+    passed &= cacheOnly.mSegCacheLimit == SEG_CACHE_LIMIT / 2 && cacheOnly.mWriterQueueDepth == opt.writerQueueDepth
+            && cacheOnly.mPackQueueDepth == opt.packQueueDepth && cacheOnly.mPackSizeMax == opt.packSizeMax;
+
+    // more than the caches and queues can give back: they shrink to their least, then the duplication table
+    budget = full - unlimited.segCacheBytes() - unlimited.packBytes() - unlimited.writerBytes() - unlimited.duplicateBytes() / 2;
+    MemoryPlan tight(&opt, budget);
+    passed &= tight.fit() && tight.total() <= budget;
+    passed &= tight.mSegCacheLimit == PLAN_MIN_SEG_CACHE;
+    passed &= tight.mWriterQueueDepth == PLAN_MIN_WRITER_QUEUE && tight.mPackQueueDepth == 8 && tight.mPackSizeMax == PACK_SIZE_MIN;
+    passed &= tight.mDupKeyLen < opt.duplicate.keylen && tight.mDupKeyLen >= PLAN_MIN_DUP_KEYLEN;
+    tight.apply(&opt);
+    passed &= opt.packQueueDepth == 8 && opt.writerQueueDepth == PLAN_MIN_WRITER_QUEUE && opt.packSizeMax == PACK_SIZE_MIN
+            && opt.segCacheLimit == PLAN_MIN_SEG_CACHE;
+
+    // less than is resident already
+    MemoryPlan tooSmall(&opt, 1 << 20);
+    passed &= !tooSmall.fit();
+    return passed;
+}
@@ -0,0 +1,65 @@
+#ifndef MEMORY_PLAN_H
+#define MEMORY_PLAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "options.h"
+
+using namespace std;
+
+// plans the buffers of a run within --max_memory before the index is loaded.
+// the database tables are already in memory and measured as resident, the index is taken at the
+// size of its file for every copy the NUMA placement makes, and the rest are estimates of the
+// pack pool, the writer queues, the duplication table, the input buffers, the SEG result caches and
+// the per-thread state. what does not fit is shrunk in the order it costs the least speed: the SEG
+// result caches, the writer queues, the pack queue, the largest pack size, then the key length of
+// the duplication table, and the run fails if the smallest does not fit
+class MemoryPlan {
+public:
+    MemoryPlan(Options* opt, size_t budget);
+
+    // shrinks the buffers until they fit the budget, false if they can not
+    bool fit();
+    // writes the planned sizes to the options
+    void apply(Options* opt);
+    size_t total();
+    string describe();
+
+    // a size in bytes with an optional K, M, G or T suffix, 0 if it can not be parsed
+    static size_t parseSize(string str);
+    static string formatSize(size_t bytes);
+    static bool test();
+
+private:
+    size_t packBytes();
+    size_t writerBytes();
+    size_t duplicateBytes();
+    size_t segCacheBytes();
+    static size_t residentBytes();
+
+private:
+    size_t mBudget;
+    // measured or fixed by the settings
+    size_t mResident;
+    size_t mIndex;
+    int mIndexCopies;
+    size_t mInput;
+    size_t mThreads;
+    // the buffers of one sample are needed by each sample processed at the same time
+    int mSamples;
+    int mWorkers;
+    int mMates;
+    int mWriters;
+    int mCompressThreads;
+    bool mDuplicate;
+    bool mSEG;
+    // what the plan sizes
+    int mPackQueueDepth;
+    int mWriterQueueDepth;
+    int mPackSizeMax;
+    int mDupKeyLen;
+    int mSegCacheLimit;
+};
+
+#endif
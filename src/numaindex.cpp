@@ -0,0 +1,355 @@
+#include "numaindex.h"
+#include "util.h"
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#if defined(__linux__)
+  #include <sched.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+#endif
+#if defined(__linux__) && defined(__NR_mbind) && defined(CPU_SET)
+  #define NUMA_INDEX_SYSCALLS
+#endif
+
+// memory policies of linux/mempolicy.h, which is not always installed
+static const int NUMA_MPOL_PREFERRED = 1;
+static const int NUMA_MPOL_INTERLEAVE = 3;
+static const int NUMA_MAX_NODES = 1024;
+
+static size_t alignUp(size_t n) {
+    return (n + 63) & ~((size_t) 63);
+}
+
+// "0-3,8-11" as in /sys/devices/system/node
+static vector<int> parseList(string list) {
+    vector<int> ids;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty() || range[0] == '\n')
+            continue;
+        int first = 0, last = 0;
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+            for (int i = first; i <= last; i++)
+                ids.push_back(i);
+        } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+            ids.push_back(first);
+        }
+    }
+    return ids;
+}
+
+static string readLine(string filename) {
+    ifstream in(filename.c_str());
+    string line;
+    if (in.is_open())
+        getline(in, line);
+    return line;
+}
+
+static bool pinTo(const vector<int>& cpus) {
+#ifdef NUMA_INDEX_SYSCALLS
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++)
+        CPU_SET(cpus[i], &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+NumaIndex::NumaIndex(Mode mode) {
+    mMode = mode;
+    mFmi = NULL;
+    mSa = NULL;
+    detectNodes();
+}
+
+NumaIndex::~NumaIndex() {
+    for (size_t i = 0; i < mCopies.size(); i++)
+        freeCopy(mCopies[i]);
+    mCopies.clear();
+}
+
+bool NumaIndex::parseMode(string name, Mode& mode) {
+    if (name == "off")
+        mode = NUMA_OFF;
+    else if (name == "interleave")
+        mode = NUMA_INTERLEAVE;
+    else if (name == "replicate")
+        mode = NUMA_REPLICATE;
+    else
+        return false;
+    return true;
+}
+
+void NumaIndex::detectNodes() {
+    mNodeCpus.clear();
+    mNodeIds.clear();
+    vector<bool> allowed;
+#ifdef NUMA_INDEX_SYSCALLS
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            allowed.push_back(CPU_ISSET(c, &set));
+    }
+#endif
+    vector<int> online = parseList(readLine("/sys/devices/system/node/online"));
+    for (size_t n = 0; n < online.size() && online[n] < NUMA_MAX_NODES; n++) {
+        vector<int> cpus = parseList(readLine("/sys/devices/system/node/node" + to_string(online[n]) + "/cpulist"));
+        vector<int> usable;
+        for (size_t c = 0; c < cpus.size(); c++) {
+            if (allowed.empty() || (cpus[c] < (int) allowed.size() && allowed[cpus[c]]))
+                usable.push_back(cpus[c]);
+        }
+        // memory-only nodes and nodes outside our cpuset get no workers
+        if (!usable.empty()) {
+            mNodeCpus.push_back(usable);
+            mNodeIds.push_back(online[n]);
+        }
+    }
+    if (mNodeCpus.empty()) {
+        vector<int> cpus;
+        for (size_t c = 0; c < allowed.size(); c++) {
+            if (allowed[c])
+                cpus.push_back(c);
+        }
+        mNodeCpus.push_back(cpus);
+        mNodeIds.push_back(0);
+    }
+}
+
+// one block holding the FMI, its checkpoint tables, the BWT and the suffix array checkpoints,
+// with the memory policy set before the pages are first touched
+NumaIndex::Copy NumaIndex::copyIndex(FMI* fmi, suffixArray* sa, int policy, const vector<int>& nodes) {
+    size_t alen = fmi->alen;
+    size_t fmiAt = 0;
+    size_t saAt = fmiAt + alignUp(sizeof(FMI));
+    size_t index1PtrAt = saAt + alignUp(sizeof(suffixArray));
+    size_t index2PtrAt = index1PtrAt + alignUp(fmi->N1 * sizeof(IndexType*));
+    size_t index1At = index2PtrAt + alignUp(fmi->N2 * sizeof(ushort*));
+    size_t index2At = index1At + alignUp(fmi->N1 * alen * sizeof(IndexType));
+    size_t codesAt = index2At + alignUp(fmi->N2 * alen * sizeof(ushort));
+    size_t bwtAt = codesAt + alignUp((alen + 1) * sizeof(int));
+    size_t checkpointsAt = bwtAt + alignUp(fmi->bwtlen);
+    size_t bytes = checkpointsAt + alignUp(sa ? sa->ncheck * sa->nbytes : 0);
+
+    Copy copy;
+    copy.bytes = bytes;
+    copy.bound = false;
+#ifdef NUMA_INDEX_SYSCALLS
+    void* block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        error_exit("failed to allocate " + to_string(bytes) + " bytes for a copy of the index");
+    copy.block = (char*) block;
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    for (size_t i = 0; i < nodes.size(); i++)
+        mask[nodes[i] / (8 * sizeof(unsigned long))] |= 1UL << (nodes[i] % (8 * sizeof(unsigned long)));
+    // the kernel drops the last bit of maxnode
+    copy.bound = syscall(__NR_mbind, block, bytes, policy, mask, (unsigned long) NUMA_MAX_NODES + 1, 0) == 0;
+#else
+    copy.block = (char*) malloc(bytes);
+    if (copy.block == NULL)
+        error_exit("failed to allocate " + to_string(bytes) + " bytes for a copy of the index");
+#endif
+    char* b = copy.block;
+    FMI* f = (FMI*) (b + fmiAt);
+    *f = *fmi;
+    f->index1 = (IndexType**) (b + index1PtrAt);
+    f->index2 = (ushort**) (b + index2PtrAt);
+    for (int i = 0; i < fmi->N1; i++) {
+        f->index1[i] = (IndexType*) (b + index1At) + i * alen;
+        memcpy(f->index1[i], fmi->index1[i], alen * sizeof(IndexType));
+    }
+    for (int i = 0; i < fmi->N2; i++) {
+        f->index2[i] = (ushort*) (b + index2At) + i * alen;
+        memcpy(f->index2[i], fmi->index2[i], alen * sizeof(ushort));
+    }
+    f->startLcode = (int*) (b + codesAt);
+    memcpy(f->startLcode, fmi->startLcode, (alen + 1) * sizeof(int));
+    f->bwt = (uchar*) (b + bwtAt);
+    memcpy(f->bwt, fmi->bwt, fmi->bwtlen);
+    copy.fmi = f;
+    copy.sa = NULL;
+    if (sa) {
+        suffixArray* s = (suffixArray*) (b + saAt);
+        *s = *sa;
+        s->sa = (uchar*) (b + checkpointsAt);
+        memcpy(s->sa, sa->sa, sa->ncheck * sa->nbytes);
+        copy.sa = s;
+    }
+    return copy;
+}
+
+void NumaIndex::freeCopy(Copy& copy) {
+#ifdef NUMA_INDEX_SYSCALLS
+    munmap(copy.block, copy.bytes);
+#else
+    free(copy.block);
+#endif
+    copy.block = NULL;
+}
+
+void NumaIndex::place(FMI* fmi, suffixArray* sa) {
+    mFmi = fmi;
+    mSa = sa;
+    if (mMode == NUMA_OFF || nodes() < 2)
+        return;
+    if (mMode == NUMA_INTERLEAVE) {
+        mCopies.push_back(copyIndex(fmi, sa, NUMA_MPOL_INTERLEAVE, mNodeIds));
+    } else {
+        // each copy is written by a thread on its node, so first touch places it there even if mbind is refused
+        mCopies.resize(nodes());
+        vector<std::thread*> threads;
+        for (int n = 0; n < nodes(); n++) {
+            threads.push_back(new std::thread([this, fmi, sa, n] {
+                pinTo(mNodeCpus[n]);
+                mCopies[n] = copyIndex(fmi, sa, NUMA_MPOL_PREFERRED, vector<int>(1, mNodeIds[n]));
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++) {
+            threads[t]->join();
+            delete threads[t];
+        }
+    }
+
+    // the loaded tables are not searched any more, the original structs now lead to the first copy
+    free(fmi->bwt);
+    for (int i = 0; i < fmi->N1; i++)
+        free(fmi->index1[i]);
+    free(fmi->index1);
+    for (int i = 0; i < fmi->N2; i++)
+        free(fmi->index2[i]);
+    free(fmi->index2);
+    free(fmi->startLcode);
+    *fmi = *mCopies[0].fmi;
+    if (sa) {
+        free(sa->sa);
+        sa->sa = mCopies[0].sa->sa;
+    }
+}
+
+FMI* NumaIndex::fmiOfWorker(int worker) {
+    if (mCopies.size() < 2)
+        return mFmi;
+    return mCopies[nodeOfWorker(worker)].fmi;
+}
+
+suffixArray* NumaIndex::suffixesOfWorker(int worker) {
+    if (mCopies.size() < 2)
+        return mSa;
+    return mCopies[nodeOfWorker(worker)].sa;
+}
+
+bool NumaIndex::pinWorker(int worker) {
+    if (mMode != NUMA_REPLICATE || nodes() < 2)
+        return false;
+    return pinTo(mNodeCpus[nodeOfWorker(worker)]);
+}
+
+string NumaIndex::describe() {
+    stringstream ss;
+    ss << nodes() << " NUMA node" << (nodes() > 1 ? "s" : "");
+    if (mMode == NUMA_OFF)
+        return ss.str() + ", index placement off";
+    if (mCopies.empty())
+        return ss.str() + ", index left where it was loaded";
+    bool bound = true;
+    for (size_t i = 0; i < mCopies.size(); i++)
+        bound &= mCopies[i].bound;
+    if (mMode == NUMA_INTERLEAVE)
+        ss << ", index pages interleaved";
+    else
+        ss << ", index replicated on each node and workers pinned";
+    ss << (bound ? "" : " (mbind refused, placed by first touch)");
+    return ss.str();
+}
+
+bool NumaIndex::test() {
+    // a small index made up by hand, laid out as read_fmi leaves it
+    const int alen = 4, N1 = 3, N2 = 9;
+    FMI* fmi = (FMI*) malloc(sizeof(FMI));
+    fmi->alen = alen;
+    fmi->bwtlen = 2000;
+    fmi->N1 = N1;
+    fmi->N2 = N2;
+    fmi->bwt = (uchar*) malloc(fmi->bwtlen);
+    for (IndexType i = 0; i < fmi->bwtlen; i++)
+        fmi->bwt[i] = (uchar) (i * 7);
+    fmi->index1 = (IndexType**) malloc(N1 * sizeof(IndexType*));
+    for (int i = 0; i < N1; i++) {
+        fmi->index1[i] = (IndexType*) malloc(alen * sizeof(IndexType));
+        for (int a = 0; a < alen; a++)
+            fmi->index1[i][a] = i * 1000 + a;
+    }
+    fmi->index2 = (ushort**) malloc(N2 * sizeof(ushort*));
+    for (int i = 0; i < N2; i++) {
+        fmi->index2[i] = (ushort*) malloc(alen * sizeof(ushort));
+        for (int a = 0; a < alen; a++)
+            fmi->index2[i][a] = i * 10 + a;
+    }
+    fmi->startLcode = (int*) malloc((alen + 1) * sizeof(int));
+    for (int a = 0; a <= alen; a++)
+        fmi->startLcode[a] = a * 3;
+    suffixArray* sa = (suffixArray*) malloc(sizeof(suffixArray));
+    memset(sa, 0, sizeof(suffixArray));
+    sa->ncheck = 50;
+    sa->nbytes = 5;
+    sa->sa = (uchar*) malloc(sa->ncheck * sa->nbytes);
+    for (int i = 0; i < sa->ncheck * sa->nbytes; i++)
+        sa->sa[i] = (uchar) (i * 13);
+
+    bool passed = true;
+    NumaIndex numa(NUMA_REPLICATE);
+    passed &= numa.nodes() >= 1;
+    // a copy has to hold the same tables, wherever the kernel let us put it
+    Copy copy = numa.copyIndex(fmi, sa, NUMA_MPOL_PREFERRED, vector<int>(1, numa.mNodeIds[0]));
+    passed &= copy.fmi->bwtlen == fmi->bwtlen && memcmp(copy.fmi->bwt, fmi->bwt, fmi->bwtlen) == 0;
+    for (int i = 0; i < N1; i++)
+        passed &= memcmp(copy.fmi->index1[i], fmi->index1[i], alen * sizeof(IndexType)) == 0;
+    for (int i = 0; i < N2; i++)
+        passed &= memcmp(copy.fmi->index2[i], fmi->index2[i], alen * sizeof(ushort)) == 0;
+    passed &= memcmp(copy.fmi->startLcode, fmi->startLcode, (alen + 1) * sizeof(int)) == 0;
+    passed &= memcmp(copy.sa->sa, sa->sa, sa->ncheck * sa->nbytes) == 0;
+    passed &= copy.fmi->bwt != fmi->bwt;
+    numa.freeCopy(copy);
+
+    // placing works on a single node too, where every worker keeps the loaded index
+    numa.place(fmi, sa);
+    for (int w = 0; w < 4; w++) {
+        FMI* f = numa.fmiOfWorker(w);
+        passed &= f->index1[N1 - 1][alen - 1] == (N1 - 1) * 1000 + alen - 1;
+        passed &= f->index2[N2 - 1][alen - 1] == (N2 - 1) * 10 + alen - 1;
+        passed &= f->bwt[fmi->bwtlen - 1] == (uchar) ((fmi->bwtlen - 1) * 7);
+        passed &= numa.suffixesOfWorker(w)->sa[0] == 0 && numa.nodeOfWorker(w) < numa.nodes();
+    }
+#ifdef NUMA_INDEX_SYSCALLS
+    // pinning must not leave the test thread on fewer cpus
+    cpu_set_t saved;
+    if (sched_getaffinity(0, sizeof(saved), &saved) == 0) {
+        passed &= numa.pinWorker(1) == (numa.nodes() > 1);
+        sched_setaffinity(0, sizeof(saved), &saved);
+    }
+#endif
+
+    if (numa.mCopies.empty()) {
+        free(fmi->bwt);
+        for (int i = 0; i < N1; i++)
+            free(fmi->index1[i]);
+        free(fmi->index1);
+        for (int i = 0; i < N2; i++)
+            free(fmi->index2[i]);
+        free(fmi->index2);
+        free(fmi->startLcode);
+        free(sa->sa);
+    }
+    free(fmi);
+    free(sa);
+    return passed;
+}
@@ -0,0 +1,76 @@
+#ifndef NUMA_INDEX_H
+#define NUMA_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "bwt/fmi.h"
+#include "bwt/suffixArray.h"
+}
+
+using namespace std;
+
+// places the read-only FM index on machines with several NUMA nodes.
+// the loading thread first-touches the whole index, so without this it sits on one node and
+// the workers on the other sockets pay remote latency on every FMindex call.
+// "interleave" spreads the pages of one copy over all nodes, "replicate" gives every node its own copy
+// and pins each worker to the cpus of one node, so it searches the copy next to it.
+// it uses the mbind and sched_setaffinity syscalls directly, so no libnuma is needed, and on
+// a single node, or where the kernel refuses, the index stays as it was loaded
+class NumaIndex {
+public:
+    enum Mode {
+        NUMA_OFF = 0,
+        NUMA_INTERLEAVE,
+        NUMA_REPLICATE
+    };
+
+    NumaIndex(Mode mode);
+    ~NumaIndex();
+
+    // copies fmi and the suffix array checkpoints of sa as the mode asks and points them at the first copy
+    void place(FMI* fmi, suffixArray* sa);
+
+    // nodes with cpus this process may run on, at least 1
+    inline int nodes() {return mNodeCpus.size();}
+    // the node worker is assigned to, workers go round robin over the nodes
+    inline int nodeOfWorker(int worker) {return worker % nodes();}
+    // the copy of the index worker should search, the original where there is only one
+    FMI* fmiOfWorker(int worker);
+    suffixArray* suffixesOfWorker(int worker);
+    // pins the calling thread to the cpus of the node of worker in replicate mode, false if it was not pinned
+    bool pinWorker(int worker);
+    string describe();
+
+    static bool parseMode(string name, Mode& mode);
+    static bool test();
+
+private:
+    struct Copy {
+        char* block;
+        size_t bytes;
+        FMI* fmi;
+        suffixArray* sa;
+        bool bound;
+    };
+
+    void detectNodes();
+    Copy copyIndex(FMI* fmi, suffixArray* sa, int policy, const vector<int>& nodes);
+    void freeCopy(Copy& copy);
+
+private:
+    Mode mMode;
+    // the index as loaded, which leads to the first copy once it is placed
+    FMI* mFmi;
+    suffixArray* mSa;
+    // cpus of each node, only nodes with cpus allowed by our affinity mask
+    vector<vector<int>> mNodeCpus;
+    // the number of each node in the kernel's numbering
+    vector<int> mNodeIds;
+    vector<Copy> mCopies;
+};
+
+#endif
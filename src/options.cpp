@@ -37,6 +37,22 @@ Options::Options(){
     seqLen2 = 151;
     fixMGI = false;
     fastqBufferSize = 1<<20;
+    packQueueDepth = PACK_IN_MEM_LIMIT;
+    writerQueueDepth = PACK_IN_MEM_LIMIT;
+    packSizeMax = PACK_SIZE_MAX;
+    segCacheLimit = SEG_CACHE_LIMIT;
+    readahead = 4;
+    decompressThreads = 2;
+    ioUringDepth = 0;
+    mmapInput = false;
+    contigMode = false;
+    contigWindow = 150;
+    contigStep = 75;
+    db = &mHomoSearchOptions;
+    concurrentSamples = 1;
+    numa = "off";
+    compressThreads = 1;
+    maxMemory = 0;
     samples.clear();
 }
 
@@ -102,6 +118,18 @@ void Options::loadFastaAdapters() {
     }
 }
 
+void Options::validateThreads() {
+    if(thread < 1) {
+        thread = 1;
+    } else if(thread > 32) {
+        cerr << "WARNING: Seq2Fun uses up to 32 threads although you specified " << thread << endl;
+        thread = 32;
+    }
+    // thread number cannot be more than the number of file to split
+    if(split.enabled && split.byFileNumber && thread > split.number && split.number >= 2)
+        thread = split.number;
+}
+
 bool Options::validate() {
     if(in1.empty()) {
         if(!in2.empty())
@@ -316,13 +344,19 @@ bool Options::validate() {
     if(readsToProcess < 0)
         error_exit("the number of reads to process (--reads_to_process) cannot be negative");
 
-    if(thread < 1) {
-        thread = 1;
-    } else if(thread > 32) {
-        cerr << "WARNING: Seq2Fun uses up to 32 threads although you specified " << thread << endl;
-        thread = 32;
+    if(contigMode) {
+        if(isPaired())
+            error_exit("--contig_mode takes one FASTA file per sample, paired-end input is not supported");
+        if(ends_with(in1, ".gz"))
+            error_exit("--contig_mode needs an uncompressed FASTA file: " + in1);
+        if(contigWindow < 30)
+            error_exit("contig window (--contig_window) should be at least 30");
+        if(contigStep < 1 || contigStep > contigWindow)
+            error_exit("contig step (--contig_step) should be 1 ~ contig window (--contig_window)");
     }
 
+    validateThreads();
+
     if(trim.front1 < 0 || trim.front1 > 30)
         error_exit("trim_front1 (--trim_front1) should be 0 ~ 30, suggest 0 ~ 4");
 
@@ -360,9 +394,6 @@ bool Options::validate() {
         if(split.byFileNumber) {
             if(split.number < 2 || split.number >= 1000)
                 error_exit("you have enabled splitting output by file number, the number of files (--split) should be 2 ~ 999.");
-            // thread number cannot be more than the number of file to split
-            if(thread > split.number)
-                thread = split.number;
         }
 
         if(split.byFileLines) {
@@ -620,10 +651,17 @@ void Options::readDB() {
     GOUSet.clear();
     orgUSet.clear();
 
+    mHomoSearchOptions.orthIdVec.clear();
+    mHomoSearchOptions.orthIdVec.reserve(transSearch.orthIdSet.size());
+    std::unordered_map<uint32, uint32> orthIdIndex;
+    for (const auto & it : transSearch.orthIdSet) {
+        orthIdIndex[it] = (uint32) mHomoSearchOptions.orthIdVec.size();
+        mHomoSearchOptions.orthIdVec.push_back(&it);
+    }
     for (const auto & it : tmpIdMap) {
-        auto itr = transSearch.orthIdSet.find(it.second);
-        if (itr != transSearch.orthIdSet.end()) {
-            mHomoSearchOptions.idDbMap.insert(std::make_pair(it.first, &(*itr)));
+        auto itr = orthIdIndex.find(it.second);
+        if (itr != orthIdIndex.end()) {
+            mHomoSearchOptions.idDbMap.insert(std::make_pair(it.first, itr->second));
         }
     }
     tmpIdMap.clear();
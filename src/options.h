@@ -422,9 +422,10 @@ public:
     std::vector<std::tuple<string, std::string, int> > totoalReadsQualityVec;
 };
 
-class TransSearchOptions {
+// the settings of the search and the sizes of the database, copied whole to the options of another sample
+class TransSearchSettings {
 public:
-    TransSearchOptions() {
+    TransSearchSettings() {
         mode = tGREEDY;
         codonTable = codontable1;
         SEG = true;
@@ -440,34 +441,51 @@ public:
         max_matches_SI = 10000;
         max_match_ids = 10000;
 
-        transSearchFinished = false;
-        sampleKOAbunUMap.clear();
-        koUSet.clear();
-        goUSet.clear();
-        idUSet.clear();
-        nTransMappedKOReads = 0;
-        nTransMappedGOReads = 0;
-        nTransMappedIdReads = 0;
         nKODB = 0;
         nGODB = 0;
         nIdDB = 0;
-        nTransMappedKOs = 0;
-        nTransMappedGOs = 0;
-        nTransMappedIds = 0;
-        sortedKOFreqTupleVector.clear();
-        sortedIdFreqTupleVector.clear();
-        rarefactionMap.clear();
-        rarefactionIdMap.clear();
-        sortedPathwayFreqTupleVector.clear();
         nPathwaysDB = 0;
-        sortedOrgFreqVec.clear();
         nOrgsDB = 0;
-        nMappedOrgs = 0;
-        timeLapse = 0;
-        orthIdSet.clear();
         coreOrthosDb = 0;
-        nMappedCoreOrthos = 0;
-        nMappedCoreOrthoRate = 0;
+    }
+
+public:
+    string tfmi;
+    string tmode;
+    string tCodonTable;
+    bool SEG;
+    bool useEvalue;
+    double minEvalue;
+    unsigned int minAAFragLength;
+    unsigned int misMatches;
+    unsigned int minScore;
+    unsigned int seedLength;
+    unsigned int maxTransLength;
+    bool allFragments;
+
+    size_t max_matches_SI;
+    size_t max_match_ids;
+
+    Mode mode;
+    CodonTable codonTable;
+    unsigned int nKODB;
+    unsigned int nGODB;
+    unsigned int nIdDB;
+    unsigned int nPathwaysDB;
+    unsigned int nOrgsDB;
+    unsigned int coreOrthosDb;
+};
+
+class TransSearchOptions : public TransSearchSettings {
+public:
+    TransSearchOptions() {
+        reset2Default();
+    }
+
+    // the settings and the database sizes of another sample, with no results yet.
+    // orthIdSet stays with the original, the ids are shared through Options::db
+    TransSearchOptions(const TransSearchOptions & other) : TransSearchSettings(other) {
+        reset2Default();
     }
 
     void reset2Default() {
@@ -475,7 +493,6 @@ public:
         sampleKOAbunUMap.clear();
         koUSet.clear();
         goUSet.clear();
-        idUSet.clear();
         nTransMappedKOReads = 0;
         nTransMappedGOReads = 0;
         nTransMappedIdReads = 0;
@@ -495,42 +512,18 @@ public:
     }
     
 public:
-    string tfmi;
-    string tmode;
-    string tCodonTable;
-    bool SEG;
-    bool useEvalue;
-    double minEvalue;
-    unsigned int minAAFragLength;
-    unsigned int misMatches;
-    unsigned int minScore;
-    unsigned int seedLength;
-    unsigned int maxTransLength;
-    bool allFragments;
-
-    size_t max_matches_SI;
-    size_t max_match_ids;
-
     time_t startTime;
     time_t endTime;
     long timeLapse;
-    Mode mode;
-    CodonTable codonTable;
     std::unordered_set<std::string> koUSet;
     std::unordered_set<std::string> goUSet;
-    std::set<uint32 *> idUSet;
     atomic_long nTransMappedKOReads;
     atomic_long nTransMappedGOReads;
     atomic_long nTransMappedIdReads;
-    unsigned int nKODB;
-    unsigned int nGODB;
-    unsigned int nIdDB;
     unsigned int nTransMappedKOs;
     unsigned int nTransMappedGOs;
     unsigned int nTransMappedIds;
     unsigned int nMappedPathways;
-    unsigned int nPathwaysDB;
-    unsigned int nOrgsDB;
     unsigned int nMappedOrgs;
     std::map<const uint32 *, uint32 > totalIdFreqUMapResults;
     std::vector< std::tuple <std::string, uint32, std::string> > sortedKOFreqTupleVector;
@@ -542,7 +535,6 @@ public:
     std::unordered_map<std::string, int> sampleKOAbunUMap;
     bool transSearchFinished;
     std::set< uint32> orthIdSet;
-    unsigned int coreOrthosDb;
     unsigned int nMappedCoreOrthos;
     float nMappedCoreOrthoRate;
 };
@@ -566,24 +558,16 @@ public:
     }
 };
 
-class HomoSearchOptions {
+// the settings of a run, copied whole to the options of another sample
+class HomoSearchSettings {
 public:
-    HomoSearchOptions() {
+    HomoSearchSettings() {
         profiling = false;
         genemap = "";
         prefix = "";
         sampleTable = "";
         pathway = "";
         genefa = "";
-        nCleanReads = 0;
-        nTotalReads = 0;
-        commandStr = "";
-    }
-
-    void reset2Default() {
-        nCleanReads = 0;
-        nTotalReads = 0;
-        commandStr = "";
     }
 
 public:
@@ -593,11 +577,37 @@ public:
     std::string pathway;
     std::string genefa;
     bool profiling;
+};
+
+class HomoSearchOptions : public HomoSearchSettings {
+public:
+    HomoSearchOptions() {
+        reset2Default();
+    }
+
+    // the settings of another sample, the tables read from the database are shared through Options::db
+    HomoSearchOptions(const HomoSearchOptions & other) : HomoSearchSettings(other) {
+        reset2Default();
+    }
+
+    void reset2Default() {
+        nCleanReads = 0;
+        nTotalReads = 0;
+        nEstimatedReads = 0;
+        commandStr = "";
+    }
+
+public:
     long nCleanReads;
     long nTotalReads;
+    // reads in the input projected from the evaluation sample, 0 if unknown
+    long nEstimatedReads;
 
     std::map<const uint32*, const geneKoGoComb> fullDbMap;
-    std::map<const std::string, const uint32*> idDbMap;
+    // protein name -> dense ortholog index into orthIdVec
+    std::map<const std::string, uint32> idDbMap;
+    // dense ortholog index -> id in transSearch.orthIdSet, in id order
+    std::vector<const uint32*> orthIdVec;
     //std::multimap<uint32, geneKoGoComb> fullidDbMMap;
     //std::map<std::string, std::string> db_map;
     //std::map<std::string, std::string> org_map;
@@ -661,6 +671,8 @@ public:
     void init();
     bool isPaired();
     bool validate();
+    // the thread part of validate(), for what is sized by the threads before the samples are validated
+    void validateThreads();
     bool adapterCuttingEnabled();
     bool polyXTrimmingEnabled();
     string getAdapter1();
@@ -730,6 +742,26 @@ public:
     int thread;
     // fastq reads buffer size
     size_t fastqBufferSize;
+    // packs of reads queued between the loading thread and the worker threads
+    int packQueueDepth;
+    // packs of output each writer thread may queue
+    int writerQueueDepth;
+    // the largest pack the loader may fill when it sizes the packs to the search time
+    int packSizeMax;
+    // fragments each worker keeps in its SEG result cache
+    int segCacheLimit;
+    // decompressed blocks read ahead for .gz input, 0 to decompress on the loading thread
+    int readahead;
+    // threads inflating BGZF input of each file, used with readahead
+    int decompressThreads;
+    // reads kept in flight by io_uring for each input file, 0 to read with fread/gzread
+    int ioUringDepth;
+    // map uncompressed input and let the worker threads parse it
+    bool mmapInput;
+    // input is FASTA of contigs or long reads, searched in overlapping windows
+    bool contigMode;
+    int contigWindow;
+    int contigStep;
     // trimming options
     TrimmingOptions trim;
     // quality filtering options
@@ -776,6 +808,16 @@ public:
     MergeOptions merge;
     TransSearchOptions transSearch;
     HomoSearchOptions mHomoSearchOptions;
+    // the tables read from the database, those of the original options in the copies made for concurrent samples
+    HomoSearchOptions* db;
+    // samples of the sample table processed at the same time, each with its share of the threads
+    int concurrentSamples;
+    // placement of the index on NUMA machines: off, interleave or replicate
+    string numa;
+    // threads compressing each .gz output of the writer threads, 1 means a single zlib stream
+    int compressThreads;
+    // bytes the buffers are planned within, 0 for no limit
+    size_t maxMemory;
     //BwtFmiDB tbwtfmiDB;
     std::vector<Sample> samples;
     int getWorkingSampleId(string & samplePrefix); 
@@ -96,32 +96,52 @@ OverlapResult OverlapAnalysis::analyze(Sequence& r1, Sequence& r2, int diffLimit
 }
 
 Read* OverlapAnalysis::merge(Read* r1, Read* r2, OverlapResult ov) {
-    int ol = ov.overlap_len;
     if(!ov.overlapped)
         return NULL;
 
+    Read* mergedRead = new Read("", "", "", "");
+    mergeInto(r1, r2, ov, mergedRead);
+    return mergedRead;
+}
+
+static inline char complementBase(char base) {
+    switch(base) {
+        case 'A':
+        case 'a':
+            return 'T';
+        case 'T':
+        case 't':
+            return 'A';
+        case 'C':
+        case 'c':
+            return 'G';
+        case 'G':
+        case 'g':
+            return 'C';
+        default:
+            return 'N';
+    }
+}
+
+void OverlapAnalysis::mergeInto(Read* r1, Read* r2, OverlapResult ov, Read* merged) {
+    int ol = ov.overlap_len;
     int len1 = ol + max(0, ov.offset);
     int len2 = 0; 
     if(ov.offset > 0)
         len2 = r2->length() - ol;
 
-    Read* rr2 = r2->reverseComplement();
-    string mergedSeq = r1->mSeq.mStr.substr(0, len1);
-    if(ov.offset > 0) {
-        mergedSeq += rr2->mSeq.mStr.substr(ol, len2);
-    }
-
-    string mergedQual = r1->mQuality.substr(0, len1);
-    if(ov.offset > 0) {
-        mergedQual += rr2->mQuality.substr(ol, len2);
+    merged->mName = r1->mName;
+    merged->mName += " merged_" + to_string(len1) + "_" + to_string(len2);
+    merged->mSeq.mStr.assign(r1->mSeq.mStr, 0, len1);
+    merged->mQuality.assign(r1->mQuality, 0, len1);
+    // bases ol .. ol + len2 of the reverse complement of r2, read from r2 backwards
+    int l2 = r2->length();
+    for(int i = ol; i < ol + len2; i++) {
+        merged->mSeq.mStr += complementBase(r2->mSeq.mStr[l2 - 1 - i]);
+        merged->mQuality += r2->mQuality[l2 - 1 - i];
     }
-
-    delete rr2;
-
-    string name = r1->mName + " merged_" + to_string(len1) + "_" + to_string(len2);
-    Read* mergedRead = new Read(name, mergedSeq, r1->mStrand, mergedQual);
-
-    return mergedRead;
+    merged->mStrand = r1->mStrand;
+    merged->mHasQuality = true;
 }
 
 bool OverlapAnalysis::test(){
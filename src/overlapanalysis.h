@@ -28,6 +28,8 @@ public:
     static OverlapResult analyze(Sequence&  r1, Sequence&  r2, int diffLimit, int overlapRequire, double diffPercentLimit);
     static OverlapResult analyze(Read* r1, Read* r2, int diffLimit, int overlapRequire, double diffPercentLimit);
     static Read* merge(Read* r1, Read* r2, OverlapResult ov);
+    // like merge(), but writes the merged read into merged, reusing its strings
+    static void mergeInto(Read* r1, Read* r2, OverlapResult ov, Read* merged);
 
 public:
     static bool test();
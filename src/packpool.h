@@ -0,0 +1,89 @@
+#ifndef PACK_POOL_H
+#define PACK_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+#include "common.h"
+
+using namespace std;
+
+// recycles packs of reads from the worker threads back to the loading thread.
+// a released pack keeps its slots and the reads in them, so the loader parses
+// the next reads into the same objects and their strings keep their capacity.
+// slots are NULL until the loader first fills them, the pool deletes what they hold at the end
+template<typename Pack, typename Item>
+class PackPool {
+public:
+    // slots is the largest pack the loader may fill
+    PackPool(int slots) {
+        mSlots = slots;
+        mPacksCreated = 0;
+        mItemsCreated = 0;
+    }
+
+    ~PackPool() {
+        for (size_t i = 0; i < mFree.size(); i++) {
+            Pack* pack = mFree[i];
+            for (int s = 0; s < mSlots; s++) {
+                if (pack->data[s])
+                    delete pack->data[s];
+            }
+            delete[] pack->data;
+            delete pack;
+        }
+        mFree.clear();
+    }
+
+    // an empty pack, recycled when one is free
+    Pack* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            if (!mFree.empty()) {
+                Pack* pack = mFree.back();
+                mFree.pop_back();
+                pack->count = 0;
+                return pack;
+            }
+            mPacksCreated++;
+        }
+        Pack* pack = new Pack;
+        pack->data = new Item*[mSlots];
+        memset(pack->data, 0, sizeof(Item*) * mSlots);
+        pack->count = 0;
+        return pack;
+    }
+
+    // the pack and the reads in it may be refilled from now on
+    void release(Pack* pack) {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mFree.push_back(pack);
+    }
+
+    // the loader reports the slots it had to fill with new reads
+    void countCreated(long items) {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mItemsCreated += items;
+    }
+
+    long packsCreated() {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mPacksCreated;
+    }
+
+    long itemsCreated() {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mItemsCreated;
+    }
+
+private:
+    vector<Pack*> mFree;
+    int mSlots;
+    long mPacksCreated;
+    long mItemsCreated;
+    std::mutex mMtx;
+};
+
+#endif
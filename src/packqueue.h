@@ -0,0 +1,86 @@
+#ifndef PACK_QUEUE_H
+#define PACK_QUEUE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// a bounded blocking queue handing packs of reads from the loading thread(s) to the worker threads.
+// push() waits while the queued packs hold depth reads, as the packs are not all of one size,
+// pop() waits for a pack and returns NULL once the queue is closed and drained, which is how
+// the workers learn that the input ended. tryPop() is the same without waiting
+template<typename T>
+class PackQueue {
+public:
+    PackQueue(size_t depth) {
+        mDepth = depth > 0 ? depth : 1;
+        mQueued = 0;
+        mClosed = false;
+    }
+
+    void push(T* pack) {
+        std::unique_lock<std::mutex> lock(mMtx);
+        // a pack larger than the depth still goes into an empty queue
+        mNotFull.wait(lock, [this, pack] {return mPacks.empty() || mQueued + pack->count <= mDepth;});
+        mPacks.push_back(pack);
+        mQueued += pack->count;
+        lock.unlock();
+        mNotEmpty.notify_one();
+    }
+
+    T* pop() {
+        std::unique_lock<std::mutex> lock(mMtx);
+        mNotEmpty.wait(lock, [this] {return mClosed || !mPacks.empty();});
+        if (mPacks.empty())
+            return NULL;
+        T* pack = mPacks.front();
+        mPacks.pop_front();
+        mQueued -= pack->count;
+        lock.unlock();
+        mNotFull.notify_one();
+        return pack;
+    }
+
+    // a pack, or NULL when none is queued, with closed set once the queue is also closed
+    T* tryPop(bool& closed) {
+        std::unique_lock<std::mutex> lock(mMtx);
+        closed = mClosed && mPacks.empty();
+        if (mPacks.empty())
+            return NULL;
+        T* pack = mPacks.front();
+        mPacks.pop_front();
+        mQueued -= pack->count;
+        lock.unlock();
+        mNotFull.notify_one();
+        return pack;
+    }
+
+    // no more packs will be pushed, wakes up all waiting consumers
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            mClosed = true;
+        }
+        mNotEmpty.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mPacks.size();
+    }
+
+private:
+    std::deque<T*> mPacks;
+    size_t mDepth;
+    size_t mQueued;
+    bool mClosed;
+    std::mutex mMtx;
+    std::condition_variable mNotEmpty;
+    std::condition_variable mNotFull;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "packsizer.h"
+#include <sstream>
+#include <algorithm>
+
+// the first latency bucket holds what took less than LATENCY_FIRST, each next one LATENCY_GROWTH times longer
+static const double LATENCY_FIRST = 0.001;
+static const double LATENCY_GROWTH = 1.25;
+static const int LATENCY_BUCKETS = 64;
+// weight of the newest pack in the average time per read, so the size follows a change within a few packs
+static const double SIZE_SMOOTHING = 0.2;
+// sizes are rounded down to this, so that the size does not change for every pack
+static const int SIZE_STEP = 50;
+
+PackSizer::PackSizer(int minSize, int maxSize, int startSize, double targetSeconds) {
+    mMin = max(1, min(minSize, maxSize));
+    mMax = max(mMin, maxSize);
+    mTarget = targetSeconds;
+    int size = max(mMin, min(startSize, mMax));
+    mSize = size;
+    mSecondsPerRead = 0;
+    mPacks = 0;
+    mReads = 0;
+    mSmallest = size;
+    mLargest = size;
+    mLatencies.assign(LATENCY_BUCKETS, 0);
+    mLatencyMax = 0;
+    mStart = std::chrono::steady_clock::now();
+    mInputDoneAt = -1;
+    mLastFinishAt = 0;
+}
+
+double PackSizer::secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+long PackSizer::nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PackSizer::finish(int count, double workerSeconds, double latencySeconds) {
+    if (count <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(mMtx);
+    mPacks++;
+    mReads += count;
+    int bucket = 0;
+    for (double bound = LATENCY_FIRST; latencySeconds >= bound && bucket < LATENCY_BUCKETS - 1; bound *= LATENCY_GROWTH)
+        bucket++;
+    mLatencies[bucket]++;
+    mLatencyMax = max(mLatencyMax, latencySeconds);
+    mLastFinishAt = secondsSince(mStart);
+
+    double perRead = workerSeconds / count;
+    mSecondsPerRead = mSecondsPerRead > 0 ? mSecondsPerRead + SIZE_SMOOTHING * (perRead - mSecondsPerRead) : perRead;
+    if (mSecondsPerRead <= 0)
+        return;
+    double fit = mTarget / mSecondsPerRead;
+    int size = fit >= mMax ? mMax : max(mMin, (int) (fit / SIZE_STEP) * SIZE_STEP);
+    mSmallest = min(mSmallest, size);
+    mLargest = max(mLargest, size);
+    mSize.store(size, std::memory_order_relaxed);
+}
+
+void PackSizer::inputDone() {
+    std::lock_guard<std::mutex> lock(mMtx);
+    // with several loading threads the input is done when the last one is
+    mInputDoneAt = max(mInputDoneAt, secondsSince(mStart));
+}
+
+// the upper bound of the bucket holding the given fraction of the packs
+double PackSizer::latencyPercentile(double fraction) {
+    long target = (long) (fraction * mPacks + 0.5);
+    long seen = 0;
+    double bound = LATENCY_FIRST;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += mLatencies[b];
+        if (seen >= target && seen > 0)
+            return min(bound, mLatencyMax);
+        bound *= LATENCY_GROWTH;
+    }
+    return mLatencyMax;
+}
+
+void PackSizer::reportJson(ofstream& ofs, string padding) {
+    std::lock_guard<std::mutex> lock(mMtx);
+    double tail = mInputDoneAt >= 0 && mLastFinishAt > mInputDoneAt ? mLastFinishAt - mInputDoneAt : 0.0;
+    ofs << "{" << endl;
+    ofs << padding << "\t" << "\"target_seconds\": " << mTarget << "," << endl;
+    ofs << padding << "\t" << "\"min_size\": " << mMin << "," << endl;
+    ofs << padding << "\t" << "\"max_size\": " << mMax << "," << endl;
+    ofs << padding << "\t" << "\"packs\": " << mPacks << "," << endl;
+    ofs << padding << "\t" << "\"mean_size\": " << (mPacks > 0 ? (double) mReads / mPacks : 0.0) << "," << endl;
+    ofs << padding << "\t" << "\"smallest_size\": " << mSmallest << "," << endl;
+    ofs << padding << "\t" << "\"largest_size\": " << mLargest << "," << endl;
+    ofs << padding << "\t" << "\"final_size\": " << nextSize() << "," << endl;
+    ofs << padding << "\t" << "\"seconds_per_read\": " << mSecondsPerRead << "," << endl;
+    ofs << padding << "\t" << "\"latency_seconds\": {";
+    ofs << "\"p50\": " << latencyPercentile(0.5) << ", ";
+    ofs << "\"p90\": " << latencyPercentile(0.9) << ", ";
+    ofs << "\"p99\": " << latencyPercentile(0.99) << ", ";
+    ofs << "\"max\": " << mLatencyMax << "}," << endl;
+    // from the end of the input until the last pack was done, where the workers run out of packs
+    ofs << padding << "\t" << "\"tail_seconds\": " << tail << endl;
+    ofs << padding << "}," << endl;
+}
+
+string PackSizer::summary() {
+    std::lock_guard<std::mutex> lock(mMtx);
+    double tail = mInputDoneAt >= 0 && mLastFinishAt > mInputDoneAt ? mLastFinishAt - mInputDoneAt : 0.0;
+    std::stringstream ss;
+    ss.precision(3);
+    ss << "packs of " << mSmallest << " to " << mLargest << " reads, " << (mPacks > 0 ? mReads / mPacks : 0) << " on average, ";
+    ss << "latency p50 " << latencyPercentile(0.5) << "s, p99 " << latencyPercentile(0.99) << "s, max " << mLatencyMax << "s, ";
+    ss << tail << "s tail after the input ran out";
+    return ss.str();
+}
+
+bool PackSizer::test() {
+    PackSizer sizer(250, 4000, 1000, 0.05);
+    bool passed = sizer.nextSize() == 1000;
+    // 1 microsecond per read fits 50000 reads in the target, held to the largest size
+    for (int i = 0; i < 20; i++)
+        sizer.finish(sizer.nextSize(), sizer.nextSize() * 1e-6, 0.01);
+    passed &= sizer.nextSize() == 4000;
+    // 90 microseconds per read fit 555, rounded down to 550
+    for (int i = 0; i < 50; i++)
+        sizer.finish(sizer.nextSize(), sizer.nextSize() * 0.9e-4, 0.1);
+    passed &= sizer.nextSize() == 550;
+    // 1 ms per read would be 50, held to the smallest size
+    for (int i = 0; i < 50; i++)
+        sizer.finish(sizer.nextSize(), sizer.nextSize() * 1e-3, 1.0);
+    passed &= sizer.nextSize() == 250 && sizer.mSmallest == 250 && sizer.mLargest == 4000;
+    // 20 packs took 0.01s, 50 0.1s and 50 1s
+    double p50 = sizer.latencyPercentile(0.5), p90 = sizer.latencyPercentile(0.9);
+    passed &= p50 >= 0.1 && p50 < 0.1 * LATENCY_GROWTH && p90 >= 1.0 && p90 <= 1.0 && sizer.mLatencyMax == 1.0;
+    passed &= sizer.mPacks == 120;
+    return passed;
+}
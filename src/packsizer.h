@@ -0,0 +1,59 @@
+#ifndef PACK_SIZER_H
+#define PACK_SIZER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+
+using namespace std;
+
+// sizes the packs of reads the loader fills so that each takes about the same worker time.
+// the time the finished packs took per read is averaged, and the next packs get as many reads as
+// fit the target: cheap reads get large packs, which spreads the cost of handing a pack through
+// the stages, and expensive reads small ones, so that the last packs of a sample finish together
+class PackSizer {
+public:
+    PackSizer(int minSize, int maxSize, int startSize, double targetSeconds);
+
+    // the size of the next pack, the loading threads may call it at the same time
+    inline int nextSize() {return mSize.load(std::memory_order_relaxed);}
+    // a pack of count reads took workerSeconds in its stages and latencySeconds from loaded to written
+    void finish(int count, double workerSeconds, double latencySeconds);
+    // the input ran out, the packs finishing from now on are the tail of the sample
+    void inputDone();
+
+    void reportJson(ofstream& ofs, string padding);
+    string summary();
+
+    static double secondsSince(std::chrono::steady_clock::time_point start);
+    static long nanosSince(std::chrono::steady_clock::time_point start);
+    static bool test();
+
+private:
+    double latencyPercentile(double fraction);
+
+private:
+    int mMin;
+    int mMax;
+    double mTarget;
+    std::atomic<int> mSize;
+    std::mutex mMtx;
+    // moving average of the worker seconds per read, 0 until a pack finished
+    double mSecondsPerRead;
+    long mPacks;
+    long mReads;
+    int mSmallest;
+    int mLargest;
+    // pack latencies in buckets growing by LATENCY_GROWTH from LATENCY_FIRST seconds
+    vector<long> mLatencies;
+    double mLatencyMax;
+    std::chrono::steady_clock::time_point mStart;
+    double mInputDoneAt;
+    double mLastFinishAt;
+};
+
+#endif
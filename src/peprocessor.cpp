@@ -1,10 +1,12 @@
 #include "peprocessor.h"
 
-PairEndProcessor::PairEndProcessor(Options* & opt, BwtFmiDB * & tbwtfmiDB) {
+PairEndProcessor::PairEndProcessor(Options* & opt, BwtFmiDB * & tbwtfmiDB) : mRepo(opt->packQueueDepth * PACK_SIZE), mPool(opt->packSizeMax),
+        mScheduler(opt->thread), mSizer(PACK_SIZE_MIN, opt->packSizeMax, PACK_SIZE, PACK_TARGET_SECONDS) {
     mOptions = opt;
     this->tbwtfmiDB = tbwtfmiDB;
-    mProduceFinished = false;
     mFinishedThreads = 0;
+    mConfigs = NULL;
+    mProgress = NULL;
     mFilter = new Filter(opt);
     mOutStream1 = NULL;
     mZipFile1 = NULL;
@@ -50,8 +52,6 @@ PairEndProcessor::~PairEndProcessor() {
         delete mUmiProcessor;
         mUmiProcessor = NULL;
     }
-    
-    destroyPackRepository();
 }
 
 void PairEndProcessor::initOutput() {
@@ -69,16 +69,17 @@ void PairEndProcessor::initOutput() {
     if (!mOptions->failedOut.empty())
         mFailedWriter = new WriterThread(mOptions, mOptions->failedOut);
 
+    // the reads map does not need the mapped reads output
+    if (mOptions->outputReadsAnnoMap && !mOptions->outReadsKOMap.empty()) {
+        mReadsKOWriter = new WriterThread(mOptions, mOptions->outReadsKOMap);
+    }
+
     if (mOptions->out1.empty())
         return;
 
     mLeftWriter = new WriterThread(mOptions, mOptions->out1);
     if (!mOptions->out2.empty())
         mRightWriter = new WriterThread(mOptions, mOptions->out2);
-
-    if (mOptions->outputReadsAnnoMap && !mOptions->outReadsKOMap.empty()) {
-        mReadsKOWriter = new WriterThread(mOptions, mOptions->outReadsKOMap);
-    }
 }
 
 void PairEndProcessor::closeOutput() {
@@ -125,8 +126,23 @@ bool PairEndProcessor::process() {
     if (!mOptions->split.enabled)
         initOutput();
 
-    initPackRepository();
-    std::thread producer(std::bind(&PairEndProcessor::producerTask, this));
+    // uncompressed mate files can be mapped and split on the same records, then each worker thread parses its own ranges
+    MappedFastq* mappedLeft = NULL;
+    MappedFastq* mappedRight = NULL;
+    vector<pair<size_t, size_t> > leftRanges;
+    vector<pair<size_t, size_t> > rightRanges;
+    if (mOptions->mmapInput && mOptions->readsToProcess <= 0 && !mOptions->interleavedInput
+            && MappedFastq::canMap(mOptions->in1) && MappedFastq::canMap(mOptions->in2)) {
+        mappedLeft = new MappedFastq(mOptions->in1);
+        mappedRight = new MappedFastq(mOptions->in2);
+        MappedFastq::splitPaired(mappedLeft, mappedRight, mOptions->thread, leftRanges, rightRanges);
+        if (mOptions->verbose){
+            mOptions->longlog ? loginfolong("input mapped, worker threads parse it directly") : loginfo("input mapped, worker threads parse it directly");
+        }
+    }
+    std::thread* producer = NULL;
+    if (!mappedLeft)
+        producer = new std::thread(std::bind(&PairEndProcessor::producerTask, this));
     //TODO: get the correct cycles
     int cycle = 151;
     ThreadConfig** configs = new ThreadConfig*[mOptions->thread];
@@ -134,7 +150,22 @@ bool PairEndProcessor::process() {
     for (int t = 0; t < mOptions->thread; t++) {
         configs[t] = new ThreadConfig(mOptions, tbwtfmiDB, t, true);
         initConfig(configs[t]);
-        threads[t] = new std::thread(std::bind(&PairEndProcessor::consumerTask, this, configs[t]));
+        mScheduler.setNode(t, tbwtfmiDB->tnuma->nodeOfWorker(t));
+    }
+    // the tasks of a pack may run on any worker, they use the ThreadConfig of the worker running them
+    mConfigs = configs;
+    // the progress line is printed by its own thread, the workers only bump their counters
+    if (mOptions->verbose) {
+        mProgress = new ProgressMeter(mOptions->db->orthIdVec.size(), mOptions->thread, mOptions->longlog);
+        mProgress->start();
+    }
+    for (int t = 0; t < mOptions->thread; t++) {
+        if (mappedLeft)
+            threads[t] = new std::thread(std::bind(&PairEndProcessor::rangeTask, this, t,
+                mappedLeft->data() + leftRanges[t].first, leftRanges[t].second - leftRanges[t].first,
+                mappedRight->data() + rightRanges[t].first, rightRanges[t].second - rightRanges[t].first));
+        else
+            threads[t] = new std::thread(std::bind(&PairEndProcessor::consumerTask, this, t));
     }
 
     std::thread* leftWriterThread = NULL;
@@ -159,10 +190,21 @@ bool PairEndProcessor::process() {
     if (mReadsKOWriter)
         readsKOMapWriterThread = new std::thread(std::bind(&PairEndProcessor::writeTask, this, mReadsKOWriter));
 
-    producer.join();
+    if (producer) {
+        producer->join();
+        delete producer;
+    }
     for (int t = 0; t < mOptions->thread; t++) {
         threads[t]->join();
     }
+    if (mProgress) {
+        delete mProgress;
+        mProgress = NULL;
+    }
+    if (mappedLeft) {
+        delete mappedLeft;
+        delete mappedRight;
+    }
 
     if (!mOptions->split.enabled) {
         if (leftWriterThread)
@@ -192,15 +234,19 @@ bool PairEndProcessor::process() {
     vector<Stats*> postStats2;
     vector<FilterResult*> filterResults;
 
-    vector<std::map<const uint32 *, uint32> > totalIdFreqVecResults;
+    vector<const std::vector<uint32> *> totalIdFreqVecResults;
     totalIdFreqVecResults.reserve(mOptions->thread);
+    uint64 searchedFragments = 0, prunedFragments = 0, searchedReads = 0;
     for (int t = 0; t < mOptions->thread; t++) {
         preStats1.push_back(configs[t]->getPreStats1());
         postStats1.push_back(configs[t]->getPostStats1());
         preStats2.push_back(configs[t]->getPreStats2());
         postStats2.push_back(configs[t]->getPostStats2());
         filterResults.push_back(configs[t]->getFilterResult());
-        totalIdFreqVecResults.push_back(configs[t]->getTransSearcher()->getIdFreqSubMap());
+        totalIdFreqVecResults.push_back(&configs[t]->getTransSearcher()->getIdFreqSubVec());
+        searchedFragments += configs[t]->getTransSearcher()->getSearchedFragments();
+        prunedFragments += configs[t]->getTransSearcher()->getPrunedFragments();
+        searchedReads += configs[t]->getTransSearcher()->getSearchedReads();
     }
     Stats* finalPreStats1 = Stats::merge(preStats1);
     Stats* finalPostStats1 = Stats::merge(postStats1);
@@ -210,9 +256,19 @@ bool PairEndProcessor::process() {
     mOptions->mHomoSearchOptions.nTotalReads = finalPreStats1->getReads(); //change to both reads??????
     mOptions->mHomoSearchOptions.nCleanReads = finalPostStats1->getReads();
     
-    mOptions->transSearch.totalIdFreqUMapResults = TransSearcher::merge(totalIdFreqVecResults);
+    mOptions->transSearch.totalIdFreqUMapResults = TransSearcher::merge(totalIdFreqVecResults, mOptions);
     mOptions->transSearch.nTransMappedIds = mOptions->transSearch.totalIdFreqUMapResults.size();
     totalIdFreqVecResults.clear();
+    if (mOptions->verbose && searchedReads > 0) {
+        std::stringstream ss;
+        ss << "searched " << searchedFragments << " fragments, pruned " << prunedFragments << " by score bound ("
+                << (double) searchedFragments / searchedReads << " searched, " << (double) prunedFragments / searchedReads << " pruned per read)";
+        mOptions->longlog ? loginfolong(ss.str()) : loginfo(ss.str());
+    }
+    if (mOptions->verbose) {
+        mOptions->longlog ? loginfolong(mScheduler.summary()) : loginfo(mScheduler.summary());
+        mOptions->longlog ? loginfolong(mSizer.summary()) : loginfo(mSizer.summary());
+    }
     
     prepareResults();
     //prepareResults(totalKoFreqVecResults, totalOrgKOFreqVecResults, totalGoFreqVecResults, totalIdFreqVecResults);
@@ -251,6 +307,8 @@ bool PairEndProcessor::process() {
     JsonReporter jr(mOptions);
     jr.setDupHist(dupHist, dupMeanGC, dupRate);
     jr.setInsertHist(mInsertSizeHist, peakInsertSize);
+    jr.setScheduler(&mScheduler);
+    jr.setPackSizer(&mSizer);
     jr.report(finalFilterResult, finalPreStats1, finalPostStats1, finalPreStats2, finalPostStats2);
 
     // make HTML report
@@ -314,22 +372,24 @@ int PairEndProcessor::getPeakInsertSize() {
     return peak;
 }
 
-bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config) {
-    string * outstr1 = new string();
-    string * outstr2 = new string();
-    string unpairedOut1;
-    string unpairedOut2;
-    string singleOutput;
-    string mergedOutput;
-    string failedOut;
-    std::string * outReadsKOMapStr = new string();
-    //std::string koTag = "";
-    uint32 * orthId = NULL;
-    int mappedReads = 0;
-    std::set<uint32 *> idSet;
+void PairEndProcessor::startPack(ReadPairPack* pack, int worker) {
+    ReadPairPackJob* job = new ReadPairPackJob;
+    job->pack = pack;
+    job->reads1.assign(pack->count, NULL);
+    job->reads2.assign(pack->count, NULL);
+    job->results.assign(pack->count, FILTERED_BY_INDEX);
+    job->orthIndexes.assign(pack->count, -1);
+    job->pendingSearches = 0;
+    job->started = std::chrono::steady_clock::now();
+    job->workNanos = 0;
+    mScheduler.submit(worker, STAGE_QC, [this, job](int w) {qcPairEnd(job, w);});
+}
 
-    int readPassed = 0;
-    int mergedCount = 0;
+void PairEndProcessor::qcPairEnd(ReadPairPackJob* job, int worker) {
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    ReadPairPack* pack = job->pack;
+    int passed = 0;
     for (int p = 0; p < pack->count; p++) {
         ReadPair* pair = pack->data[p];
         Read* or1 = pair->mLeft;
@@ -350,7 +410,6 @@ bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config)
 
         // filter by index
         if (mOptions->indexFilter.enabled && mFilter->filterByIndex(or1, or2)) {
-            delete pair;
             continue;
         }
         
@@ -424,61 +483,122 @@ bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config)
                 r2->resize(mOptions->trim.maxLen2);
         }
 
-        Read* merged = NULL;
-        // merging mode
-        bool mergeProcessed = false;
-
-        if (!mergeProcessed) {
+        int result1 = mFilter->passFilter(r1);
+        int result2 = mFilter->passFilter(r2);
 
-            int result1 = mFilter->passFilter(r1);
-            int result2 = mFilter->passFilter(r2);
+        config->addFilterResult(max(result1, result2), 2);
 
-            config->addFilterResult(max(result1, result2), 2);
+        // the filter results are never negative, so the larger one passes only if both do
+        job->reads1[p] = r1;
+        job->reads2[p] = r2;
+        job->results[p] = max(result1, result2);
+        if (r1 != NULL && r2 != NULL && job->results[p] == PASS_FILTER)
+            passed++;
+    }
 
-            if (r1 != NULL && result1 == PASS_FILTER && r2 != NULL && result2 == PASS_FILTER) {
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    if (passed == 0) {
+        mScheduler.submit(worker, STAGE_OUTPUT, [this, job](int w) {outputPairEnd(job, w);});
+        return;
+    }
+    // the search is split into tasks, the last one to finish queues the output of the pack
+    int tasks = (pack->count + SEARCH_TASK_SIZE - 1) / SEARCH_TASK_SIZE;
+    job->pendingSearches = tasks;
+    for (int t = tasks - 1; t >= 0; t--) {
+        int begin = t * SEARCH_TASK_SIZE;
+        int end = min(begin + SEARCH_TASK_SIZE, pack->count);
+        mScheduler.submit(worker, STAGE_SEARCH, [this, job, begin, end](int w) {searchPairEnd(job, begin, end, w);});
+    }
+}
 
-                if(orthId != NULL) orthId = NULL;
-                if (mOptions->outputToSTDOUT && !mOptions->merge.enabled) {
-                    //singleOutput += r1->toString() + r2->toString();
+void PairEndProcessor::searchPairEnd(ReadPairPackJob* job, int begin, int end, int worker) {
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    // overlapping pairs are merged into this read, its strings are reused for the whole task
+    Read mergeBuffer("", "", "", "");
+    for (int p = begin; p < end; p++) {
+        Read* r1 = job->reads1[p];
+        Read* r2 = job->reads2[p];
+        if (r1 == NULL || r2 == NULL || job->results[p] != PASS_FILTER)
+            continue;
+        int orthIndex = -1;
+        if (mOptions->outputToSTDOUT && !mOptions->merge.enabled) {
+            //singleOutput += r1->toString() + r2->toString();
+        } else {
+            OverlapResult ov = OverlapAnalysis::analyze(r1, r2, mOptions->overlapDiffLimit, mOptions->overlapRequire, mOptions->overlapDiffPercentLimit / 100.0);
+            if (ov.overlapped) {
+                Read* merged = &mergeBuffer;
+                OverlapAnalysis::mergeInto(r1, r2, ov, merged);
+                int result = mFilter->passFilter(merged);
+                if (result == PASS_FILTER) {
+                    config->getTransSearcher()->transSearch(merged, orthIndex);
                 } else {
-                    OverlapResult ov = OverlapAnalysis::analyze(r1, r2, mOptions->overlapDiffLimit, mOptions->overlapRequire, mOptions->overlapDiffPercentLimit / 100.0);
-                    if (ov.overlapped) {
-                        merged = OverlapAnalysis::merge(r1, r2, ov);
-                        int result = mFilter->passFilter(merged);
-                        if (result == PASS_FILTER) {
-                            config->getTransSearcher()->transSearch(merged, orthId);
-                        } else {
-                            config->getTransSearcher()->transSearch(r1, r2, orthId);
-                        }
-                        delete merged;
-                    } else {
-                        config->getTransSearcher()->transSearch(r1, r2, orthId);
-                    }
+                    config->getTransSearcher()->transSearch(r1, r2, orthIndex);
+                }
+            } else {
+                config->getTransSearcher()->transSearch(r1, r2, orthIndex);
+            }
+        }
+        job->orthIndexes[p] = orthIndex;
+    }
+    mScheduler.addReads(worker, end - begin);
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    if (--job->pendingSearches == 0)
+        mScheduler.submit(worker, STAGE_OUTPUT, [this, job](int w) {outputPairEnd(job, w);});
+}
+
+void PairEndProcessor::outputPairEnd(ReadPairPackJob* job, int worker) {
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    ReadPairPack* pack = job->pack;
+    string * outstr1 = new string();
+    string * outstr2 = new string();
+    string unpairedOut1;
+    string unpairedOut2;
+    string singleOutput;
+    string mergedOutput;
+    string failedOut;
+    std::string * outReadsKOMapStr = new string();
+    //std::string koTag = "";
+    uint32 * orthId = NULL;
+    int mappedReads = 0;
+
+    int readPassed = 0;
+    int mergedCount = 0;
+    for (int p = 0; p < pack->count; p++) {
+        ReadPair* pair = pack->data[p];
+        Read* or1 = pair->mLeft;
+        Read* or2 = pair->mRight;
+        Read* r1 = job->reads1[p];
+        Read* r2 = job->reads2[p];
+        if (job->results[p] == FILTERED_BY_INDEX)
+            continue;
+
+        if (r1 != NULL && r2 != NULL && job->results[p] == PASS_FILTER) {
+            int orthIndex = job->orthIndexes[p];
+            if (orthIndex >= 0) {
+                orthId = const_cast<uint32 *>(mOptions->db->orthIdVec[orthIndex]);
+                if (mProgress) {
+                    mProgress->addId(worker, orthIndex);
                 }
-                
-                if (orthId != NULL) {
-                    if(mOptions->verbose){
-                       idSet.insert(orthId); 
-                    }
-                    mappedReads++;
-                    if (mLeftWriter && mRightWriter) {
-                        *outstr1 += r1->toStringWithTag(orthId);
-                        *outstr2 += r2->toStringWithTag(orthId);
-                    }
-                    if (mReadsKOWriter) {
-                        *outReadsKOMapStr += trimName(r1->mName) + "\t" + "s2f_" + paddingOs(std::to_string(*orthId)) + "\n";
-                    }
+                mappedReads++;
+                if (mLeftWriter && mRightWriter) {
+                    *outstr1 += r1->toStringWithTag(orthId);
+                    *outstr2 += r2->toStringWithTag(orthId);
                 }
-                // stats the read after filtering
-                if (!mOptions->merge.enabled) {
-                    config->getPostStats1()->statRead(r1);
-                    config->getPostStats2()->statRead(r2);
+                if (mReadsKOWriter) {
+                    *outReadsKOMapStr += trimName(r1->mName) + "\t" + "s2f_" + paddingOs(std::to_string(*orthId)) + "\n";
                 }
-                readPassed++;
             }
+            // stats the read after filtering
+            if (!mOptions->merge.enabled) {
+                config->getPostStats1()->statRead(r1);
+                config->getPostStats2()->statRead(r2);
+            }
+            readPassed++;
         }
 
-        delete pair;
+        // the pair stays in the pack, the loader refills it with the next pair
         // if no trimming applied, r1 should be identical to or1
         if (r1 != or1 && r1 != NULL)
             delete r1;
@@ -487,27 +607,9 @@ bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config)
             delete r2;
     }
     
-    if (mOptions->verbose) {
-        mOptions->transSearch.nTransMappedIdReads += mappedReads;
-        logMtx.lock();
-        auto rCount = long(mOptions->transSearch.nTransMappedIdReads);
-//        auto kCount = mOptions->transSearch.koUSet.size();
-//        auto gCount = mOptions->transSearch.goUSet.size();
-        mOptions->transSearch.idUSet.insert(idSet.begin(), idSet.end());
-        auto iCount = mOptions->transSearch.idUSet.size();
-        logMtx.unlock();
-        if (mOptions->longlog) {
-            std::string str = "Mapped " + std::to_string(rCount) + " reads to " + std::to_string(iCount) + " s2f ids!";
-            loginfolong(str);
-        } else {
-            std::string str = "Mapped \033[1;31m" + std::to_string(rCount) + "\033[0m reads to \033[1;32m" + std::to_string(iCount) + "\033[0m s2f ids!";
-            loginfo(str, false);
-        }
+    if (mProgress) {
+        mProgress->addMapped(worker, mappedReads);
     }
-
-    mappedReads = 0;
-
-    idSet.clear();
     
     // if splitting output, then no lock is need since different threads write different files
     if (!mOptions->split.enabled)
@@ -528,59 +630,40 @@ bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config)
             config->getWriter2()->writeString(*outstr2);
     }
 
+    // the writers take the strings over, input() waits while a writer is far behind
     if (mMergedWriter && !mergedOutput.empty()) {
         // write merged data
-        char* mdata = new char[mergedOutput.size()];
-        memcpy(mdata, mergedOutput.c_str(), mergedOutput.size());
-        mMergedWriter->input(mdata, mergedOutput.size());
+        mMergedWriter->input(std::move(mergedOutput));
     }
 
     if (mFailedWriter && !failedOut.empty()) {
         // write failed data
-        char* fdata = new char[failedOut.size()];
-        memcpy(fdata, failedOut.c_str(), failedOut.size());
-        mFailedWriter->input(fdata, failedOut.size());
+        mFailedWriter->input(std::move(failedOut));
     }
 
     // normal output by left/right writer thread
     if (mRightWriter && mLeftWriter && (!outstr1->empty() || !outstr2->empty())) {
         // write PE
-        char* ldata = new char[outstr1->size()];
-        memcpy(ldata, outstr1->c_str(), outstr1->size());
-        mLeftWriter->input(ldata, outstr1->size());
-
-        char* rdata = new char[outstr2->size()];
-        memcpy(rdata, outstr2->c_str(), outstr2->size());
-        mRightWriter->input(rdata, outstr2->size());
+        mLeftWriter->input(std::move(*outstr1));
+        mRightWriter->input(std::move(*outstr2));
     } else if (mLeftWriter && !singleOutput.empty()) {
         // write singleOutput
-        char* ldata = new char[singleOutput.size()];
-        memcpy(ldata, singleOutput.c_str(), singleOutput.size());
-        mLeftWriter->input(ldata, singleOutput.size());
+        mLeftWriter->input(std::move(singleOutput));
     }
     // output unpaired reads
     if (!unpairedOut1.empty() || !unpairedOut2.empty()) {
         if (mUnpairedLeftWriter && mUnpairedRightWriter) {
             // write PE
-            char* unpairedData1 = new char[unpairedOut1.size()];
-            memcpy(unpairedData1, unpairedOut1.c_str(), unpairedOut1.size());
-            mUnpairedLeftWriter->input(unpairedData1, unpairedOut1.size());
-
-            char* unpairedData2 = new char[unpairedOut2.size()];
-            memcpy(unpairedData2, unpairedOut2.c_str(), unpairedOut2.size());
-            mUnpairedRightWriter->input(unpairedData2, unpairedOut2.size());
+            mUnpairedLeftWriter->input(std::move(unpairedOut1));
+            mUnpairedRightWriter->input(std::move(unpairedOut2));
         } else if (mUnpairedLeftWriter) {
-            char* unpairedData = new char[unpairedOut1.size() + unpairedOut2.size() ];
-            memcpy(unpairedData, unpairedOut1.c_str(), unpairedOut1.size());
-            memcpy(unpairedData + unpairedOut1.size(), unpairedOut2.c_str(), unpairedOut2.size());
-            mUnpairedLeftWriter->input(unpairedData, unpairedOut1.size() + unpairedOut2.size());
+            unpairedOut1 += unpairedOut2;
+            mUnpairedLeftWriter->input(std::move(unpairedOut1));
         }
     }
 
     if (mReadsKOWriter && !outReadsKOMapStr->empty()) {
-        char* tdata = new char[outReadsKOMapStr->size()];
-        memcpy(tdata, outReadsKOMapStr->c_str(), outReadsKOMapStr->size());
-        mReadsKOWriter->input(tdata, outReadsKOMapStr->size());
+        mReadsKOWriter->input(std::move(*outReadsKOMapStr));
     }
 
     if (!mOptions->split.enabled)
@@ -610,10 +693,11 @@ bool PairEndProcessor::processPairEnd(ReadPairPack* pack, ThreadConfig* config)
         outReadsKOMapStr = NULL;
     }
 
-    delete pack->data;
-    delete pack;
-
-    return true;
+    // the time of the pack sizes the packs loaded from now on
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    mSizer.finish(pack->count, job->workNanos * 1e-9, PackSizer::secondsSince(job->started));
+    mPool.release(pack);
+    delete job;
 }
 
 void PairEndProcessor::statInsertSize(Read* r1, Read* r2, OverlapResult& ov, int frontTrimmed1, int frontTrimmed2) {
@@ -636,150 +720,147 @@ bool PairEndProcessor::processRead(Read* r, ReadPair* originalPair, bool reverse
     return true;
 }
 
-void PairEndProcessor::initPackRepository() {
-    mRepo.packBuffer = new ReadPairPack*[PACK_NUM_LIMIT];
-    memset(mRepo.packBuffer, 0, sizeof (ReadPairPack*) * PACK_NUM_LIMIT);
-    mRepo.writePos = 0;
-    mRepo.readPos = 0;
-
-}
-
-void PairEndProcessor::destroyPackRepository() {
-    if(mRepo.packBuffer) delete mRepo.packBuffer; mRepo.packBuffer = NULL;
-}
-
-void PairEndProcessor::producePack(ReadPairPack* pack) {
-    mRepo.packBuffer[mRepo.writePos] = pack;
-    mRepo.writePos++;
-}
-
-void PairEndProcessor::consumePack(ThreadConfig* config) {
-    ReadPairPack* data;
-    mInputMtx.lock();
-    while (mRepo.writePos <= mRepo.readPos) {
-        usleep(1000);
-        if (mProduceFinished) {
-            mInputMtx.unlock();
-            return;
-        }
-    }
-    data = mRepo.packBuffer[mRepo.readPos];
-    mRepo.readPos++;
-    mInputMtx.unlock();
-    processPairEnd(data, config);
-}
-
 void PairEndProcessor::producerTask() {
     if (mOptions->verbose){
         mOptions->longlog ? loginfolong("start to load data") : loginfo("start to load data");
     }
     long lastReported = 0;
-    int slept = 0;
     long readNum = 0;
+    time_t loadStart = time(NULL);
+    size_t bytesRead = 0;
+    size_t bytesTotal = 0;
+    // the estimate counts the records of read1, which holds both mates of interleaved input
+    long estimatedPairs = mOptions->mHomoSearchOptions.nEstimatedReads / (mOptions->interleavedInput ? 2 : 1);
     bool splitSizeReEvaluated = false;
-    ReadPair** data = new ReadPair*[PACK_SIZE];
-    memset(data, 0, sizeof (ReadPair*) * PACK_SIZE);
-    FastqReaderPair reader(mOptions->in1, mOptions->in2, true, mOptions->phred64, mOptions->interleavedInput, mOptions->fastqBufferSize);
+    // packs and their pairs come back from the worker threads and are refilled
+    ReadPairPack* pack = mPool.acquire();
+    int packSize = mSizer.nextSize();
+    long pairsCreated = 0;
+    FastqReaderPair reader(mOptions->in1, mOptions->in2, true, mOptions->phred64, mOptions->interleavedInput, mOptions->fastqBufferSize, mOptions->readahead, mOptions->decompressThreads, true, mOptions->ioUringDepth);
     int count = 0;
-    bool needToBreak = false;
     while (true) {
-        ReadPair* read = reader.read();
-        // TODO: put needToBreak here is just a WAR for resolve some unidentified dead lock issue 
-        if (!read || needToBreak) {
-            // the last pack
-            ReadPairPack* pack = new ReadPairPack;
-            pack->data = data;
-            pack->count = count;
-            producePack(pack);
-            data = NULL;
-            if (read) {
-                delete read;
-                read = NULL;
-            }
+        // configured to process only first N reads
+        if (mOptions->readsToProcess > 0 && count + readNum >= mOptions->readsToProcess)
+            break;
+        ReadPair* slot = pack->data[count];
+        ReadPair* read = reader.read(slot);
+        if (!read)
             break;
+        if (!slot) {
+            pack->data[count] = read;
+            pairsCreated++;
         }
-        data[count] = read;
         count++;
-        // configured to process only first N reads
-        if (mOptions->readsToProcess > 0 && count + readNum >= mOptions->readsToProcess) {
-            needToBreak = true;
-        }
         if (mOptions->verbose && count + readNum >= lastReported + 1000000) {
             lastReported = count + readNum;
             string msg = "\nloaded " + to_string((lastReported / 1000000)) + "M read pairs";
+            // the input size is only known when the input could be evaluated, i.e. not for STDIN
+            if (estimatedPairs > 0) {
+                reader.getBytes(bytesRead, bytesTotal);
+                msg += loadingProgress(bytesRead, bytesTotal, estimatedPairs, loadStart);
+            }
             mOptions->longlog ? loginfolong(msg) : loginfo(msg);
         }
-        // a full pack
-        if (count == PACK_SIZE || needToBreak) {
-            ReadPairPack* pack = new ReadPairPack;
-            pack->data = data;
-            pack->count = count;           
-            producePack(pack);
-            //re-initialize data for next pack
-            data = new ReadPair*[PACK_SIZE];
-            memset(data, 0, sizeof (ReadPair*) * PACK_SIZE);
-            // if the consumer is far behind this producer, sleep and wait to limit memory usage
-            while (mRepo.writePos - mRepo.readPos > PACK_IN_MEM_LIMIT) {
-                slept++;
-                usleep(1000);
-            }
+        // a full pack, push() waits while the worker threads are far behind to limit memory usage
+        if (count == packSize) {
+            pack->count = count;
+            mRepo.push(pack);
+            mScheduler.wake();
+            pack = mPool.acquire();
+            packSize = mSizer.nextSize();
             readNum += count;
-            // if the writer threads are far behind this producer, sleep and wait
-            // check this only when necessary
-            if (readNum % (PACK_SIZE * PACK_IN_MEM_LIMIT) == 0 && mLeftWriter) {
-                while ((mLeftWriter && mLeftWriter->bufferLength() > PACK_IN_MEM_LIMIT) || (mRightWriter && mRightWriter->bufferLength() > PACK_IN_MEM_LIMIT)) {
-                    slept++;
-                    usleep(1000);
-                }
-            }
             // reset count to 0
             count = 0;
         }
     }
+    // the last pack, or an unused one back to the pool
+    pack->count = count;
+    if (count > 0)
+        mRepo.push(pack);
+    else
+        mPool.release(pack);
+    mPool.countCreated(pairsCreated);
 
-    mProduceFinished = true;
+    mRepo.close();
+    mScheduler.wake();
+    mSizer.inputDone();
     if (mOptions->verbose){
         mOptions->longlog ? loginfolong("all reads loaded, start to monitor thread status") : loginfo("all reads loaded, start to monitor thread status");
+        string msg = "allocated " + to_string(pairsCreated) + " read pairs and " + to_string(mPool.packsCreated()) + " packs to load " + to_string(readNum + count) + " read pairs";
+        mOptions->longlog ? loginfolong(msg) : loginfo(msg);
+        if (mOptions->readahead > 0 && reader.mLeft->isZipped()) {
+            double leftStall = 0, rightStall = 0;
+            reader.getStallSeconds(leftStall, rightStall);
+            string msg;
+            if (reader.isConcurrent())
+                msg = "R1 thread waited " + to_string(leftStall) + " seconds and R2 thread waited " + to_string(rightStall) + " seconds for decompression";
+            else
+                msg = "loading thread waited " + to_string(leftStall + rightStall) + " seconds for decompression";
+            mOptions->longlog ? loginfolong(msg) : loginfo(msg);
+        }
     }
+}
 
-    // if the last data initialized is not used, free it
-    if (data != NULL)
-        delete[] data;
+void PairEndProcessor::consumerTask(int worker) {
+    ThreadConfig* config = mConfigs[worker];
+    tbwtfmiDB->tnuma->pinWorker(worker);
+    // the queue is polled, so a worker steals tasks while the producer is behind
+    mScheduler.run(worker, [this, config](int w) -> SourceResult {
+        if (config->canBeStopped())
+            return SOURCE_DONE;
+        bool closed = false;
+        ReadPairPack* pack = mRepo.tryPop(closed);
+        if (!pack)
+            return closed ? SOURCE_DONE : SOURCE_WAIT;
+        startPack(pack, w);
+        return SOURCE_PACK;
+    });
+    mFinishedThreads++;
+    finishConsumer(config);
 }
 
-void PairEndProcessor::consumerTask(ThreadConfig* config) {
-    while (true) {            
-        if (config->canBeStopped()) {
-            mFinishedThreads++;
-            break;
-        }
-        while (mRepo.writePos <= mRepo.readPos) {
-            if (mProduceFinished)
+void PairEndProcessor::rangeTask(int worker, const char* leftData, size_t leftLen, const char* rightData, size_t rightLen) {
+    ThreadConfig* config = mConfigs[worker];
+    FastqReader leftReader(leftData, leftLen, true, mOptions->phred64);
+    FastqReader rightReader(rightData, rightLen, true, mOptions->phred64);
+    tbwtfmiDB->tnuma->pinWorker(worker);
+    // the worker parses the next pack of its ranges only when it finds no task to run or to steal
+    // the ranges were split at the same record, so they end together and keep the names of the streaming check
+    long pairs = 0;
+    string where = " of range " + to_string(worker + 1);
+    mScheduler.run(worker, [this, &leftReader, &rightReader, &pairs, &where](int w) -> SourceResult {
+        ReadPairPack* pack = mPool.acquire();
+        int packSize = mSizer.nextSize();
+        while (pack->count < packSize) {
+            ReadPair* slot = pack->data[pack->count];
+            Read* l = leftReader.read(slot ? slot->mLeft : NULL);
+            Read* r = rightReader.read(slot ? slot->mRight : NULL);
+            if (!l || !r) {
+                if (l || r)
+                    FastqReaderPair::outOfPair("pair " + to_string(pairs + 1) + where, l ? l->mName : "end of file",
+                            r ? r->mName : "end of file", mOptions->in1, mOptions->in2);
                 break;
-            usleep(1000);
-        }
-
-        if (mProduceFinished && mRepo.writePos == mRepo.readPos) {
-            mFinishedThreads++;
-            if (mOptions->verbose) {
-                string msg = "\nthread " + to_string(config->getThreadId() + 1) + " data processing completed";
-                 //mOptions->longlog ? loginfolong(msg) : loginfo(msg);
             }
-            break;
+            if (pairs % MATE_CHECK_INTERVAL == 0 && !FastqReaderPair::isMateName(l->mName, r->mName))
+                FastqReaderPair::outOfPair("pair " + to_string(pairs + 1) + where, l->mName, r->mName, mOptions->in1, mOptions->in2);
+            pairs++;
+            if (!slot)
+                pack->data[pack->count] = new ReadPair(l, r);
+            pack->count++;
         }
-        if (mProduceFinished) {
-            if (mOptions->verbose) {
-                string msg = "thread " + to_string(config->getThreadId() + 1) + " is processing the " + to_string(mRepo.readPos) + " / " + to_string(mRepo.writePos) + " pack";
-                // mOptions->longlog ? loginfolong(msg) : loginfo(msg);
-            }
-            consumePack(config);
-            //lock.unlock();
-        } else {
-            //lock.unlock();
-            consumePack(config);
+        if (pack->count == 0) {
+            mPool.release(pack);
+            mSizer.inputDone();
+            return SOURCE_DONE;
         }
-    }
+        startPack(pack, w);
+        return SOURCE_PACK;
+    });
+    mFinishedThreads++;
+    finishConsumer(config);
+}
 
+void PairEndProcessor::finishConsumer(ThreadConfig* config) {
     if (mFinishedThreads == mOptions->thread) {
         if (mLeftWriter)
             mLeftWriter->setInputCompleted();
@@ -804,13 +885,8 @@ void PairEndProcessor::consumerTask(ThreadConfig* config) {
 }
 
 void PairEndProcessor::writeTask(WriterThread* config) {
-    while (true) {
-        if (config->isCompleted()) {
-            // last check for possible threading related issue
-            config->output();
-            break;
-        }
-        config->output();
+    // output() waits for the workers and returns false once their input is completed and written
+    while (config->output()) {
     }
 
     if (mOptions->verbose) {
@@ -841,8 +917,8 @@ void PairEndProcessor::prepareResults() {
         mOptions->transSearch.nMappedCoreOrthos = 0;
         for(const auto & it : mOptions->transSearch.totalIdFreqUMapResults){
             mOptions->transSearch.nTransMappedIdReads += it.second;
-            auto itt = mOptions->mHomoSearchOptions.fullDbMap.find(it.first);
-            if(itt != mOptions->mHomoSearchOptions.fullDbMap.end()){
+            auto itt = mOptions->db->fullDbMap.find(it.first);
+            if(itt != mOptions->db->fullDbMap.end()){
                 *fout << "s2f_" << std::setfill('0') << std::setw(10) << *(it.first) << "\t" <<  it.second << "\t" << itt->second.ko << "|" << itt->second.go << "|" << itt->second.symbol << "|" << itt->second.gene << "\t" << itt->second.coreOrthoPer << "\n";
                 if(itt->second.coreOrthoPer >= 0.90) mOptions->transSearch.nMappedCoreOrthos++;
             } else {
@@ -24,6 +24,7 @@
 #include <iomanip>
 
 #include "fastqreader.h"
+#include "mappedfastq.h"
 #include "util.h"
 #include "adaptertrimmer.h"
 #include "basecorrector.h"
@@ -39,6 +40,11 @@
 #include "duplicate.h"
 #include "read.h"
 #include "bwtfmiDB.h"
+#include "packqueue.h"
+#include "packpool.h"
+#include "stagescheduler.h"
+#include "progressmeter.h"
+#include "packsizer.h"
 
 using namespace std;
 
@@ -49,14 +55,21 @@ struct ReadPairPack {
 
 typedef struct ReadPairPack ReadPairPack;
 
-struct ReadPairRepository {
-    ReadPairPack** packBuffer;
-    atomic_long readPos;
-    atomic_long writePos;
+// a pack on its way through the stages, with what each stage leaves for the next one
+struct ReadPairPackJob {
+    ReadPairPack* pack;
+    // the trimmed reads and the worse filter result of the pair, FILTERED_BY_INDEX for pairs dropped by the index filter
+    vector<Read*> reads1;
+    vector<Read*> reads2;
+    vector<int> results;
+    // index in db->orthIdVec of the ortholog of the read, -1 for unmapped reads
+    vector<int> orthIndexes;
+    atomic_int pendingSearches;
+    // when the stages got the pack, and the worker time they took on it so far
+    std::chrono::steady_clock::time_point started;
+    atomic_long workNanos;
 };
 
-typedef struct ReadPairRepository ReadPairRepository;
-
 class PairEndProcessor{
 public:
     PairEndProcessor(Options* & opt, BwtFmiDB * & tbwtfmiDB);
@@ -64,14 +77,15 @@ public:
     bool process();
 
 private:
-    bool processPairEnd(ReadPairPack* pack, ThreadConfig* config);
+    void startPack(ReadPairPack* pack, int worker);
+    void qcPairEnd(ReadPairPackJob* job, int worker);
+    void searchPairEnd(ReadPairPackJob* job, int begin, int end, int worker);
+    void outputPairEnd(ReadPairPackJob* job, int worker);
     bool processRead(Read* r, ReadPair* originalRead, bool reversed);
-    void initPackRepository();
-    void destroyPackRepository();
-    void producePack(ReadPairPack* pack);
-    void consumePack(ThreadConfig* config);
     void producerTask();
-    void consumerTask(ThreadConfig* config);
+    void consumerTask(int worker);
+    void rangeTask(int worker, const char* leftData, size_t leftLen, const char* rightData, size_t rightLen);
+    void finishConsumer(ThreadConfig* config);
     void initConfig(ThreadConfig* config);
     void initOutput();
     void closeOutput();
@@ -81,12 +95,14 @@ private:
     void prepareResults();
 
 private:
-    ReadPairRepository mRepo;
-    atomic_bool mProduceFinished;
+    PackQueue<ReadPairPack> mRepo;
+    PackPool<ReadPairPack, ReadPair> mPool;
+    StageScheduler mScheduler;
+    PackSizer mSizer;
+    ThreadConfig** mConfigs;
     atomic_int mFinishedThreads;
     std::mutex mOutputMtx;
-    std::mutex mInputMtx;
-    std::mutex logMtx;
+    ProgressMeter* mProgress;
     Options* mOptions;
     Filter* mFilter;
     gzFile mZipFile1;
@@ -127,4 +127,6 @@ bool PolyX::test() {
 //    r.print();
 //
 //    return r.mSeq.mStr == "ATTTT" && fr.getTotalPolyXTrimmedReads() == 1 && fr.getTotalPolyXTrimmedBases() == 51;
+    // the test above is disabled, falling off the end of a bool function crashed the test runner
+    return true;
 }
\ No newline at end of file
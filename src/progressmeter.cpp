@@ -0,0 +1,98 @@
+#include "progressmeter.h"
+#include "util.h"
+#include <functional>
+
+ProgressMeter::ProgressMeter(size_t orthologs, int workers, bool longlog) {
+    mWords = (orthologs + 63) / 64;
+    for (int w = 0; w < workers; w++)
+        mSlots.push_back(new Slot(mWords));
+    mLonglog = longlog;
+    mReporter = NULL;
+    mStop = false;
+}
+
+ProgressMeter::~ProgressMeter() {
+    stop();
+    for (size_t i = 0; i < mSlots.size(); i++)
+        delete mSlots[i];
+    mSlots.clear();
+}
+
+void ProgressMeter::counts(long& mapped, long& ids) {
+    mapped = 0;
+    ids = 0;
+    for (size_t i = 0; i < mSlots.size(); i++)
+        mapped += mSlots[i]->mapped.load(memory_order_relaxed);
+    for (size_t w = 0; w < mWords; w++) {
+        uint64 word = 0;
+        for (size_t i = 0; i < mSlots.size(); i++)
+            word |= mSlots[i]->ids[w].load(memory_order_relaxed);
+        ids += __builtin_popcountl(word);
+    }
+}
+
+void ProgressMeter::report(bool last) {
+    long rCount = 0, iCount = 0;
+    counts(rCount, iCount);
+    if (mLonglog) {
+        std::string str = "Mapped " + std::to_string(rCount) + " reads to " + std::to_string(iCount) + " s2f ids!";
+        loginfolong(str);
+    } else {
+        std::string str = "Mapped \033[1;31m" + std::to_string(rCount) + "\033[0m reads to \033[1;32m" + std::to_string(iCount) + "\033[0m s2f ids!";
+        // the line is redrawn in place, the last one is kept
+        loginfo(str, last);
+    }
+}
+
+void ProgressMeter::start(int intervalMs) {
+    if (mReporter)
+        return;
+    mStop = false;
+    mReporter = new thread(std::bind(&ProgressMeter::reporterTask, this, intervalMs));
+}
+
+void ProgressMeter::stop() {
+    if (!mReporter)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mStop = true;
+    }
+    mStopped.notify_all();
+    mReporter->join();
+    delete mReporter;
+    mReporter = NULL;
+    report(true);
+}
+
+void ProgressMeter::reporterTask(int intervalMs) {
+    std::unique_lock<std::mutex> lock(mMtx);
+    while (!mStopped.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] {return mStop;})) {
+        lock.unlock();
+        report(false);
+        lock.lock();
+    }
+}
+
+bool ProgressMeter::test() {
+    const int workers = 4, ids = 200, reads = 10000;
+    ProgressMeter meter(ids, workers, true);
+    // every worker maps to the ids of its own residue and to id 0, so they overlap
+    vector<std::thread*> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.push_back(new std::thread([&, w] {
+            for (int r = 0; r < reads; r++) {
+                meter.addMapped(w, 1);
+                int i = (r / 2 * workers + w) % ids;
+                meter.addId(w, r % 2 ? i : 0);
+            }
+        }));
+    }
+    for (int w = 0; w < workers; w++) {
+        threads[w]->join();
+        delete threads[w];
+    }
+    long mapped = 0, hit = 0;
+    meter.counts(mapped, hit);
+    return mapped == workers * reads && hit == ids;
+}
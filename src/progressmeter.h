@@ -0,0 +1,69 @@
+#ifndef PROGRESS_METER_H
+#define PROGRESS_METER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "common.h"
+
+using namespace std;
+
+// counts the mapped reads and the s2f ids they hit for the verbose progress line.
+// each worker only writes its own slot with relaxed atomics, so the workers never wait on
+// each other, and a reporter thread sums the slots on a timer and prints the line
+class ProgressMeter {
+public:
+    // orthologs is the size of the dense ortholog index of the database, db->orthIdVec
+    ProgressMeter(size_t orthologs, int workers, bool longlog);
+    ~ProgressMeter();
+
+    inline void addMapped(int worker, long reads) {
+        atomic_long& mapped = mSlots[worker]->mapped;
+        mapped.store(mapped.load(memory_order_relaxed) + reads, memory_order_relaxed);
+    }
+    // orthIndex is the index in db->orthIdVec the searcher found for the read
+    inline void addId(int worker, int orthIndex) {
+        atomic<uint64>& word = mSlots[worker]->ids[orthIndex / 64];
+        uint64 bit = 1UL << (orthIndex % 64);
+        uint64 old = word.load(memory_order_relaxed);
+        // only this worker writes the word, so a plain store is enough and skipped for known ids
+        if (!(old & bit))
+            word.store(old | bit, memory_order_relaxed);
+    }
+
+    // prints the progress every intervalMs until stop, which prints it a last time
+    void start(int intervalMs = 1000);
+    void stop();
+    void counts(long& mapped, long& ids);
+
+    static bool test();
+
+private:
+    struct Slot {
+        atomic_long mapped;
+        vector<atomic<uint64>> ids;
+        // so that two workers never write the same cache line
+        char pad[64];
+        Slot(size_t words) : mapped(0), ids(words) {
+            for (auto & w : ids)
+                w.store(0, memory_order_relaxed);
+        }
+    };
+
+    void reporterTask(int intervalMs);
+    void report(bool last);
+
+private:
+    vector<Slot*> mSlots;
+    size_t mWords;
+    bool mLonglog;
+    thread* mReporter;
+    mutex mMtx;
+    condition_variable mStopped;
+    bool mStop;
+};
+
+#endif
@@ -2,37 +2,39 @@
 #include <sstream>
 #include "util.h"
 
+// the arguments are taken by value and moved in, so callers passing temporaries
+// (like FastqReader) pay for one allocation per field and no further copies
 Read::Read(string name, string seq, string strand, string quality, bool phred64){
-	mName = name;
-	mSeq = Sequence(seq);
-	mStrand = strand;
-	mQuality = quality;
+	mName = std::move(name);
+	mSeq.mStr = std::move(seq);
+	mStrand = std::move(strand);
+	mQuality = std::move(quality);
 	mHasQuality = true;
 	if(phred64)
 		convertPhred64To33();
 }
 
 Read::Read(string name, string seq, string strand){
-	mName = name;
-	mSeq = Sequence(seq);
-	mStrand = strand;
+	mName = std::move(name);
+	mSeq.mStr = std::move(seq);
+	mStrand = std::move(strand);
 	mHasQuality = false;
 }
 
 Read::Read(string name, Sequence seq, string strand, string quality, bool phred64){
-	mName = name;
-	mSeq = seq;
-	mStrand = strand;
-	mQuality = quality;
+	mName = std::move(name);
+	mSeq.mStr = std::move(seq.mStr);
+	mStrand = std::move(strand);
+	mQuality = std::move(quality);
 	mHasQuality = true;
 	if(phred64)
 		convertPhred64To33();
 }
 
 Read::Read(string name, Sequence seq, string strand){
-	mName = name;
-	mSeq = seq;
-	mStrand = strand;
+	mName = std::move(name);
+	mSeq.mStr = std::move(seq.mStr);
+	mStrand = std::move(strand);
 	mHasQuality = false;
 }
 
@@ -48,6 +50,25 @@ Read::Read(Read &r) {
 	mStrand = r.mStrand;
 	mQuality = r.mQuality;
 	mHasQuality = r.mHasQuality;
+	mViewed = r.mViewed;
+	mView = r.mView;
+}
+
+void Read::own() {
+	if(!mViewed)
+		return;
+	mName.assign(mView.name, mView.nameLen);
+	mSeq.mStr.assign(mView.seq, mView.seqLen);
+	mStrand.assign(mView.strand, mView.strandLen);
+	// WAR for FQ with no quality
+	if(mView.quality)
+		mQuality.assign(mView.quality, mView.seqLen);
+	else
+		mQuality.assign(mView.seqLen, 'K');
+	mHasQuality = true;
+	mViewed = false;
+	if(mView.phred64)
+		convertPhred64To33();
 }
 
 void Read::print(){
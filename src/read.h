@@ -12,6 +12,18 @@
 
 using namespace std;
 
+// the fields of a record left in the input buffer by FastqReader, quality is NULL for FASTQ without it
+struct ReadView {
+	const char* name;
+	const char* seq;
+	const char* strand;
+	const char* quality;
+	size_t nameLen;
+	size_t seqLen;
+	size_t strandLen;
+	bool phred64;
+};
+
 class Read{
 public:
     Read(string name, string seq, string strand, string quality, bool phred64 = false);
@@ -37,6 +49,8 @@ public:
     void convertPhred64To33();
     void trimFront(int len);
     bool fixMGI();
+    // copies a viewed record into the strings, before anything reads or changes them
+    void own();
 
 public:
     static bool test();
@@ -50,6 +64,9 @@ public:
 	string mStrand;
 	string mQuality;
 	bool mHasQuality;
+	// the fields are still in mView, pinned by the pack of the read until own() copies them
+	bool mViewed = false;
+	ReadView mView;
 };
 
 class ReadPair{
@@ -0,0 +1,86 @@
+#ifndef READ_CHUNK_H
+#define READ_CHUNK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+// a buffer of input text that parsed reads point into.
+// the reader holds one reference while it fills and parses the chunk, each pack of reads viewing it another
+struct ReadChunk {
+    char* data;
+    size_t size;
+    std::atomic_int refs;
+};
+
+// recycles the chunks of a reader once the last pack viewing them lets them go.
+// ref() is called by the loading thread, unref() by the worker threads
+class ReadChunkPool {
+public:
+    ReadChunkPool() {
+        mCreated = 0;
+    }
+
+    ~ReadChunkPool() {
+        for (size_t i = 0; i < mFree.size(); i++) {
+            delete[] mFree[i]->data;
+            delete mFree[i];
+        }
+        mFree.clear();
+    }
+
+    // a chunk of at least size bytes, referenced once by the caller
+    ReadChunk* acquire(size_t size) {
+        ReadChunk* chunk = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            if (!mFree.empty()) {
+                chunk = mFree.back();
+                mFree.pop_back();
+            }
+            if (chunk == NULL || chunk->size < size)
+                mCreated++;
+        }
+        // chunks only grow when a record does not fit, the smaller one is not needed again
+        if (chunk && chunk->size < size) {
+            delete[] chunk->data;
+            delete chunk;
+            chunk = NULL;
+        }
+        if (chunk == NULL) {
+            chunk = new ReadChunk;
+            chunk->data = new char[size];
+            chunk->size = size;
+        }
+        chunk->refs = 1;
+        return chunk;
+    }
+
+    void ref(ReadChunk* chunk) {
+        chunk->refs++;
+    }
+
+    // the last reference gives the chunk back to be filled again
+    void unref(ReadChunk* chunk) {
+        if (--chunk->refs > 0)
+            return;
+        std::lock_guard<std::mutex> lock(mMtx);
+        mFree.push_back(chunk);
+    }
+
+    long created() {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mCreated;
+    }
+
+private:
+    vector<ReadChunk*> mFree;
+    long mCreated;
+    std::mutex mMtx;
+};
+
+#endif
@@ -1,9 +1,10 @@
 #include "seprocessor.h"
 
-SingleEndProcessor::SingleEndProcessor(Options* & opt, BwtFmiDB * tbwtfmiDB){
+SingleEndProcessor::SingleEndProcessor(Options* & opt, BwtFmiDB * tbwtfmiDB) : mRepo(opt->packQueueDepth * PACK_SIZE), mPool(opt->packSizeMax),
+        mScheduler(opt->thread), mSizer(PACK_SIZE_MIN, opt->packSizeMax, PACK_SIZE, PACK_TARGET_SECONDS) {
     mOptions = opt;
-    mProduceFinished = false;
     mFinishedThreads = 0;
+    mConfigs = NULL;
     mFilter = new Filter(opt);
     mOutStream = NULL;
     mZipFile = NULL;
@@ -16,6 +17,7 @@ SingleEndProcessor::SingleEndProcessor(Options* & opt, BwtFmiDB * tbwtfmiDB){
     if(mOptions->duplicate.enabled) {
         mDuplicate = new Duplicate(mOptions);
     }
+    mProgress = NULL;
     this->tbwtfmiDB = tbwtfmiDB;
     fileoutname.clear();
 }
@@ -35,20 +37,18 @@ SingleEndProcessor::~SingleEndProcessor() {
         delete mUmiProcessor;
         mUmiProcessor = NULL;
     }
-    
-    destroyPackRepository();
 }
 
 void SingleEndProcessor::initOutput() {
     if(!mOptions->failedOut.empty())
         mFailedWriter = new WriterThread(mOptions, mOptions->failedOut);
-    if(mOptions->out1.empty())
-        return;
-    mLeftWriter = new WriterThread(mOptions, mOptions->out1);
-
+    // the reads map does not need the mapped reads output, contig mode only writes this
     if (mOptions->outputReadsAnnoMap && !mOptions->outReadsKOMap.empty()) {
         mReadsKOWriter = new WriterThread(mOptions, mOptions->outReadsKOMap);
     }
+    if(mOptions->out1.empty())
+        return;
+    mLeftWriter = new WriterThread(mOptions, mOptions->out1);
 }
 
 void SingleEndProcessor::closeOutput() {
@@ -81,8 +81,19 @@ bool SingleEndProcessor::process(){
     if(!mOptions->split.enabled)
         initOutput();
 
-    initPackRepository();
-    std::thread producer(std::bind(&SingleEndProcessor::producerTask, this));
+    // uncompressed input can be mapped and split, then each worker thread parses its own range
+    MappedFastq* mapped = NULL;
+    vector<pair<size_t, size_t> > ranges;
+    if(mOptions->mmapInput && !mOptions->contigMode && mOptions->readsToProcess <= 0 && MappedFastq::canMap(mOptions->in1)) {
+        mapped = new MappedFastq(mOptions->in1);
+        ranges = mapped->split(mOptions->thread);
+        if(mOptions->verbose){
+            mOptions->longlog ? loginfolong("input mapped, worker threads parse it directly") : loginfo("input mapped, worker threads parse it directly");
+        }
+    }
+    std::thread* producer = NULL;
+    if(!mapped)
+        producer = new std::thread(std::bind(&SingleEndProcessor::producerTask, this));
 
     //TODO: get the correct cycles
     int cycle = 151;
@@ -91,7 +102,20 @@ bool SingleEndProcessor::process(){
     for(int t=0; t<mOptions->thread; t++){
         configs[t] = new ThreadConfig(mOptions, tbwtfmiDB, t, false);
         initConfig(configs[t]);
-        threads[t] = new std::thread(std::bind(&SingleEndProcessor::consumerTask, this, configs[t]));
+        mScheduler.setNode(t, tbwtfmiDB->tnuma->nodeOfWorker(t));
+    }
+    // the tasks of a pack may run on any worker, they use the ThreadConfig of the worker running them
+    mConfigs = configs;
+    // the progress line is printed by its own thread, the workers only bump their counters
+    if(mOptions->verbose){
+        mProgress = new ProgressMeter(mOptions->db->orthIdVec.size(), mOptions->thread, mOptions->longlog);
+        mProgress->start();
+    }
+    for(int t=0; t<mOptions->thread; t++){
+        if(mapped)
+            threads[t] = new std::thread(std::bind(&SingleEndProcessor::rangeTask, this, t, mapped->data() + ranges[t].first, ranges[t].second - ranges[t].first));
+        else
+            threads[t] = new std::thread(std::bind(&SingleEndProcessor::consumerTask, this, t));
     }
 
     std::thread* leftWriterThread = NULL;
@@ -104,10 +128,19 @@ bool SingleEndProcessor::process(){
     if (mReadsKOWriter)
         readsKOMapWriterThread = new std::thread(std::bind(&SingleEndProcessor::writeTask, this, mReadsKOWriter));
 
-    producer.join();
+    if(producer){
+        producer->join();
+        delete producer;
+    }
     for(int t=0; t<mOptions->thread; t++){
         threads[t]->join();
     }
+    if(mProgress){
+        delete mProgress;
+        mProgress = NULL;
+    }
+    if(mapped)
+        delete mapped;
 
     if(!mOptions->split.enabled) {
         if(leftWriterThread)
@@ -126,13 +159,17 @@ bool SingleEndProcessor::process(){
     vector<Stats*> preStats;
     vector<Stats*> postStats;
     vector<FilterResult*> filterResults;
-    vector<std::map<const uint32 *, uint32> > totalIdFreqVecResults;
+    vector<const std::vector<uint32> *> totalIdFreqVecResults;
     totalIdFreqVecResults.reserve(mOptions->thread);
+    uint64 searchedFragments = 0, prunedFragments = 0, searchedReads = 0;
     for(int t=0; t<mOptions->thread; t++){
         preStats.push_back(configs[t]->getPreStats1());
         postStats.push_back(configs[t]->getPostStats1());
         filterResults.push_back(configs[t]->getFilterResult());
-        totalIdFreqVecResults.push_back(configs[t]->getTransSearcher()->getIdFreqSubMap());
+        totalIdFreqVecResults.push_back(&configs[t]->getTransSearcher()->getIdFreqSubVec());
+        searchedFragments += configs[t]->getTransSearcher()->getSearchedFragments();
+        prunedFragments += configs[t]->getTransSearcher()->getPrunedFragments();
+        searchedReads += configs[t]->getTransSearcher()->getSearchedReads();
     }
     Stats* finalPreStats = Stats::merge(preStats);
     Stats* finalPostStats = Stats::merge(postStats);
@@ -140,9 +177,19 @@ bool SingleEndProcessor::process(){
     
     mOptions->mHomoSearchOptions.nTotalReads = finalPreStats->getReads(); //change to both reads??????
     mOptions->mHomoSearchOptions.nCleanReads = finalPostStats->getReads();
-    mOptions->transSearch.totalIdFreqUMapResults = TransSearcher::merge(totalIdFreqVecResults);
+    mOptions->transSearch.totalIdFreqUMapResults = TransSearcher::merge(totalIdFreqVecResults, mOptions);
     mOptions->transSearch.nTransMappedIds = mOptions->transSearch.totalIdFreqUMapResults.size();
     totalIdFreqVecResults.clear();
+    if (mOptions->verbose && searchedReads > 0) {
+        std::stringstream ss;
+        ss << "searched " << searchedFragments << " fragments, pruned " << prunedFragments << " by score bound ("
+                << (double) searchedFragments / searchedReads << " searched, " << (double) prunedFragments / searchedReads << " pruned per read)";
+        mOptions->longlog ? loginfolong(ss.str()) : loginfo(ss.str());
+    }
+    if (mOptions->verbose) {
+        mOptions->longlog ? loginfolong(mScheduler.summary()) : loginfo(mScheduler.summary());
+        mOptions->longlog ? loginfolong(mSizer.summary()) : loginfo(mSizer.summary());
+    }
     
     prepareResults();
 
@@ -167,6 +214,8 @@ bool SingleEndProcessor::process(){
     // make JSON report
     JsonReporter jr(mOptions);
     jr.setDupHist(dupHist, dupMeanGC, dupRate);
+    jr.setScheduler(&mScheduler);
+    jr.setPackSizer(&mSizer);
     jr.report(finalFilterResult, finalPreStats, finalPostStats);
     // make HTML report
     HtmlReporter hr(mOptions);
@@ -206,21 +255,28 @@ bool SingleEndProcessor::process(){
     return true;
 }
 
-bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
-    string * outstr = new string();
-    string failedOut;
-    int readPassed = 0;
-    std::string * outReadsKOMapStr = new string();
-    //std::string koTag = "";
-    uint32* orthId = NULL;
-    std::set<uint32 *> idSet;
-    
-    int mappedReads = 0;
-    
+void SingleEndProcessor::startPack(ReadPack* pack, int worker){
+    ReadPackJob* job = new ReadPackJob;
+    job->pack = pack;
+    job->reads.assign(pack->count, NULL);
+    job->results.assign(pack->count, FILTERED_BY_INDEX);
+    job->orthIndexes.assign(pack->count, -1);
+    job->pendingSearches = 0;
+    job->started = std::chrono::steady_clock::now();
+    job->workNanos = 0;
+    mScheduler.submit(worker, STAGE_QC, [this, job](int w) {qcSingleEnd(job, w);});
+}
+
+void SingleEndProcessor::qcSingleEnd(ReadPackJob* job, int worker){
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    ReadPack* pack = job->pack;
+    int passed = 0;
     for(int p=0;p<pack->count;p++){
 
-        // original read1
+        // original read1, copied out of the input chunk it views
         Read* or1 = pack->data[p];
+        or1->own();
 
         // stats the original read before trimming
         config->getPreStats1()->statRead(or1);
@@ -231,7 +287,6 @@ bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
 
         // filter by index
         if(mOptions->indexFilter.enabled && mFilter->filterByIndex(or1)) {
-            delete or1;
             continue;
         }
         
@@ -280,15 +335,74 @@ bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
         int result = mFilter->passFilter(r1);
         
         config->addFilterResult(result, 1);
-        
-        if (r1 != NULL && result == PASS_FILTER) {
-            orthId = NULL;
-            
-            config->getTransSearcher()->transSearch(r1, orthId);
 
-            if (orthId != NULL) {
-                if(mOptions->verbose){
-                    idSet.insert(orthId);
+        job->reads[p] = r1;
+        job->results[p] = result;
+        if (r1 != NULL && result == PASS_FILTER)
+            passed++;
+    }
+    for(auto chunk : pack->chunks)
+        mChunks.unref(chunk);
+    pack->chunks.clear();
+
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    if(passed == 0) {
+        mScheduler.submit(worker, STAGE_OUTPUT, [this, job](int w) {outputSingleEnd(job, w);});
+        return;
+    }
+    // the search is split into tasks, the last one to finish queues the output of the pack
+    int tasks = (pack->count + SEARCH_TASK_SIZE - 1) / SEARCH_TASK_SIZE;
+    job->pendingSearches = tasks;
+    for(int t = tasks - 1; t >= 0; t--) {
+        int begin = t * SEARCH_TASK_SIZE;
+        int end = min(begin + SEARCH_TASK_SIZE, pack->count);
+        mScheduler.submit(worker, STAGE_SEARCH, [this, job, begin, end](int w) {searchSingleEnd(job, begin, end, w);});
+    }
+}
+
+void SingleEndProcessor::searchSingleEnd(ReadPackJob* job, int begin, int end, int worker){
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    for(int p = begin; p < end; p++){
+        Read* r1 = job->reads[p];
+        if (r1 != NULL && job->results[p] == PASS_FILTER) {
+            int orthIndex = -1;
+            config->getTransSearcher()->transSearch(r1, orthIndex);
+            job->orthIndexes[p] = orthIndex;
+        }
+    }
+    mScheduler.addReads(worker, end - begin);
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    if(--job->pendingSearches == 0)
+        mScheduler.submit(worker, STAGE_OUTPUT, [this, job](int w) {outputSingleEnd(job, w);});
+}
+
+void SingleEndProcessor::outputSingleEnd(ReadPackJob* job, int worker){
+    auto stageStart = std::chrono::steady_clock::now();
+    ThreadConfig* config = mConfigs[worker];
+    ReadPack* pack = job->pack;
+    string * outstr = new string();
+    string failedOut;
+    int readPassed = 0;
+    std::string * outReadsKOMapStr = new string();
+    //std::string koTag = "";
+    uint32* orthId = NULL;
+    
+    int mappedReads = 0;
+    
+    for(int p=0;p<pack->count;p++){
+        Read* or1 = pack->data[p];
+        Read* r1 = job->reads[p];
+        int result = job->results[p];
+        if(result == FILTERED_BY_INDEX)
+            continue;
+
+        if (r1 != NULL && result == PASS_FILTER) {
+            int orthIndex = job->orthIndexes[p];
+            if (orthIndex >= 0) {
+                orthId = const_cast<uint32*>(mOptions->db->orthIdVec[orthIndex]);
+                if(mProgress){
+                    mProgress->addId(worker, orthIndex);
                 }
                 mappedReads++;
                 if (mLeftWriter) {
@@ -307,32 +421,15 @@ bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
             failedOut += or1->toStringWithTag(FAILED_TYPES[result]);
         }
         
-        delete or1;
+        // or1 stays in the pack, the loader refills it with the next read
         // if no trimming applied, r1 should be identical to or1
         if(r1 != or1 && r1 != NULL)
             delete r1;
     }
 
-    if (mOptions->verbose) {
-        mOptions->transSearch.nTransMappedIdReads += mappedReads;
-        logMtx.lock();
-        auto rCount = long(mOptions->transSearch.nTransMappedIdReads);
-        mOptions->transSearch.idUSet.insert(idSet.begin(), idSet.end());
-        auto iCount = mOptions->transSearch.idUSet.size();
-//        auto kCount = mOptions->transSearch.koUSet.size();
-//        auto gCount = mOptions->transSearch.goUSet.size();
-        logMtx.unlock(); 
-        if (mOptions->longlog) {
-            std::string str = "Mapped " + std::to_string(rCount) + " reads to " + std::to_string(iCount) + " s2f ids!";
-            loginfolong(str);
-        } else {
-            std::string str = "Mapped \033[1;31m" + std::to_string(rCount) + "\033[0m reads to \033[1;32m" + std::to_string(iCount) + "\033[0m s2f ids!";
-            loginfo(str, false);
-        }
+    if(mProgress){
+        mProgress->addMapped(worker, mappedReads);
     }
-
-    mappedReads = 0;
-    idSet.clear();
     // if splitting output, then no lock is need since different threads write different files
     if(!mOptions->split.enabled)
         mOutputMtx.lock();
@@ -344,22 +441,17 @@ bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
             config->getWriter1()->writeString(*outstr);
     } 
 
+    // the writers take the strings over, input() waits while a writer is far behind
     if(mLeftWriter) {
-        char* ldata = new char[outstr->size()];
-        memcpy(ldata, outstr->c_str(), outstr->size());
-        mLeftWriter->input(ldata, outstr->size());
+        mLeftWriter->input(std::move(*outstr));
     }
     if(mFailedWriter && !failedOut.empty()) {
         // write failed data
-        char* fdata = new char[failedOut.size()];
-        memcpy(fdata, failedOut.c_str(), failedOut.size());
-        mFailedWriter->input(fdata, failedOut.size());
+        mFailedWriter->input(std::move(failedOut));
     }
     
     if (mReadsKOWriter && !outReadsKOMapStr->empty()) {
-        char* tdata = new char[outReadsKOMapStr->size()];
-        memcpy(tdata, outReadsKOMapStr->c_str(), outReadsKOMapStr->size());
-        mReadsKOWriter->input(tdata, outReadsKOMapStr->size());
+        mReadsKOWriter->input(std::move(*outReadsKOMapStr));
     }
     
     if(!mOptions->split.enabled)
@@ -380,43 +472,11 @@ bool SingleEndProcessor::processSingleEnd(ReadPack* pack, ThreadConfig* config){
         outReadsKOMapStr = NULL;
     }
     
-    delete pack->data;
-    delete pack;
-
-    return true;
-}
-
-void SingleEndProcessor::initPackRepository() {
-    mRepo.packBuffer = new ReadPack*[PACK_NUM_LIMIT];
-    memset(mRepo.packBuffer, 0, sizeof(ReadPack*)*PACK_NUM_LIMIT);
-    mRepo.writePos = 0;
-    mRepo.readPos = 0;
-    //mRepo.readCounter = 0;
-}
-
-void SingleEndProcessor::destroyPackRepository() {
-    if(mRepo.packBuffer) delete mRepo.packBuffer; mRepo.packBuffer = NULL;
-}
-
-void SingleEndProcessor::producePack(ReadPack* pack){
-    mRepo.packBuffer[mRepo.writePos] = pack;
-    mRepo.writePos++;
-}
-
-void SingleEndProcessor::consumePack(ThreadConfig* config){
-    ReadPack* data;
-    mInputMtx.lock();
-    while(mRepo.writePos <= mRepo.readPos) {
-        usleep(1000);
-        if(mProduceFinished) {
-            mInputMtx.unlock();
-            return;
-        }
-    }
-    data = mRepo.packBuffer[mRepo.readPos];
-    mRepo.readPos++;
-    mInputMtx.unlock();
-    processSingleEnd(data, config);
+    // the time of the pack sizes the packs loaded from now on
+    job->workNanos += PackSizer::nanosSince(stageStart);
+    mSizer.finish(pack->count, job->workNanos * 1e-9, PackSizer::secondsSince(job->started));
+    mPool.release(pack);
+    delete job;
 }
 
 void SingleEndProcessor::producerTask(){
@@ -424,112 +484,140 @@ void SingleEndProcessor::producerTask(){
         mOptions->longlog ? loginfolong("start to load data") : loginfo("start to load data");
     }
     long lastReported = 0;
-    int slept = 0;
     long readNum = 0;
+    time_t loadStart = time(NULL);
+    size_t bytesRead = 0;
+    size_t bytesTotal = 0;
     bool splitSizeReEvaluated = false;
-    Read** data = new Read*[PACK_SIZE];
-    memset(data, 0, sizeof(Read*)*PACK_SIZE);
-    FastqReader reader(mOptions->in1, true, mOptions->phred64, mOptions->fastqBufferSize);
+    // packs and their reads come back from the worker threads and are refilled
+    ReadPack* pack = mPool.acquire();
+    int packSize = mSizer.nextSize();
+    long readsCreated = 0;
+    // in contig mode the reads are windows of the FASTA sequences
+    FastqReader* reader = NULL;
+    FastaWindowReader* windowReader = NULL;
+    if(mOptions->contigMode)
+        windowReader = new FastaWindowReader(mOptions->in1, mOptions->contigWindow, mOptions->contigStep);
+    else
+        reader = new FastqReader(mOptions->in1, true, mOptions->phred64, mOptions->fastqBufferSize, mOptions->readahead, mOptions->decompressThreads, mOptions->ioUringDepth);
+    // the reads are copied out of the input by the worker threads, the loading thread only finds the records
+    if(reader)
+        reader->viewInto(&mChunks);
     int count=0;
-    bool needToBreak = false;
     while(true){
-        Read* read = reader.read();
-        // TODO: put needToBreak here is just a WAR for resolve some unidentified dead lock issue 
-        if(!read || needToBreak){
-            // the last pack
-            ReadPack* pack = new ReadPack;
-            pack->data = data;
-            pack->count = count;
-            producePack(pack);
-            data = NULL;
-            if(read) {
-                delete read;
-                read = NULL;
-            }
+        // configured to process only first N reads
+        if(mOptions->readsToProcess > 0 && count + readNum >= mOptions->readsToProcess)
+            break;
+        Read* slot = pack->data[count];
+        Read* read = reader ? reader->read(slot) : windowReader->read(slot);
+        if(!read)
             break;
+        if(!slot) {
+            pack->data[count] = read;
+            readsCreated++;
         }
-        data[count] = read;
-        count++;
-        // configured to process only first N reads
-        if(mOptions->readsToProcess >0 && count + readNum >= mOptions->readsToProcess) {
-            needToBreak = true;
+        // the pack keeps the chunk the read views, the reader moves on to another one before refilling it
+        if(reader && (pack->chunks.empty() || pack->chunks.back() != reader->chunk())) {
+            mChunks.ref(reader->chunk());
+            pack->chunks.push_back(reader->chunk());
         }
+        count++;
         if(mOptions->verbose && count + readNum >= lastReported + 1000000) {
             lastReported = count + readNum;
             string msg = "\nloaded " + to_string((lastReported/1000000)) + "M reads";
+            // the input size is only known when the input could be evaluated, i.e. not for STDIN
+            if(reader && mOptions->mHomoSearchOptions.nEstimatedReads > 0) {
+                reader->getBytes(bytesRead, bytesTotal);
+                msg += loadingProgress(bytesRead, bytesTotal, mOptions->mHomoSearchOptions.nEstimatedReads, loadStart);
+            }
             mOptions->longlog ? loginfolong(msg) : loginfo(msg);
         }
-        // a full pack
-        if(count == PACK_SIZE || needToBreak){
-            ReadPack* pack = new ReadPack;
-            pack->data = data;
+        // a full pack, push() waits while the worker threads are far behind to limit memory usage
+        if(count == packSize){
             pack->count = count;
-            producePack(pack);
-            //re-initialize data for next pack
-            data = new Read*[PACK_SIZE];
-            memset(data, 0, sizeof(Read*)*PACK_SIZE);
-            // if the consumer is far behind this producer, sleep and wait to limit memory usage
-            while(mRepo.writePos - mRepo.readPos > PACK_IN_MEM_LIMIT){
-                slept++;
-                usleep(1000);
-            }
+            mRepo.push(pack);
+            mScheduler.wake();
+            pack = mPool.acquire();
+            packSize = mSizer.nextSize();
             readNum += count;
-            // if the writer threads are far behind this producer, sleep and wait
-            // check this only when necessary
-            if(readNum % (PACK_SIZE * PACK_IN_MEM_LIMIT) == 0 && mLeftWriter) {
-                while(mLeftWriter->bufferLength() > PACK_IN_MEM_LIMIT) {
-                    slept++;
-                    usleep(1000);
-                }
-            }
             // reset count to 0
             count = 0;
         }
     }
+    // the last pack, or an unused one back to the pool
+    pack->count = count;
+    if(count > 0)
+        mRepo.push(pack);
+    else
+        mPool.release(pack);
+    mPool.countCreated(readsCreated);
 
-    //std::unique_lock<std::mutex> lock(mRepo.readCounterMtx);
-    mProduceFinished = true;
+    mRepo.close();
+    mScheduler.wake();
+    mSizer.inputDone();
     if(mOptions->verbose){
         mOptions->longlog ? loginfolong("all reads loaded, start to monitor thread status") : loginfo("all reads loaded, start to monitor thread status");
+        string msg = "allocated " + to_string(readsCreated) + " reads, " + to_string(mPool.packsCreated()) + " packs and " + to_string(mChunks.created()) + " input chunks to load " + to_string(readNum + count) + " reads";
+        mOptions->longlog ? loginfolong(msg) : loginfo(msg);
+        if(reader && reader->isZipped() && mOptions->readahead > 0){
+            string msg = "loading thread waited " + to_string(reader->getStallSeconds()) + " seconds for decompression";
+            mOptions->longlog ? loginfolong(msg) : loginfo(msg);
+        }
     }
     //lock.unlock();
 
-    // if the last data initialized is not used, free it
-    if(data != NULL)
-        delete[] data;
+    if(reader)
+        delete reader;
+    if(windowReader)
+        delete windowReader;
 }
 
-void SingleEndProcessor::consumerTask(ThreadConfig* config){
-    while(true) {
-        if(config->canBeStopped()){
-            mFinishedThreads++;
-            break;
-        }
-        while(mRepo.writePos <= mRepo.readPos) {
-            if(mProduceFinished)
+void SingleEndProcessor::consumerTask(int worker){
+    ThreadConfig* config = mConfigs[worker];
+    tbwtfmiDB->tnuma->pinWorker(worker);
+    // the queue is polled, so a worker steals tasks while the producer is behind
+    mScheduler.run(worker, [this, config](int w) -> SourceResult {
+        if(config->canBeStopped())
+            return SOURCE_DONE;
+        bool closed = false;
+        ReadPack* pack = mRepo.tryPop(closed);
+        if(!pack)
+            return closed ? SOURCE_DONE : SOURCE_WAIT;
+        startPack(pack, w);
+        return SOURCE_PACK;
+    });
+    mFinishedThreads++;
+    finishConsumer(config);
+}
+
+void SingleEndProcessor::rangeTask(int worker, const char* data, size_t len){
+    ThreadConfig* config = mConfigs[worker];
+    FastqReader reader(data, len, true, mOptions->phred64);
+    tbwtfmiDB->tnuma->pinWorker(worker);
+    // the worker parses the next pack of its range only when it finds no task to run or to steal
+    mScheduler.run(worker, [this, &reader](int w) -> SourceResult {
+        ReadPack* pack = mPool.acquire();
+        int packSize = mSizer.nextSize();
+        while(pack->count < packSize){
+            Read* slot = pack->data[pack->count];
+            Read* read = reader.read(slot);
+            if(!read)
                 break;
-            usleep(1000);
-        }
-        //std::unique_lock<std::mutex> lock(mRepo.readCounterMtx);
-        if(mProduceFinished && mRepo.writePos == mRepo.readPos){
-            mFinishedThreads++;
-            if(mOptions->verbose) {
-                string msg = "thread " + to_string(config->getThreadId() + 1) + " data processing completed";
-                //loginfo(msg, false);
-            }
-            break;
+            pack->data[pack->count++] = read;
         }
-        if(mProduceFinished){
-            if(mOptions->verbose) {
-                string msg = "thread " + to_string(config->getThreadId() + 1) + " is processing the " + to_string(mRepo.readPos) + " / " + to_string(mRepo.writePos) + " pack";
-                //loginfo(msg, false);
-            }
-            consumePack(config);
-        } else {
-            consumePack(config);
+        if(pack->count == 0){
+            mPool.release(pack);
+            mSizer.inputDone();
+            return SOURCE_DONE;
         }
-    }
+        startPack(pack, w);
+        return SOURCE_PACK;
+    });
+    mFinishedThreads++;
+    finishConsumer(config);
+}
 
+void SingleEndProcessor::finishConsumer(ThreadConfig* config){
     if(mFinishedThreads == mOptions->thread) {
         if(mLeftWriter)
             mLeftWriter->setInputCompleted();
@@ -546,13 +634,8 @@ void SingleEndProcessor::consumerTask(ThreadConfig* config){
 }
 
 void SingleEndProcessor::writeTask(WriterThread* config){
-    while(true) {
-        if(config->isCompleted()){
-            // last check for possible threading related issue
-            config->output();
-            break;
-        }
-        config->output();
+    // output() waits for the workers and returns false once their input is completed and written
+    while(config->output()) {
     }
 
     if(mOptions->verbose) {
@@ -583,8 +666,8 @@ void SingleEndProcessor::prepareResults() {
         if(mOptions->transSearch.nTransMappedIdReads != 0) mOptions->transSearch.nTransMappedIdReads = 0;
         for(const auto & it : mOptions->transSearch.totalIdFreqUMapResults){
             mOptions->transSearch.nTransMappedIdReads += it.second;
-            auto itt = mOptions->mHomoSearchOptions.fullDbMap.find(it.first);
-            if(itt != mOptions->mHomoSearchOptions.fullDbMap.end()){
+            auto itt = mOptions->db->fullDbMap.find(it.first);
+            if(itt != mOptions->db->fullDbMap.end()){
                 *fout << "s2f_" << std::setfill('0') << std::setw(10) << *(it.first) << "\t" <<  it.second << "\t" << itt->second.ko << "|" << itt->second.go << "|" << itt->second.symbol << "|" << itt->second.gene << "\t" << itt->second.coreOrthoPer << "\n";
                 if(itt->second.coreOrthoPer >= 0.90) mOptions->transSearch.nMappedCoreOrthos++;
             } else {
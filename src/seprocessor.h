@@ -29,6 +29,8 @@
 #include "writerthread.h"
 #include "duplicate.h"
 #include "fastqreader.h"
+#include "mappedfastq.h"
+#include "fastareader.h"
 #include "util.h"
 #include "jsonreporter.h"
 #include "htmlreporter.h"
@@ -36,6 +38,12 @@
 #include "polyx.h"
 #include "read.h"
 #include "common.h"
+#include "packqueue.h"
+#include "packpool.h"
+#include "readchunk.h"
+#include "stagescheduler.h"
+#include "progressmeter.h"
+#include "packsizer.h"
 #include "bwtfmiDB.h"
 
 
@@ -44,18 +52,26 @@ using namespace std;
 struct ReadPack {
     Read** data;
     int count;
+    // the input chunks the reads view until the qc stage copies them
+    vector<ReadChunk*> chunks;
 };
 
 typedef struct ReadPack ReadPack;
 
-struct ReadRepository {
-    ReadPack** packBuffer;
-    atomic_long readPos;
-    atomic_long writePos;
+// a pack on its way through the stages, with what each stage leaves for the next one
+struct ReadPackJob {
+    ReadPack* pack;
+    // the trimmed read and its filter result, FILTERED_BY_INDEX for reads dropped by the index filter
+    vector<Read*> reads;
+    vector<int> results;
+    // index in db->orthIdVec of the ortholog of the read, -1 for unmapped reads
+    vector<int> orthIndexes;
+    atomic_int pendingSearches;
+    // when the stages got the pack, and the worker time they took on it so far
+    std::chrono::steady_clock::time_point started;
+    atomic_long workNanos;
 };
 
-typedef struct ReadRepository ReadRepository;
-
 class SingleEndProcessor{
 public:
     SingleEndProcessor(Options* & opt, BwtFmiDB * tbwtfmiDB);
@@ -63,13 +79,14 @@ public:
     bool process();
 
 private:
-    bool processSingleEnd(ReadPack* pack, ThreadConfig* config);
-    void initPackRepository();
-    void destroyPackRepository();
-    void producePack(ReadPack* pack);
-    void consumePack(ThreadConfig* config);
+    void startPack(ReadPack* pack, int worker);
+    void qcSingleEnd(ReadPackJob* job, int worker);
+    void searchSingleEnd(ReadPackJob* job, int begin, int end, int worker);
+    void outputSingleEnd(ReadPackJob* job, int worker);
     void producerTask();
-    void consumerTask(ThreadConfig* config);
+    void consumerTask(int worker);
+    void rangeTask(int worker, const char* data, size_t len);
+    void finishConsumer(ThreadConfig* config);
     void initConfig(ThreadConfig* config);
     void initOutput();
     void closeOutput();
@@ -77,12 +94,15 @@ private:
     void prepareResults();
 private:
     Options* mOptions;
-    ReadRepository mRepo;
-    atomic_bool mProduceFinished;
+    PackQueue<ReadPack> mRepo;
+    PackPool<ReadPack, Read> mPool;
+    ReadChunkPool mChunks;
+    StageScheduler mScheduler;
+    PackSizer mSizer;
+    ThreadConfig** mConfigs;
     atomic_int mFinishedThreads;
-    std::mutex mInputMtx;
     std::mutex mOutputMtx;
-    std::mutex logMtx;
+    ProgressMeter* mProgress;
     Filter* mFilter;
     gzFile mZipFile;
     ofstream* mOutStream;
@@ -17,11 +17,142 @@
 #include "processor.h"
 #include "evaluator.h"
 #include "bwtfmiDB.h"
+#include "fragment.h"
 #include "htmlreporterall.h"
+#include "memoryplan.h"
 
 string command;
 mutex logmtx;
 
+// the command and the mapping rates of the sample just processed
+static string sampleSummary(Options* opt) {
+    std::stringstream summary;
+    summary << endl << command << endl;
+    summary << endl << "Seq2Fun v" << SEQ2FUNR_VER << ", time used: " << convertSeconds(opt->transSearch.timeLapse) <<
+            ", mapped " << opt->transSearch.nTransMappedIdReads << " reads out of " <<
+            opt->mHomoSearchOptions.nTotalReads << " (" <<
+            getPercentage(long(opt->transSearch.nTransMappedIdReads), opt->mHomoSearchOptions.nTotalReads) << " %), " <<
+            "mapped " << opt->transSearch.nTransMappedIds << " S2f ids out of " <<
+            opt->transSearch.nIdDB << " S2f ids (" <<
+            getPercentage(opt->transSearch.nTransMappedIds, opt->transSearch.nIdDB) <<
+            " %), " << "mapped " << opt->transSearch.nMappedCoreOrthos << " core orthologs out of " <<
+            opt->transSearch.coreOrthosDb << " orthologs (" << getPercentage(opt->transSearch.nMappedCoreOrthos, opt->transSearch.coreOrthosDb) <<
+            " %)" << endl << endl;
+    return summary.str();
+}
+
+// runs one sample, of the sample table or given by --prefix, with the results going to opt; begin is when its time starts
+static void processSample(Options* opt, const Sample & sample, int count, size_t nSamples, Evaluator* eva, bool detectTwoColor, BwtFmiDB* tbwtfmiDB, time_t begin) {
+    opt->transSearch.startTime = begin;
+    std::stringstream msgSS;
+    msgSS << "processing sample: " << sample.prefix << ", " << count << " out of " << nSamples << " samples" << "\n";
+    opt->longlog ? loginfolong( msgSS.str()) : loginfo(msgSS.str());
+    opt->mHomoSearchOptions.prefix = sample.prefix;
+    opt->in1 = sample.in1;
+    opt->in2 = sample.in2;
+    opt->htmlFile = sample.prefix + "_report.html";
+    opt->jsonFile = sample.prefix + "_report.json";
+
+    if (opt->outputMappedCleanReads) {
+        opt->out1 = sample.prefix + "_mapped_R1.fastq.gz";
+        if (opt->isPaired()) opt->out2 = sample.prefix + "_mapped_R2.fastq.gz";
+    }
+
+    if (opt->outputReadsAnnoMap) {
+        opt->outReadsKOMap = opt->mHomoSearchOptions.prefix + "_readsMap.txt.gz";
+    }
+
+    opt->mHomoSearchOptions.commandStr = command;
+
+    bool supportEvaluation = !opt->inputFromSTDIN && !opt->contigMode && opt->in1 != "/dev/stdin";
+    // the first sample was already read while the index was loading
+    if (eva == NULL)
+        eva = new Evaluator(opt);
+    if (supportEvaluation) {
+        eva->evaluateSeqLen();
+        if (opt->overRepAnalysis.enabled)
+            eva->evaluateOverRepSeqs();
+    }
+
+    long readNum = 0;
+
+    // using evaluator to guess how many reads in total
+    if (opt->shallDetectAdapter(false)) {
+        if (!supportEvaluation)
+            cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
+        else {
+            cerr << "Detecting adapter sequence for read1..." << endl;
+            string adapt = eva->evalAdapterAndReadNum(readNum, false);
+            if (adapt.length() > 60)
+                adapt.resize(0, 60);
+            if (adapt.length() > 0) {
+                opt->adapter.sequence = adapt;
+                opt->adapter.detectedAdapter1 = adapt;
+            } else {
+                cerr << "No adapter detected for read1" << endl;
+                opt->adapter.sequence = "";
+            }
+            cerr << endl;
+        }
+    }
+    if (opt->shallDetectAdapter(true)) {
+        if (!supportEvaluation)
+            cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
+        else {
+            cerr << "Detecting adapter sequence for read2..." << endl;
+            string adapt = eva->evalAdapterAndReadNum(readNum, true);
+            if (adapt.length() > 60)
+                adapt.resize(0, 60);
+            if (adapt.length() > 0) {
+                opt->adapter.sequenceR2 = adapt;
+                opt->adapter.detectedAdapter2 = adapt;
+            } else {
+                cerr << "No adapter detected for read2" << endl;
+                opt->adapter.sequenceR2 = "";
+            }
+            cerr << endl;
+        }
+    }
+
+    opt->validate();
+
+    // using evaluator to guess how many reads in total
+    if (opt->split.needEvaluation && supportEvaluation) {
+        // if readNum is not 0, means it is already evaluated by other functions
+        if (readNum == 0) {
+            eva->evaluateReadNum(readNum);
+        }
+        opt->split.size = readNum / opt->split.number;
+        // one record per file at least
+        if (opt->split.size <= 0) {
+            opt->split.size = 1;
+            cerr << "WARNING: the input file has less reads than the number of files to split" << endl;
+        }
+    }
+
+    // using evaluator to check if it's two color system
+    if (detectTwoColor && supportEvaluation) {
+        bool twoColorSystem = eva->isTwoColorSystem();
+        if (twoColorSystem) {
+            opt->polyGTrim.enabled = true;
+        }
+    }
+    // projected read number for the loading progress, taken from the sample so it needs no pass of its own
+    if (supportEvaluation) {
+        eva->evaluateReadNum(opt->mHomoSearchOptions.nEstimatedReads);
+        if (opt->verbose) {
+            string msg = "about " + to_string(opt->mHomoSearchOptions.nEstimatedReads) + " reads in " + opt->in1;
+            opt->longlog ? loginfolong(msg) : loginfo(msg);
+        }
+    }
+    delete eva;
+    
+    Processor p(opt);
+    p.process(tbwtfmiDB);
+    // one write, so that the summaries of concurrent samples do not interleave
+    cerr << sampleSummary(opt);
+}
+
 int main(int argc, char* argv[]) {
     // display version info if no argument is given
     time_t t_begin = time(NULL);
@@ -34,6 +165,15 @@ int main(int argc, char* argv[]) {
         tester.run();
         return 0;
     }
+    if (argc == 3 && strcmp(argv[1], "bench_parser") == 0) {
+        FastqReader::benchmark(argv[2]);
+        return 0;
+    }
+    // bench_io <file> [reads in flight] [microseconds added to every read]
+    if (argc >= 3 && argc <= 5 && strcmp(argv[1], "bench_io") == 0) {
+        UringReader::benchmark(argv[2], argc > 3 ? atoi(argv[3]) : 8, argc > 4 ? atoi(argv[4]) : 0);
+        return 0;
+    }
     if (argc == 2 && (strcmp(argv[1], "-v") == 0 || strcmp(argv[1], "--version") == 0)) {
         cerr << "Seq2Fun " << SEQ2FUNR_VER << endl;
         return 0;
@@ -69,11 +209,23 @@ int main(int argc, char* argv[]) {
 
     // threading
     cmd.add<int>("thread", 'w', "worker thread number, default is 2", false, 2);
+    cmd.add<string>("numa", 0, "placement of the index on machines with several NUMA nodes: off, interleave (spread its pages over the nodes) or replicate (one copy per node, with each worker thread pinned to a node and searching its copy, which costs memory for each extra node). Default is off", false, "off");
+    cmd.add<int>("concurrent_samples", 0, "number of samples of the --sampletable processed at the same time against the one loaded database, the worker threads are split between them. Default is 1", false, 1);
     cmd.add("verbose", 'V', "enable verbose");
     cmd.add("debug", 0, "enable debug");
     cmd.add("longlog", 0, "enable the long logout format");
     
     cmd.add<int>("reads_buffer", 0, "specify reads buffer size (MB) for each file.", false, 1);
+    cmd.add<int>("pack_queue_depth", 0, "number of packs of 1000 reads the loading thread may queue ahead of the worker threads, more smooths out uneven work at the cost of memory. Default is 80", false, PACK_IN_MEM_LIMIT);
+    cmd.add<int>("readahead", 0, "number of decompressed blocks a dedicated thread keeps ahead of the reads loader for each .gz input file, 0 means decompressing on the loading thread. Default is 4", false, 4);
+    cmd.add("mmap_input", 0, "map uncompressed FASTQ input into memory and let each worker thread parse its own part of it, which skips the loading thread. Useful on fast local disks. Ignored for .gz input, stdin, interleaved input and --reads_to_process");
+    cmd.add("contig_mode", 0, "input files are FASTA files of assembled transcripts or long reads. Each sequence is cut into overlapping windows that are searched like reads, and the s2f id of each window is written to <prefix>_readsMap.txt.gz. Adapter trimming and input evaluation are disabled");
+    cmd.add<int>("contig_window", 0, "window length in bases for --contig_mode. Default is 150", false, 150);
+    cmd.add<int>("contig_step", 0, "distance in bases between the starts of neighbouring windows for --contig_mode. Default is 75", false, 75);
+    cmd.add<int>("io_uring", 0, "read each input file through Linux io_uring with this many 1MB reads in flight, which hides the latency of network storage. Falls back to regular reads where io_uring is not available or can not be set up. At most 32768. Default 0 means disabled", false, 0);
+    cmd.add<int>("decompress_threads", 0, "number of threads decompressing each BGZF-compressed (e.g. bgzip) input file in parallel, plain gzip input always uses one. Needs readahead > 0. Default is 2", false, 2);
+    cmd.add<int>("compress_threads", 0, "number of threads compressing each .gz output of mapped reads and reads maps. With more than 1 the output is written as BGZF (e.g. as bgzip does), which gunzip reads as usual. Default is 2", false, 2);
+    cmd.add<string>("max_memory", 0, "memory the run is planned within, e.g. 16G. The SEG result caches, the pack and writer queues, then the duplication table are made smaller until the database, the index and the buffers fit, and the run stops before loading the index if they can not. Default is no limit", false, "");
     cmd.add("fix_mgi_id", 0, "the MGI FASTQ ID format is not compatible with many BAM operation tools, enable this option to fix it.");
 
     cmd.add("phred64", '6', "indicate the input is using phred64 scoring (it'll be converted to phred33, so the output will still be phred33)");
@@ -180,12 +332,51 @@ int main(int argc, char* argv[]) {
     opt->thread = cmd.get<int>("thread");
     int n_t = std::thread::hardware_concurrency();
     opt->thread = std::min(std::min(opt->thread, 32), n_t);
+    opt->numa = cmd.get<string>("numa");
+    NumaIndex::Mode numaMode;
+    if(!NumaIndex::parseMode(opt->numa, numaMode)) {
+        error_exit("numa should be off, interleave or replicate.");
+    }
+    opt->concurrentSamples = cmd.get<int>("concurrent_samples");
+    if(opt->concurrentSamples < 1) {
+        error_exit("concurrent_samples should be greater or equal to 1.");
+    }
 
     opt->compression = 4;
     opt->readsToProcess = cmd.get<int>("reads_to_process");
     if(cmd.get<int>("reads_buffer") < 1) {
         error_exit("reads_buffer should be greater or equal to 1MB.");
     }
+    opt->packQueueDepth = cmd.get<int>("pack_queue_depth");
+    if(opt->packQueueDepth < 1) {
+        error_exit("pack_queue_depth should be greater or equal to 1.");
+    }
+    opt->readahead = cmd.get<int>("readahead");
+    if(opt->readahead < 0) {
+        error_exit("readahead should be greater or equal to 0.");
+    }
+    opt->mmapInput = cmd.exist("mmap_input");
+    opt->compressThreads = cmd.get<int>("compress_threads");
+    if(opt->compressThreads < 1) {
+        error_exit("compress_threads should be greater or equal to 1.");
+    }
+    if(!cmd.get<string>("max_memory").empty()) {
+        opt->maxMemory = MemoryPlan::parseSize(cmd.get<string>("max_memory"));
+        if(opt->maxMemory == 0) {
+            error_exit("max_memory should be a size like 16G, 4096M or a number of bytes.");
+        }
+    }
+    opt->contigMode = cmd.exist("contig_mode");
+    opt->contigWindow = cmd.get<int>("contig_window");
+    opt->contigStep = cmd.get<int>("contig_step");
+    opt->ioUringDepth = cmd.get<int>("io_uring");
+    if(opt->ioUringDepth < 0 || opt->ioUringDepth > URING_MAX_DEPTH) {
+        error_exit("io_uring should be 0 ~ " + to_string(URING_MAX_DEPTH) + ".");
+    }
+    opt->decompressThreads = cmd.get<int>("decompress_threads");
+    if(opt->decompressThreads < 1) {
+        error_exit("decompress_threads should be greater or equal to 1.");
+    }
     opt->phred64 = cmd.exist("phred64");
     opt->verbose = cmd.exist("verbose");
     opt->debug = cmd.exist("debug");
@@ -193,7 +384,8 @@ int main(int argc, char* argv[]) {
     opt->fixMGI = cmd.exist("fix_mgi_id");
 
     // adapter cutting
-    opt->adapter.enabled = !cmd.exist("disable_adapter_trimming");
+    // windows of contigs carry no adapters
+    opt->adapter.enabled = !cmd.exist("disable_adapter_trimming") && !opt->contigMode;
     opt->adapter.detectAdapterForPE = cmd.exist("detect_adapter_for_pe");
     opt->adapter.sequence = cmd.get<string>("adapter_sequence");
     opt->adapter.sequenceR2 = cmd.get<string>("adapter_sequence_r2");
@@ -444,11 +636,19 @@ int main(int argc, char* argv[]) {
         error_exit("you must select one codon table");
     }
 
+    if (opt->verbose && opt->ioUringDepth > 0 && !UringReader::available()) {
+        string msg = "io_uring is not available on this system, input files are read without it";
+        opt->longlog ? loginfolong(msg) : loginfo(msg);
+    }
+
     if (opt->verbose) {
         std::cout << "Codon table of " << opt->transSearch.tCodonTable << " is selected" << std::endl;
     }
 
     opt->transSearch.misMatches = cmd.get<int>("mismatch");
+    if (opt->transSearch.misMatches > MAX_FRAGMENT_MISMATCHES) {
+        error_exit("number of mismatches (--mismatch) should be 0 ~ " + to_string(MAX_FRAGMENT_MISMATCHES));
+    }
     opt->transSearch.minScore = cmd.get<int>("minscore");
 
     opt->transSearch.maxTransLength = cmd.get<int>("maxtranslength");
@@ -457,6 +657,40 @@ int main(int argc, char* argv[]) {
     opt->transSearch.allFragments = cmd.exist("allFragments");
     opt->transSearch.tfmi = cmd.get<string>("tfmi");
 
+    // I/O
+    opt->mHomoSearchOptions.sampleTable = cmd.get<string>("sampletable");
+    opt->mHomoSearchOptions.prefix = cmd.get<string>("prefix");
+    opt->outputMappedCleanReads = cmd.exist("outputMappedCleanReads");
+    // the per-window hits are the output of contig mode
+    opt->outputReadsAnnoMap = cmd.exist("outputReadsAnnoMap") || opt->contigMode;
+
+    if (opt->mHomoSearchOptions.prefix.empty() && opt->mHomoSearchOptions.sampleTable.empty()) {
+        error_exit("You must specify output file using --prefix or using --sampletable, which contains prefix string");
+    } else if (!opt->mHomoSearchOptions.prefix.empty() && !opt->mHomoSearchOptions.sampleTable.empty()) {
+        error_exit("You must specify output file using either --prefix or --sampletable");
+    }
+
+    if (!opt->mHomoSearchOptions.prefix.empty()) {
+        opt->in1 = cmd.get<string>("in1");
+        opt->in2 = cmd.get<string>("in2");
+    } else {
+        opt->parseSampleTable();
+        if (!opt->samples.empty()) {
+            opt->in1 = opt->samples.front().in1;
+            opt->in2 = opt->samples.front().in2;
+        }
+    }
+
+    // samples processed at the same time each evaluate their own input, on their own copy of the options
+    int concurrent = std::min((int) opt->samples.size(), opt->concurrentSamples);
+    // the first input is sampled for evaluation while the database and the index are loading
+    Evaluator* firstEva = NULL;
+    std::thread* sampler = NULL;
+    if (concurrent <= 1 && !opt->inputFromSTDIN && !opt->contigMode && !opt->in1.empty() && opt->in1 != "/dev/stdin") {
+        firstEva = new Evaluator(opt);
+        sampler = new std::thread(&Evaluator::loadSamples, firstEva);
+    }
+
     //read all database tables, maps;
     opt->readDB();
 
@@ -477,257 +711,90 @@ int main(int argc, char* argv[]) {
         check_file_valid(opt->transSearch.tfmi);
     }
 
-    BwtFmiDB * tbwtfmiDB = new BwtFmiDB(opt);
+    // the database is loaded, so the buffers are planned around it before the index is.
+    // the samples are validated later, but the threads the plan sizes are final from here
+    opt->validateThreads();
+    {
+        MemoryPlan plan(opt, opt->maxMemory);
+        bool fits = plan.fit();
+        if (!fits) {
+            error_exit("max_memory of " + MemoryPlan::formatSize(opt->maxMemory) + " is too small, even the smallest buffers need more: " + plan.describe());
+        }
+        plan.apply(opt);
+        if (opt->maxMemory > 0 || opt->verbose) {
+            opt->longlog ? loginfolong(plan.describe()) : loginfo(plan.describe());
+        }
+    }
 
-    // I/O
-    opt->mHomoSearchOptions.sampleTable = cmd.get<string>("sampletable");
-    opt->mHomoSearchOptions.prefix = cmd.get<string>("prefix");
-    opt->outputMappedCleanReads = cmd.exist("outputMappedCleanReads");
-    opt->outputReadsAnnoMap = cmd.exist("outputReadsAnnoMap");
+    BwtFmiDB * tbwtfmiDB = new BwtFmiDB(opt);
+    if (sampler) {
+        sampler->join();
+        delete sampler;
+        sampler = NULL;
+    }
 
-    if (opt->mHomoSearchOptions.prefix.empty() && opt->mHomoSearchOptions.sampleTable.empty()) {
-        error_exit("You must specify output file using --prefix or using --sampletable, which contains prefix string");
-    } else if (!opt->mHomoSearchOptions.prefix.empty() && !opt->mHomoSearchOptions.sampleTable.empty()) {
-        error_exit("You must specify output file using either --prefix or --sampletable");
+    std::stringstream ss;
+    for (int i = 0; i < argc; i++) {
+        ss << argv[i] << " ";
     }
+    command = ss.str();
+    bool detectTwoColor = !cmd.exist("trim_poly_g") && !cmd.exist("disable_trim_poly_g");
 
     //for single file;
     if (!opt->mHomoSearchOptions.prefix.empty()) {
-        opt->transSearch.startTime = t_begin;
-        opt->in1 = cmd.get<string>("in1");
-        opt->in2 = cmd.get<string>("in2");
-        std::string outFName;
-        opt->htmlFile = opt->mHomoSearchOptions.prefix + "_report.html";
-        opt->jsonFile = opt->mHomoSearchOptions.prefix + "_report.json";
-        if (opt->outputMappedCleanReads) {
-            opt->out1 = opt->mHomoSearchOptions.prefix + "_mapped_R1.fastq.gz";
-            if (opt->isPaired()) opt->out2 = opt->mHomoSearchOptions.prefix + "_mapped_R2.fastq.gz";
-        }
-
-        if (opt->outputReadsAnnoMap) {
-            opt->outReadsKOMap = opt->mHomoSearchOptions.prefix + "_readsMap.txt.gz";
-        }
-
-        stringstream ss;
-        for (int i = 0; i < argc; i++) {
-            ss << argv[i] << " ";
-        }
-//        std::cout << "opt->lengthFilter.requiredLength: " << opt->lengthFilter.requiredLength << "; tmode: " << opt->transSearch.tmode << "; minAAFragLength: " << opt->transSearch.minAAFragLength << "; misMathces: " << opt->transSearch.misMatches << "; minScore: " << opt->transSearch.minScore << "; maxTransLength: " << opt->transSearch.maxTransLength << "\n"; 
-        command = ss.str();
-        opt->mHomoSearchOptions.commandStr = command;
-
-        bool supportEvaluation = !opt->inputFromSTDIN && opt->in1 != "/dev/stdin";
-        Evaluator eva(opt);
-        if (supportEvaluation) {
-            eva.evaluateSeqLen();
-            if (opt->overRepAnalysis.enabled)
-                eva.evaluateOverRepSeqs();
-        }
-
-        long readNum = 0;
-
-        // using evaluator to guess how many reads in total
-        if (opt->shallDetectAdapter(false)) {
-            if (!supportEvaluation)
-                cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
-            else {
-                cerr << "Detecting adapter sequence for read1..." << endl;
-                string adapt = eva.evalAdapterAndReadNum(readNum, false);
-                if (adapt.length() > 60)
-                    adapt.resize(0, 60);
-                if (adapt.length() > 0) {
-                    opt->adapter.sequence = adapt;
-                    opt->adapter.detectedAdapter1 = adapt;
-                } else {
-                    cerr << "No adapter detected for read1" << endl;
-                    opt->adapter.sequence = "";
-                }
-                cerr << endl;
-            }
-        }
-        if (opt->shallDetectAdapter(true)) {
-            if (!supportEvaluation)
-                cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
-            else {
-                cerr << "Detecting adapter sequence for read2..." << endl;
-                string adapt = eva.evalAdapterAndReadNum(readNum, true);
-                if (adapt.length() > 60)
-                    adapt.resize(0, 60);
-                if (adapt.length() > 0) {
-                    opt->adapter.sequenceR2 = adapt;
-                    opt->adapter.detectedAdapter2 = adapt;
-                } else {
-                    cerr << "No adapter detected for read2" << endl;
-                    opt->adapter.sequenceR2 = "";
-                }
-                cerr << endl;
-            }
-        }
-
-        opt->validate();
-
-        // using evaluator to guess how many reads in total
-        if (opt->split.needEvaluation && supportEvaluation) {
-            // if readNum is not 0, means it is already evaluated by other functions
-            if (readNum == 0) {
-                eva.evaluateReadNum(readNum);
-            }
-            opt->split.size = readNum / opt->split.number;
-            // one record per file at least
-            if (opt->split.size <= 0) {
-                opt->split.size = 1;
-                cerr << "WARNING: the input file has less reads than the number of files to split" << endl;
-            }
-        }
-
-        // using evaluator to check if it's two color system
-        if (!cmd.exist("trim_poly_g") && !cmd.exist("disable_trim_poly_g") && supportEvaluation) {
-            bool twoColorSystem = eva.isTwoColorSystem();
-            if (twoColorSystem) {
-                opt->polyGTrim.enabled = true;
-            }
-        }
-
-        Processor p(opt);
-        p.process(tbwtfmiDB);
-
-        cerr << endl << command << endl;
-        cerr << endl << "Seq2Fun v" << SEQ2FUNR_VER << ", time used: " << convertSeconds(opt->transSearch.timeLapse) << ", mapped " <<
-                opt->transSearch.nTransMappedIdReads << " reads out of " <<
-                opt->mHomoSearchOptions.nTotalReads << " (" <<
-                getPercentage(long(opt->transSearch.nTransMappedIdReads), opt->mHomoSearchOptions.nTotalReads) << " %), " <<
-                "mapped " << opt->transSearch.nTransMappedIds << " S2f ids out of " <<
-                opt->transSearch.nIdDB << " S2f ids (" <<
-                getPercentage(opt->transSearch.nTransMappedIds, opt->transSearch.nIdDB) <<
-                " %), " << "mapped " << opt->transSearch.nMappedCoreOrthos << " core orthologs out of " << 
-                opt->transSearch.coreOrthosDb << getPercentage(opt->transSearch.nMappedCoreOrthos, opt->transSearch.coreOrthosDb) <<
-                " %)" << endl << endl;
-        
+        Sample sample;
+        sample.prefix = opt->mHomoSearchOptions.prefix;
+        sample.in1 = opt->in1;
+        sample.in2 = opt->in2;
+        // the time of a single sample includes loading the database
+        processSample(opt, sample, 1, 1, firstEva, detectTwoColor, tbwtfmiDB, t_begin);
+        firstEva = NULL;
         opt->transSearch.reset2Default();
         opt->mHomoSearchOptions.reset2Default();
     } else {
-        opt->parseSampleTable();
-        int count = 0;
-        for (const auto & it : opt->samples) {
-            time_t t_cycleBegin = time(NULL);
-            opt->transSearch.startTime = t_cycleBegin;
-            count++;
-            std::stringstream msgSS;
-            msgSS << "processing sample: " << it.prefix << ", " << count << " out of " << opt->samples.size() << " samples" << "\n";
-            opt->longlog ? loginfolong( msgSS.str()) : loginfo(msgSS.str());
-            opt->mHomoSearchOptions.prefix = it.prefix;
-            opt->in1 = it.in1;
-            opt->in2 = it.in2;
-            opt->htmlFile = it.prefix + "_report.html";
-            opt->jsonFile = it.prefix + "_report.json";
-
-            if (opt->outputMappedCleanReads) {
-                opt->out1 = it.prefix + "_mapped_R1.fastq.gz";
-                if (opt->isPaired()) opt->out2 = it.prefix + "_mapped_R2.fastq.gz";
-            }
-
-            if (opt->outputReadsAnnoMap) {
-                opt->outReadsKOMap = opt->mHomoSearchOptions.prefix + "_readsMap.txt.gz";
-            }
-
-            std::stringstream ss;
-            for (int i = 0; i < argc; i++) {
-                ss << argv[i] << " ";
-            }
-            
-            //ss << "opt->lengthFilter.requiredLength: " << opt->lengthFilter.requiredLength << "; tmode: " << opt->transSearch.tmode << "; minAAFragLength: " << opt->transSearch.minAAFragLength << "; misMathces: " << opt->transSearch.misMatches << "; minScore: " << opt->transSearch.minScore << "; maxTransLength: " << opt->transSearch.maxTransLength << " "; 
-            
-            command = ss.str();
-            opt->mHomoSearchOptions.commandStr = command;
-
-            bool supportEvaluation = !opt->inputFromSTDIN && opt->in1 != "/dev/stdin";
-            Evaluator eva(opt);
-            if (supportEvaluation) {
-                eva.evaluateSeqLen();
-                if (opt->overRepAnalysis.enabled)
-                    eva.evaluateOverRepSeqs();
+        if (concurrent <= 1) {
+            for (size_t i = 0; i < opt->samples.size(); i++) {
+                processSample(opt, opt->samples[i], i + 1, opt->samples.size(), firstEva, detectTwoColor, tbwtfmiDB, time(NULL));
+                firstEva = NULL;
+                opt->transSearch.reset2Default();
+                opt->mHomoSearchOptions.reset2Default();
             }
-
-            long readNum = 0;
-
-            // using evaluator to guess how many reads in total
-            if (opt->shallDetectAdapter(false)) {
-                if (!supportEvaluation)
-                    cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
-                else {
-                    cerr << "Detecting adapter sequence for read1..." << endl;
-                    string adapt = eva.evalAdapterAndReadNum(readNum, false);
-                    if (adapt.length() > 60)
-                        adapt.resize(0, 60);
-                    if (adapt.length() > 0) {
-                        opt->adapter.sequence = adapt;
-                        opt->adapter.detectedAdapter1 = adapt;
-                    } else {
-                        cerr << "No adapter detected for read1" << endl;
-                        opt->adapter.sequence = "";
-                    }
-                    cerr << endl;
-                }
-            }
-            if (opt->shallDetectAdapter(true)) {
-                if (!supportEvaluation)
-                    cerr << "Adapter auto-detection is disabled for STDIN mode" << endl;
-                else {
-                    cerr << "Detecting adapter sequence for read2..." << endl;
-                    string adapt = eva.evalAdapterAndReadNum(readNum, true);
-                    if (adapt.length() > 60)
-                        adapt.resize(0, 60);
-                    if (adapt.length() > 0) {
-                        opt->adapter.sequenceR2 = adapt;
-                        opt->adapter.detectedAdapter2 = adapt;
-                    } else {
-                        cerr << "No adapter detected for read2" << endl;
-                        opt->adapter.sequenceR2 = "";
+        } else {
+            // every sample runs on its own copy of the options, with its own results and its share of the threads,
+            // of the (de)compression threads and of the readahead blocks.
+            // the copies share the tables read from the database and tbwtfmiDB, which are only read from now on
+            std::vector<Sample> results(opt->samples.size());
+            std::atomic<size_t> next(0);
+            std::vector<std::thread*> runners;
+            auto share = [concurrent](int total, int r, int least) {
+                return std::max(least, total / concurrent + (r < total % concurrent ? 1 : 0));
+            };
+            for (int r = 0; r < concurrent; r++) {
+                int threads = share(opt->thread, r, 1);
+                int compressThreads = share(opt->compressThreads, r, 1);
+                int decompressThreads = share(opt->decompressThreads, r, 1);
+                // a runner keeps its decompression thread if the readahead is on at all
+                int readahead = share(opt->readahead, r, std::min(1, opt->readahead));
+                runners.push_back(new std::thread([&, threads, compressThreads, decompressThreads, readahead] {
+                    size_t i;
+                    while ((i = next++) < results.size()) {
+                        Options* sampleOpt = new Options(*opt);
+                        sampleOpt->samples.assign(1, opt->samples[i]);
+                        sampleOpt->thread = threads;
+                        sampleOpt->compressThreads = compressThreads;
+                        sampleOpt->decompressThreads = decompressThreads;
+                        sampleOpt->readahead = readahead;
+                        processSample(sampleOpt, sampleOpt->samples.front(), i + 1, results.size(), NULL, detectTwoColor, tbwtfmiDB, time(NULL));
+                        results[i] = sampleOpt->samples.front();
+                        delete sampleOpt;
                     }
-                    cerr << endl;
-                }
+                }));
             }
-
-            opt->validate();
-
-            // using evaluator to guess how many reads in total
-            if (opt->split.needEvaluation && supportEvaluation) {
-                // if readNum is not 0, means it is already evaluated by other functions
-                if (readNum == 0) {
-                    eva.evaluateReadNum(readNum);
-                }
-                opt->split.size = readNum / opt->split.number;
-                // one record per file at least
-                if (opt->split.size <= 0) {
-                    opt->split.size = 1;
-                    cerr << "WARNING: the input file has less reads than the number of files to split" << endl;
-                }
-            }
-
-            // using evaluator to check if it's two color system
-            if (!cmd.exist("trim_poly_g") && !cmd.exist("disable_trim_poly_g") && supportEvaluation) {
-                bool twoColorSystem = eva.isTwoColorSystem();
-                if (twoColorSystem) {
-                    opt->polyGTrim.enabled = true;
-                }
+            for (int r = 0; r < concurrent; r++) {
+                runners[r]->join();
+                delete runners[r];
             }
-            
-            Processor p(opt);
-            p.process(tbwtfmiDB);
-            cerr << endl << command << endl;
-            cerr << endl << "Seq2Fun v" << SEQ2FUNR_VER << ", time used: " << convertSeconds(opt->transSearch.timeLapse) <<
-                    ", mapped " << opt->transSearch.nTransMappedIdReads << " reads out of " <<
-                    opt->mHomoSearchOptions.nTotalReads << " (" <<
-                    getPercentage(long(opt->transSearch.nTransMappedIdReads), opt->mHomoSearchOptions.nTotalReads) << " %), " <<
-                    "mapped " << opt->transSearch.nTransMappedIds << " S2f ids out of " <<
-                    opt->transSearch.nIdDB << " S2f ids (" <<
-                    getPercentage(opt->transSearch.nTransMappedIds, opt->transSearch.nIdDB) <<
-                    " %), " << "mapped " << opt->transSearch.nMappedCoreOrthos << " core orthologs out of " <<
-                    opt->transSearch.coreOrthosDb << " orthologs (" << getPercentage(opt->transSearch.nMappedCoreOrthos, opt->transSearch.coreOrthosDb) <<
-                    " %)" << endl << endl;
-            opt->transSearch.reset2Default();
-            opt->mHomoSearchOptions.reset2Default();
-            
+            opt->samples = results;
         }
 
         HtmlReporterAll hra(opt);
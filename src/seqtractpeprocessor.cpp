@@ -6,20 +6,17 @@
 #include <memory.h>
 
 
-SeqTractPeProcessor::SeqTractPeProcessor(Options * opt) {
+SeqTractPeProcessor::SeqTractPeProcessor(Options * opt) : mRepo(opt->packQueueDepth * PACK_SIZE) {
     mOptions = opt;
-    mProduceFinished = false;
     mSampleSize = mOptions->mSeqExtractions.targetGenesSubVec.size();
     featureUSet.clear();
 }
 
 SeqTractPeProcessor::~SeqTractPeProcessor() {
-    destroyPackRepository();
 }
 
 bool SeqTractPeProcessor::process(){
 
-    initPackRepository();
     std::thread producer(std::bind(&SeqTractPeProcessor::producerTask, this));
 
     int threadnum = mSampleSize + 1;
@@ -116,62 +113,7 @@ bool SeqTractPeProcessor::processReads(ReadPack* pack){
     return true;
 }
 
-void SeqTractPeProcessor::initPackRepository() {
-    mRepo.packBuffer = new ReadPack*[PACK_NUM_LIMIT];
-    memset(mRepo.packBuffer, 0, sizeof(ReadPack*)*PACK_NUM_LIMIT);
-    mRepo.writePos = 0;
-    mRepo.readPos = 0;
-    mRepo.readCounter = 0;
-    
-}
-
-void SeqTractPeProcessor::destroyPackRepository() {
-    if(mRepo.packBuffer) delete mRepo.packBuffer; mRepo.packBuffer = NULL;
-}
-
-void SeqTractPeProcessor::producePack(ReadPack* pack){
-    std::unique_lock<std::mutex> lock(mRepo.mtx);
-    while(((mRepo.writePos + 1) % PACK_NUM_LIMIT) == mRepo.readPos) {
-        mRepo.repoNotFull.wait(lock);
-    }
-
-    mRepo.packBuffer[mRepo.writePos] = pack;
-    mRepo.writePos++;
-
-    if (mRepo.writePos == PACK_NUM_LIMIT)
-        mRepo.writePos = 0;
-
-    mRepo.repoNotEmpty.notify_all();
-    lock.unlock();
-}
-
-void SeqTractPeProcessor::consumePack(){
-    ReadPack* data;
-    std::unique_lock<std::mutex> lock(mRepo.mtx);
-    // read buffer is empty, just wait here.
-    while(mRepo.writePos == mRepo.readPos) {
-        if(mProduceFinished){
-            lock.unlock();
-            return;
-        }
-        mRepo.repoNotEmpty.wait(lock);
-    }
-
-    data = mRepo.packBuffer[mRepo.readPos];
-    (mRepo.readPos)++;
-    lock.unlock();
-
-    processReads(data);
-
-
-    if (mRepo.readPos >= PACK_NUM_LIMIT)
-        mRepo.readPos = 0;
-
-    mRepo.repoNotFull.notify_all();
-}
-
 void SeqTractPeProcessor::producerTask(){
-    int slept = 0;
     long readNum = 0;
     bool splitSizeReEvaluated = false;
     Read** data = nullptr;
@@ -191,7 +133,7 @@ void SeqTractPeProcessor::producerTask(){
                 ReadPack* pack = new ReadPack;
                 pack->data = data;
                 pack->count = count;
-                producePack(pack);
+                mRepo.push(pack);
                 data = NULL;
                 break;
             }
@@ -202,18 +144,13 @@ void SeqTractPeProcessor::producerTask(){
                 ReadPack* pack = new ReadPack;
                 pack->data = data;
                 pack->count = count;
-                producePack(pack);
+                // waits while the consumer is far behind to limit memory usage
+                mRepo.push(pack);
                 //re-initialize data for next pack
                 data = new Read*[PACK_SIZE];
                 memset(data, 0, sizeof (Read*) * PACK_SIZE);
                 // reset count to 0
                 count = 0;
-                // if the consumer is far behind this producer, sleep and wait to limit memory usage
-                while (mRepo.writePos - mRepo.readPos > PACK_IN_MEM_LIMIT) {
-                    //cout<<"sleep"<<endl;
-                    slept++;
-                    usleep(100);
-                }
                 readNum += PACK_SIZE;
                 if (mOptions->verbose) {
                     if (readNum > 100000 && readNum % 100000 == 0) {
@@ -228,9 +165,7 @@ void SeqTractPeProcessor::producerTask(){
         }
     }
 
-    std::unique_lock<std::mutex> lock(mRepo.readCounterMtx);
-    mProduceFinished = true;
-    lock.unlock();
+    mRepo.close();
 
     // if the last data initialized is not used, free it
     if(data != NULL)
@@ -238,19 +173,9 @@ void SeqTractPeProcessor::producerTask(){
 }
 
 void SeqTractPeProcessor::consumerTask(){
-    while(true) {
-        std::unique_lock<std::mutex> lock(mRepo.readCounterMtx);
-        if(mProduceFinished && mRepo.writePos == mRepo.readPos){
-            lock.unlock();
-            break;
-        }
-        if(mProduceFinished){
-            consumePack();
-            lock.unlock();
-        } else {
-            lock.unlock();
-            consumePack();
-        }
+    // pop() returns NULL once the producer closed the queue and it is drained
+    while(ReadPack* pack = mRepo.pop()) {
+        processReads(pack);
     }
     // notify all writer threads
     for(int i=0; i<mSampleSize+1; i++) {
@@ -13,6 +13,7 @@
 #include "threadsconfig2.h"
 #include "read.h"
 #include "util.h"
+#include "packqueue.h"
 
 
 using namespace std;
@@ -23,17 +24,6 @@ struct ReadPack{
 };
 typedef struct ReadPack ReadPack;
 
-struct ReadRepository{
-    ReadPack** packBuffer;
-    size_t readPos;
-    size_t writePos;
-    size_t readCounter;
-    std::mutex mtx;
-    std::mutex readCounterMtx;
-    std::condition_variable repoNotFull;
-    std::condition_variable repoNotEmpty;
-};
-typedef struct ReadPairRepository ReadPairRepository;
 
 
 class SeqTractPeProcessor {
@@ -44,18 +34,13 @@ public:
     
 private:
     bool processReads(ReadPack* pack);
-    void initPackRepository();
-    void destroyPackRepository();
-    void producePack(ReadPack* pack);
-    void consumePack();
     void producerTask();
     void consumerTask();
     void writeTask(ThreadsConfig2* config);
     
 private:
     Options* mOptions;
-    ReadRepository mRepo;
-    bool mProduceFinished;
+    PackQueue<ReadPack> mRepo;
     ThreadsConfig2** mConfigs;
     int mSampleSize;
     std::unordered_set<std::string> featureUSet;
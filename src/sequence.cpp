@@ -4,7 +4,7 @@ Sequence::Sequence(){
 }
 
 Sequence::Sequence(string seq){
-    mStr = seq;
+    mStr = std::move(seq);
 }
 
 void Sequence::print(){
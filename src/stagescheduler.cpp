@@ -0,0 +1,256 @@
+#include "stagescheduler.h"
+#include <sstream>
+#include <thread>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+StageScheduler::StageScheduler(int workers) {
+    for (int i = 0; i < workers; i++) {
+        Worker* w = new Worker;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            w->busy[s] = 0;
+            w->ran[s] = 0;
+        }
+        w->stolen = 0;
+        w->idle = 0;
+        w->seconds = 0;
+        w->node = 0;
+        w->reads = 0;
+        mWorkers.push_back(w);
+    }
+    mPending = 0;
+    mOpenSources = workers;
+    mSignals = 0;
+}
+
+StageScheduler::~StageScheduler() {
+    for (size_t i = 0; i < mWorkers.size(); i++)
+        delete mWorkers[i];
+    mWorkers.clear();
+}
+
+const char* StageScheduler::stageName(int stage) {
+    static const char* names[STAGE_COUNT] = {"load", "qc", "search", "output"};
+    return names[stage];
+}
+
+void StageScheduler::setNode(int worker, int node) {
+    mWorkers[worker]->node = node;
+}
+
+void StageScheduler::submit(int worker, PackStage stage, Task task) {
+    mPending++;
+    Worker* w = mWorkers[worker];
+    {
+        std::lock_guard<std::mutex> lock(w->mtx);
+        w->tasks.push_back(Item{stage, task});
+    }
+    signal(false);
+}
+
+// all waiting workers, as each of them has to see the end of the input to close its source
+void StageScheduler::wake() {
+    signal(true);
+}
+
+void StageScheduler::signal(bool all) {
+    {
+        std::lock_guard<std::mutex> lock(mIdleMtx);
+        mSignals++;
+    }
+    if (all)
+        mIdle.notify_all();
+    else
+        mIdle.notify_one();
+}
+
+// the newest task of the worker itself, whose pack is likely still in its cache, or the oldest of another worker
+bool StageScheduler::take(int worker, Item& item, bool& stolen) {
+    Worker* own = mWorkers[worker];
+    {
+        std::lock_guard<std::mutex> lock(own->mtx);
+        if (!own->tasks.empty()) {
+            item = own->tasks.back();
+            own->tasks.pop_back();
+            stolen = false;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < mWorkers.size(); i++) {
+        Worker* victim = mWorkers[(worker + i) % mWorkers.size()];
+        std::lock_guard<std::mutex> lock(victim->mtx);
+        if (!victim->tasks.empty()) {
+            item = victim->tasks.front();
+            victim->tasks.pop_front();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void StageScheduler::run(int worker, Source source) {
+    Worker* w = mWorkers[worker];
+    auto begin = std::chrono::steady_clock::now();
+    bool sourceOpen = true;
+    while (true) {
+        long seen = mSignals;
+        Item item;
+        bool stolen = false;
+        if (take(worker, item, stolen)) {
+            auto start = std::chrono::steady_clock::now();
+            item.task(worker);
+            w->busy[item.stage] += secondsSince(start);
+            w->ran[item.stage]++;
+            if (stolen)
+                w->stolen++;
+            // follow-up tasks were submitted by the task itself, so zero means all packs are done
+            if (--mPending == 0)
+                signal(true);
+            continue;
+        }
+        if (sourceOpen) {
+            auto start = std::chrono::steady_clock::now();
+            SourceResult result = source(worker);
+            if (result == SOURCE_PACK) {
+                w->busy[STAGE_LOAD] += secondsSince(start);
+                w->ran[STAGE_LOAD]++;
+                continue;
+            }
+            w->idle += secondsSince(start);
+            if (result == SOURCE_DONE) {
+                sourceOpen = false;
+                if (--mOpenSources == 0)
+                    signal(true);
+                continue;
+            }
+        }
+        // no pack is ready, or the input is used up but other workers may still queue tasks to steal
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(mIdleMtx);
+            mIdle.wait(lock, [this, seen] {return mSignals != seen || (mOpenSources == 0 && mPending == 0);});
+            if (mOpenSources == 0 && mPending == 0)
+                break;
+        }
+        w->idle += secondsSince(start);
+    }
+    w->seconds = secondsSince(begin);
+}
+
+void StageScheduler::reportJson(ofstream& ofs, string padding) {
+    double total = 0, idle = 0;
+    double busy[STAGE_COUNT] = {0};
+    long ran[STAGE_COUNT] = {0};
+    long stolen = 0;
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        total += mWorkers[i]->seconds;
+        idle += mWorkers[i]->idle;
+        stolen += mWorkers[i]->stolen;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            busy[s] += mWorkers[i]->busy[s];
+            ran[s] += mWorkers[i]->ran[s];
+        }
+    }
+    ofs << "{" << endl;
+    ofs << padding << "\t" << "\"worker_threads\": " << mWorkers.size() << "," << endl;
+    ofs << padding << "\t" << "\"worker_seconds\": " << total << "," << endl;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        ofs << padding << "\t" << "\"" << stageName(s) << "\": {";
+        ofs << "\"tasks\": " << ran[s] << ", ";
+        ofs << "\"seconds\": " << busy[s] << ", ";
+        ofs << "\"occupancy\": " << (total > 0 ? busy[s] / total : 0.0) << "}," << endl;
+    }
+    ofs << padding << "\t" << "\"idle\": {\"seconds\": " << idle << ", \"occupancy\": " << (total > 0 ? idle / total : 0.0) << "}," << endl;
+    // reads searched per second of the workers on each node
+    int nodes = 0;
+    for (size_t i = 0; i < mWorkers.size(); i++)
+        nodes = max(nodes, mWorkers[i]->node + 1);
+    ofs << padding << "\t" << "\"numa_nodes\": [";
+    for (int n = 0; n < nodes; n++) {
+        int workers = 0;
+        long reads = 0;
+        double seconds = 0;
+        for (size_t i = 0; i < mWorkers.size(); i++) {
+            if (mWorkers[i]->node != n)
+                continue;
+            workers++;
+            reads += mWorkers[i]->reads;
+            seconds = max(seconds, mWorkers[i]->seconds);
+        }
+        ofs << (n > 0 ? ", " : "") << "{\"node\": " << n << ", \"workers\": " << workers << ", \"reads\": " << reads;
+        ofs << ", \"reads_per_second\": " << (seconds > 0 ? reads / seconds : 0.0) << "}";
+    }
+    ofs << "]," << endl;
+    ofs << padding << "\t" << "\"stolen_tasks\": " << stolen << endl;
+    ofs << padding << "}," << endl;
+}
+
+string StageScheduler::summary() {
+    double total = 0, idle = 0;
+    double busy[STAGE_COUNT] = {0};
+    long ran = 0, stolen = 0;
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        total += mWorkers[i]->seconds;
+        idle += mWorkers[i]->idle;
+        stolen += mWorkers[i]->stolen;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            busy[s] += mWorkers[i]->busy[s];
+            if (s != STAGE_LOAD)
+                ran += mWorkers[i]->ran[s];
+        }
+    }
+    std::stringstream ss;
+    ss.precision(3);
+    ss << "worker time:";
+    for (int s = 0; s < STAGE_COUNT; s++)
+        ss << " " << stageName(s) << " " << (total > 0 ? busy[s] * 100 / total : 0.0) << "%,";
+    ss << " idle " << (total > 0 ? idle * 100 / total : 0.0) << "%, " << stolen << " of " << ran << " tasks stolen";
+    return ss.str();
+}
+
+bool StageScheduler::test() {
+    // only worker 0 gets packs, the other workers have to steal their stages to take part.
+    // the packs become ready one by one on a feeding thread, so worker 0 also waits for input
+    const int workers = 4, packs = 20, searches = 4;
+    StageScheduler scheduler(workers);
+    atomic<int> ready(0), loaded(0), searched(0), written(0);
+    vector<atomic<int>*> pending;
+    for (int p = 0; p < packs; p++)
+        pending.push_back(new atomic<int>(searches));
+    StageScheduler* sched = &scheduler;
+    Source source = [&](int w) -> SourceResult {
+        if (w != 0 || loaded == packs)
+            return SOURCE_DONE;
+        if (loaded == ready)
+            return SOURCE_WAIT;
+        int pack = loaded++;
+        sched->submit(w, STAGE_QC, [&, pack](int qw) {
+            for (int s = 0; s < searches; s++) {
+                sched->submit(qw, STAGE_SEARCH, [&, pack](int sw) {
+                    searched++;
+                    if (--(*pending[pack]) == 0)
+                        sched->submit(sw, STAGE_OUTPUT, [&](int) {written++;});
+                });
+            }
+        });
+        return SOURCE_PACK;
+    };
+    vector<std::thread*> threads;
+    for (int w = 0; w < workers; w++)
+        threads.push_back(new std::thread([&, w] {sched->run(w, source);}));
+    for (int p = 0; p < packs; p++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        ready++;
+        sched->wake();
+    }
+    for (int w = 0; w < workers; w++) {
+        threads[w]->join();
+        delete threads[w];
+    }
+    for (int p = 0; p < packs; p++)
+        delete pending[p];
+    return loaded == packs && searched == packs * searches && written == packs && scheduler.mPending == 0;
+}
@@ -0,0 +1,100 @@
+#ifndef STAGE_SCHEDULER_H
+#define STAGE_SCHEDULER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+using namespace std;
+
+// the stages a pack of reads goes through on the worker threads.
+// STAGE_LOAD is the time spent getting a new pack, i.e. waiting for the loading thread or parsing a mapped range
+enum PackStage {
+    STAGE_LOAD = 0,
+    STAGE_QC,
+    STAGE_SEARCH,
+    STAGE_OUTPUT,
+    STAGE_COUNT
+};
+
+// what a source did when a worker asked it for a pack
+enum SourceResult {
+    SOURCE_PACK = 0,
+    SOURCE_WAIT,
+    SOURCE_DONE
+};
+
+// runs the stages of the packs as tasks on the worker threads.
+// every worker keeps a deque of tasks, it pushes the follow-up tasks of what it runs to the back
+// and continues with the newest one, idle workers steal the oldest tasks of the others.
+// a worker asks its source for a new pack only when there is nothing to run or to steal,
+// and sleeps until a task is submitted or wake() is called when neither has anything for it
+class StageScheduler {
+public:
+    // a task gets the index of the worker running it, to use that worker's ThreadConfig
+    typedef std::function<void(int)> Task;
+    // queues the first task of a new pack on the worker, or tells that no pack is ready yet or the input is used up.
+    // a source must not block, the worker steals tasks while it waits
+    typedef std::function<SourceResult(int)> Source;
+
+    StageScheduler(int workers);
+    ~StageScheduler();
+
+    void submit(int worker, PackStage stage, Task task);
+    // called by whoever feeds the sources when a pack became ready or the input ended
+    void wake();
+    // the NUMA node the worker is pinned to, for the throughput per node
+    void setNode(int worker, int node);
+    // called by a task for the reads it searched on this worker
+    inline void addReads(int worker, long reads) {mWorkers[worker]->reads += reads;}
+    // runs tasks on the calling thread as worker until all sources are used up and no task is left
+    void run(int worker, Source source);
+
+    // worker time spent in each stage, as a share of the time the workers ran
+    void reportJson(ofstream& ofs, string padding);
+    string summary();
+
+    static const char* stageName(int stage);
+    static bool test();
+
+private:
+    struct Item {
+        PackStage stage;
+        Task task;
+    };
+    struct Worker {
+        std::deque<Item> tasks;
+        std::mutex mtx;
+        double busy[STAGE_COUNT];
+        long ran[STAGE_COUNT];
+        long stolen;
+        double idle;
+        double seconds;
+        int node;
+        long reads;
+    };
+
+    bool take(int worker, Item& item, bool& stolen);
+    void signal(bool all);
+
+private:
+    vector<Worker*> mWorkers;
+    // tasks submitted but not finished, and workers whose source may still give packs
+    atomic<long> mPending;
+    atomic<int> mOpenSources;
+    // bumped under mIdleMtx whenever there may be new work, a worker waits until it changed
+    // since it last looked for work, so nothing published in between is missed
+    atomic<long> mSignals;
+    std::mutex mIdleMtx;
+    std::condition_variable mIdle;
+};
+
+#endif
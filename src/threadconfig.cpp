@@ -21,7 +21,7 @@ ThreadConfig::ThreadConfig(Options* & opt, BwtFmiDB* & tbwtfmiDB, int threadId,
     mFilterResult = new FilterResult(opt, paired);
     mCanBeStopped = false;
     //mBwtfmiDB = tbwtfmiDB;
-    mTransSearcher = new TransSearcher(mOptions, tbwtfmiDB);
+    mTransSearcher = new TransSearcher(mOptions, tbwtfmiDB, threadId);
 }
 
 ThreadConfig::~ThreadConfig() {
@@ -2,12 +2,19 @@
 
 #include "transsearcher.hpp"
 
-TransSearcher::TransSearcher(Options * & opt, BwtFmiDB * & mBwtfmiDB) {
+TransSearcher::TransSearcher(Options * & opt, BwtFmiDB * & mBwtfmiDB, int worker) {
     mOptions = opt;
     tbwtfmiDB = mBwtfmiDB;
+    tfmi = tbwtfmiDB->tnuma->fmiOfWorker(worker);
+    tsa = tbwtfmiDB->tnuma->suffixesOfWorker(worker);
     //matched_genids.clear();
-    idFreqSubMap.clear();
-    tmpIdFreqMap.clear();
+    idFreqSubVec.assign(mOptions->db->orthIdVec.size(), 0);
+    readVotes.assign(mOptions->db->orthIdVec.size(), 0);
+    votedIds.reserve(256);
+    matchSeqs.reserve(256);
+    seenSeqs.assign((tsa->nseq + 63) / 64, 0);
+    matchSI.reserve(64);
+    best_matches_SI.reserve(64);
     blosum_subst = {
         {'A',
             {'S', 'V', 'T', 'G', 'C', 'P', 'M', 'K', 'L', 'I', 'E', 'Q', 'R', 'Y', 'F', 'H', 'D', 'N', 'W'}},
@@ -709,6 +716,43 @@ TransSearcher::TransSearcher(Options * & opt, BwtFmiDB * & mBwtfmiDB) {
     for (unsigned int i = 0; i <= 5; i++) {
         translations[i].reserve(5000);
     }
+
+    if (mOptions->transSearch.SEG) {
+        // pre-screen for SEG, see mayBeLowComplexity
+        segWindow = (size_t) tbwtfmiDB->tblast_seg_params->window;
+        segCLogC.resize(segWindow + 1, 0);
+        for (size_t c = 1; c <= segWindow; c++) {
+            segCLogC[c] = c * log2((double) c);
+        }
+        // small tolerance on the safe side against rounding in the sliding sum
+        segTrigger = segWindow * (log2((double) segWindow) - tbwtfmiDB->tblast_seg_params->locut) - 1e-6;
+    }
+}
+
+TransSearcher::~TransSearcher() {
+    clearFragments();
+    for (auto it : fragmentSeqs) {
+        delete it;
+    }
+    fragmentSeqs.clear();
+}
+
+FragmentSeq *TransSearcher::newFragmentSeq(const std::string &s) {
+    if (nFragmentSeqs == fragmentSeqs.size()) {
+        fragmentSeqs.push_back(new FragmentSeq());
+    }
+    FragmentSeq *fs = fragmentSeqs[nFragmentSeqs++];
+    fs->assign(s);
+    return fs;
+}
+
+FragmentSeq *TransSearcher::newFragmentSeq(const std::string &s, size_t start, size_t len) {
+    if (nFragmentSeqs == fragmentSeqs.size()) {
+        fragmentSeqs.push_back(new FragmentSeq());
+    }
+    FragmentSeq *fs = fragmentSeqs[nFragmentSeqs++];
+    fs->assign(s, start, len);
+    return fs;
 }
 
 Fragment *TransSearcher::getNextFragment(unsigned int min_score) {
@@ -723,48 +767,54 @@ Fragment *TransSearcher::getNextFragment(unsigned int min_score) {
     }
     Fragment *f = it->second;
     if (mOptions->debug)
-        std::cerr << "Fragment = " << f->seq << "\n";
+        std::cerr << "Fragment = " << f->base->seq << "\n";
     fragments.erase(it);
 
     while (mOptions->transSearch.SEG && f != NULL && !f->SEGchecked) {
-        std::string convertedseq = f->seq;
-        for (size_t i = 0; i < convertedseq.length(); i++) {
-            convertedseq[i] = AMINOACID_TO_NCBISTDAA[(int) convertedseq[i]];
+        const std::string & fseq = f->base->seq;
+        if (!mayBeLowComplexity(fseq)) { // no window of fseq can trigger SEG
+            return f;
         }
-        BlastSeqLoc *seg_locs = NULL;
-        SeqBufferSeg((Uint1 *) (convertedseq.data()), (Int4) convertedseq.length(), 0, tbwtfmiDB->tblast_seg_params, &seg_locs);
-        if (seg_locs) { // SEG found region(s)
-            BlastSeqLoc *curr_loc = seg_locs;
+        const std::vector<std::pair<size_t, size_t> > & seg_regions = getSEGRegions(fseq);
+        if (!seg_regions.empty()) { // SEG found region(s)
             size_t start = 0; //start of non-SEGged piece
-            do {
-                size_t length = curr_loc->ssr->left - start;
+            for (const auto & region : seg_regions) {
+                size_t length = region.first - start;
                 if (mOptions->debug)
-                    std::cerr << "SEG region: " << curr_loc->ssr->left << " - " << curr_loc->ssr->right << " = " << f->seq.substr(curr_loc->ssr->left, curr_loc->ssr->right - curr_loc->ssr->left + 1) << std::endl;
+                    std::cerr << "SEG region: " << region.first << " - " << region.second << " = " << fseq.substr(region.first, region.second - region.first + 1) << std::endl;
                 if (length > mOptions->transSearch.minAAFragLength) {
+                    // pieces that can not reach min_score would never be searched
                     if (mOptions->transSearch.mode == tGREEDY) {
-                        unsigned int score = calcScore(f->seq, start, length, 0);
-                        if (score >= mOptions->transSearch.minScore) {
-                            fragments.emplace(score, new Fragment(f->seq.substr(start, length), true));
+                        unsigned int score = calcScore(fseq, start, length, 0);
+                        if (score >= mOptions->transSearch.minScore && score >= min_score) {
+                            fragments.emplace(score, new Fragment(newFragmentSeq(fseq, start, length), true));
+                        } else {
+                            nPrunedFragments++;
                         }
+                    } else if (length >= min_score) {
+                        fragments.emplace(length, new Fragment(newFragmentSeq(fseq, start, length), true));
                     } else {
-                        fragments.emplace(length, new Fragment(f->seq.substr(start, length), true));
+                        nPrunedFragments++;
                     }
                 }
-                start = curr_loc->ssr->right + 1;
-            } while ((curr_loc = curr_loc->next) != NULL);
-            size_t len_last_piece = f->seq.length() - start;
+                start = region.second + 1;
+            }
+            size_t len_last_piece = fseq.length() - start;
             if (len_last_piece > mOptions->transSearch.minAAFragLength) {
                 if (mOptions->transSearch.mode == tGREEDY) {
-                    unsigned int score = calcScore(f->seq, start, len_last_piece, 0);
-                    if (score >= mOptions->transSearch.minScore) {
-                        fragments.emplace(score, new Fragment(f->seq.substr(start, len_last_piece), true));
+                    unsigned int score = calcScore(fseq, start, len_last_piece, 0);
+                    if (score >= mOptions->transSearch.minScore && score >= min_score) {
+                        fragments.emplace(score, new Fragment(newFragmentSeq(fseq, start, len_last_piece), true));
+                    } else {
+                        nPrunedFragments++;
                     }
+                } else if (len_last_piece >= min_score) {
+                    fragments.emplace(len_last_piece, new Fragment(newFragmentSeq(fseq, start, len_last_piece), true));
                 } else {
-                    fragments.emplace(len_last_piece, new Fragment(f->seq.substr(start, len_last_piece), true));
+                    nPrunedFragments++;
                 }
             }
 
-            BlastSeqLocFree(seg_locs);
             delete f;
             f = NULL;
             if (!fragments.empty()) {
@@ -783,6 +833,57 @@ Fragment *TransSearcher::getNextFragment(unsigned int min_score) {
     return f;
 }
 
+bool TransSearcher::mayBeLowComplexity(const std::string &s) {
+    // SEG only masks around windows whose entropy is <= locut. The entropy of a window of length w is
+    // log2(w) - sum(c * log2(c)) / w over the letter counts c, so track that sum while sliding the window.
+    const size_t w = segWindow;
+    if (s.length() < w) {
+        return false;
+    }
+    unsigned int counts[20] = {0};
+    double sum = 0;
+    for (size_t i = 0; i < s.length(); i++) {
+        uint8_t c = (uint8_t) s[i];
+        if (aa2int[c] == 0 && c != 'A') { // letter outside of the 20 amino acids, leave it to SEG
+            return true;
+        }
+        sum += segCLogC[counts[aa2int[c]] + 1] - segCLogC[counts[aa2int[c]]];
+        counts[aa2int[c]]++;
+        if (i >= w) {
+            uint8_t o = aa2int[(uint8_t) s[i - w]];
+            sum += segCLogC[counts[o] - 1] - segCLogC[counts[o]];
+            counts[o]--;
+        }
+        if (i + 1 >= w && sum >= segTrigger) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<std::pair<size_t, size_t> > &TransSearcher::getSEGRegions(const std::string &s) {
+    auto it = segCache.find(s);
+    if (it != segCache.end()) {
+        return it->second;
+    }
+    if (segCache.size() >= (size_t) mOptions->segCacheLimit) {
+        segCache.clear();
+    }
+    std::vector<std::pair<size_t, size_t> > &regions = segCache[s];
+
+    std::string convertedseq = s;
+    for (size_t i = 0; i < convertedseq.length(); i++) {
+        convertedseq[i] = AMINOACID_TO_NCBISTDAA[(int) convertedseq[i]];
+    }
+    BlastSeqLoc *seg_locs = NULL;
+    SeqBufferSeg((Uint1 *) (convertedseq.data()), (Int4) convertedseq.length(), 0, tbwtfmiDB->tblast_seg_params, &seg_locs);
+    for (BlastSeqLoc *curr_loc = seg_locs; curr_loc != NULL; curr_loc = curr_loc->next) {
+        regions.emplace_back(curr_loc->ssr->left, curr_loc->ssr->right);
+    }
+    BlastSeqLocFree(seg_locs);
+    return regions;
+}
+
 void TransSearcher::getAllFragmentsBits(const std::string &line) {
 
     for (unsigned int i = 0; i <= 2; i++) {
@@ -799,9 +900,11 @@ void TransSearcher::getAllFragmentsBits(const std::string &line) {
                     unsigned int score = calcScore(translations[index]);
 
                     if (score >= mOptions->transSearch.minScore)
-                        fragments.emplace(score, new Fragment(translations[index]));
+                        fragments.emplace(score, new Fragment(newFragmentSeq(translations[index])));
+                    else
+                        nPrunedFragments++;
                 } else {
-                    fragments.emplace(translations[index].length(), new Fragment(translations[index]));
+                    fragments.emplace(translations[index].length(), new Fragment(newFragmentSeq(translations[index])));
                 }
             }
             translations[index].clear();
@@ -815,9 +918,11 @@ void TransSearcher::getAllFragmentsBits(const std::string &line) {
             if (mOptions->transSearch.mode == tGREEDY) {
                 unsigned int score = calcScore(translations[i]);
                 if (score >= mOptions->transSearch.minScore)
-                    fragments.emplace(score, new Fragment(translations[i]));
+                    fragments.emplace(score, new Fragment(newFragmentSeq(translations[i])));
+                else
+                    nPrunedFragments++;
             } else {
-                fragments.emplace(translations[i].length(), new Fragment(translations[i]));
+                fragments.emplace(translations[i].length(), new Fragment(newFragmentSeq(translations[i])));
             }
         }
         translations[i].clear();
@@ -833,9 +938,11 @@ void TransSearcher::getAllFragmentsBits(const std::string &line) {
                 if (mOptions->transSearch.mode == tGREEDY) {
                     unsigned int score = calcScore(translations[index]);
                     if (score >= mOptions->transSearch.minScore)
-                        fragments.emplace(score, new Fragment(translations[index]));
+                        fragments.emplace(score, new Fragment(newFragmentSeq(translations[index])));
+                    else
+                        nPrunedFragments++;
                 } else {
-                    fragments.emplace(translations[index].length(), new Fragment(translations[index]));
+                    fragments.emplace(translations[index].length(), new Fragment(newFragmentSeq(translations[index])));
                 }
             }
             translations[index].clear();
@@ -849,9 +956,11 @@ void TransSearcher::getAllFragmentsBits(const std::string &line) {
             if (mOptions->transSearch.mode == tGREEDY) {
                 unsigned int score = calcScore(translations[i]);
                 if (score >= mOptions->transSearch.minScore)
-                    fragments.emplace(score, new Fragment(translations[i]));
+                    fragments.emplace(score, new Fragment(newFragmentSeq(translations[i])));
+                else
+                    nPrunedFragments++;
             } else {
-                fragments.emplace(translations[i].length(), new Fragment(translations[i]));
+                fragments.emplace(translations[i].length(), new Fragment(newFragmentSeq(translations[i])));
             }
         }
     }
@@ -883,9 +992,11 @@ void TransSearcher::getLongestFragmentsBits(const std::string &line) {
                     unsigned int score = calcScore(translations[index]);
 
                     if (score >= mOptions->transSearch.minScore)
-                        fragments.emplace(score, new Fragment(translations[index]));
+                        fragments.emplace(score, new Fragment(newFragmentSeq(translations[index])));
+                    else
+                        nPrunedFragments++;
                 } else {
-                    fragments.emplace(translations[index].length(), new Fragment(translations[index]));
+                    fragments.emplace(translations[index].length(), new Fragment(newFragmentSeq(translations[index])));
                 }
             }
             translations[index].clear();
@@ -899,9 +1010,11 @@ void TransSearcher::getLongestFragmentsBits(const std::string &line) {
             if (mOptions->transSearch.mode == tGREEDY) {
                 unsigned int score = calcScore(translations[i]);
                 if (score >= mOptions->transSearch.minScore)
-                    fragments.emplace(score, new Fragment(translations[i]));
+                    fragments.emplace(score, new Fragment(newFragmentSeq(translations[i])));
+                else
+                    nPrunedFragments++;
             } else {
-                fragments.emplace(translations[i].length(), new Fragment(translations[i]));
+                fragments.emplace(translations[i].length(), new Fragment(newFragmentSeq(translations[i])));
             }
         }
         translations[i].clear();
@@ -917,9 +1030,11 @@ void TransSearcher::getLongestFragmentsBits(const std::string &line) {
                 if (mOptions->transSearch.mode == tGREEDY) {
                     unsigned int score = calcScore(translations[index]);
                     if (score >= mOptions->transSearch.minScore)
-                        fragments.emplace(score, new Fragment(translations[index]));
+                        fragments.emplace(score, new Fragment(newFragmentSeq(translations[index])));
+                    else
+                        nPrunedFragments++;
                 } else {
-                    fragments.emplace(translations[index].length(), new Fragment(translations[index]));
+                    fragments.emplace(translations[index].length(), new Fragment(newFragmentSeq(translations[index])));
                 }
             }
             translations[index].clear();
@@ -933,58 +1048,68 @@ void TransSearcher::getLongestFragmentsBits(const std::string &line) {
             if (mOptions->transSearch.mode == tGREEDY) {
                 unsigned int score = calcScore(translations[i]);
                 if (score >= mOptions->transSearch.minScore)
-                    fragments.emplace(score, new Fragment(translations[i]));
+                    fragments.emplace(score, new Fragment(newFragmentSeq(translations[i])));
+                else
+                    nPrunedFragments++;
             } else {
-                fragments.emplace(translations[i].length(), new Fragment(translations[i]));
+                fragments.emplace(translations[i].length(), new Fragment(newFragmentSeq(translations[i])));
             }
         }
     }
 }
 
-void TransSearcher::addAllMismatchVariantsAtPosSI(const Fragment *f, unsigned int pos, size_t erase_pos = std::string::npos, SI *si = NULL) {
+void TransSearcher::addAllMismatchVariantsAtPosSI(const Fragment *f, unsigned int pos, size_t erase_pos, SI *si, unsigned int min_score) {
 
     assert(mOptions->transSearch.mode == tGREEDY);
     assert(pos < erase_pos);
     assert(f->num_mm == 0 || pos < f->pos_lastmm);
+    assert(f->num_mm < MAX_FRAGMENT_MISMATCHES);
 
-    std::string fragment = f->seq; // make a copy to modify the sequence at pos
-    assert(fragment.length() >= mOptions->transSearch.minAAFragLength);
-    char origchar = fragment[pos];
+    // variants share the sequence of f, only the substitution and the new end are stored
+    assert(f->len >= mOptions->transSearch.minAAFragLength);
+    char origchar = f->base->seq[pos]; // substitutions of f are all behind pos
     assert(blosum_subst.count(origchar) > 0);
 
-    if (erase_pos != std::string::npos && erase_pos < fragment.length()) {
+    unsigned int end = f->len;
+    if (erase_pos != std::string::npos && erase_pos < end) {
         if (mOptions->debug)
             std::cerr << "Deleting from position " << erase_pos << "\n";
-        fragment.erase(erase_pos);
+        end = (unsigned int) erase_pos;
     }
 
     //calc score for whole sequence, so we can substract the diff for each substitution
-    unsigned int score = calcScore(fragment, f->diff) - blosum62diag[aa2int[(uint8_t) origchar]];
+    unsigned int score = calcScore(f->base->seq, 0, end, f->diff) - blosum62diag[aa2int[(uint8_t) origchar]];
     IndexType siarray[2], siarrayupd[2];
     siarray[0] = si->start;
     siarray[1] = si->start + (IndexType) si->len;
 
-    for (auto itv : blosum_subst.at(origchar)) {
+    const std::vector<char> & substs = blosum_subst.at(origchar);
+    for (size_t k = 0; k < substs.size(); k++) {
+        const char itv = substs[k];
         // we know the difference between score of original aa and substitution score, this
         // has to be subtracted when summing over all positions later
         // so we add this difference to the fragment
         int score_after_subst = score + b62[aa2int[(uint8_t) origchar]][aa2int[(uint8_t) itv]];
-        if (score_after_subst >= (int) best_match_score && score_after_subst >= (int) mOptions->transSearch.minScore) {
-            if (UpdateSI(tbwtfmiDB->tfmi, tbwtfmiDB->tastruct->trans[(size_t) itv], siarray, siarrayupd) != 0) {
-                fragment[pos] = itv;
-                int diff = b62[aa2int[(uint8_t) origchar]][aa2int[(uint8_t) itv]] - blosum62diag[aa2int[(uint8_t) itv]];
+        if (score_after_subst >= (int) min_score) {
+            if (UpdateSI(tfmi, tbwtfmiDB->tastruct->trans[(size_t) itv], siarray, siarrayupd) != 0) {
+                int diff = b62[aa2int[(uint8_t) origchar]][aa2int[(uint8_t) itv]] - blosum62diag[aa2int[(uint8_t) origchar]];
+                Fragment *v = new Fragment(f, end, pos, itv, f->diff + diff, siarrayupd[0], siarrayupd[1], si->ql + 1);
                 if (mOptions->debug)
-                    std::cerr << "Adding fragment   " << fragment << " with mismatch at pos " << pos << " ,diff " << f->diff + diff << ", max score " << score_after_subst << "\n";
-                fragments.emplace(score_after_subst, new Fragment(fragment, f->num_mm + 1, pos, f->diff + diff, siarrayupd[0], siarrayupd[1], si->ql + 1));
+                    std::cerr << "Adding fragment   " << v->str() << " with mismatch at pos " << pos << " ,diff " << f->diff + diff << ", max score " << score_after_subst << "\n";
+                fragments.emplace(score_after_subst, v);
             } else if (mOptions->debug) {
+                std::string fragment = f->str().substr(0, end);
                 fragment[pos] = itv;
                 std::cerr << "Skipping fragment " << fragment << " mismatch at pos " << pos << ", because " << itv << " is not a valid extension\n";
             }
         } else {
             if (mOptions->debug) {
+                std::string fragment = f->str().substr(0, end);
                 fragment[pos] = itv;
-                std::cerr << "Skipping fragment " << fragment << " and following fragments, because score is too low: " << score_after_subst << " < " << std::max(best_match_score, mOptions->transSearch.minScore) << "\n";
+                std::cerr << "Skipping fragment " << fragment << " and following fragments, because score is too low: " << score_after_subst << " < " << min_score << "\n";
             }
+            // substitutions are sorted by score, so none of the following ones can reach min_score either
+            nPrunedFragments += substs.size() - k;
             break;
         }
     }
@@ -1016,49 +1141,60 @@ unsigned int TransSearcher::calcScore(const std::string &s) {
     return score;
 }
 
-void TransSearcher::eval_match_scores(SI *si, Fragment *frag) {
-
-    if (!si)
-        return;
-
-    // eval the remaining same-length and shorter matches
-    if (si->samelen)
-        eval_match_scores(si->samelen, frag);
-    if (si->next && si->next->ql >= (int) mOptions->transSearch.minAAFragLength)
-        eval_match_scores(si->next, frag);
-    else if (si->next)
-        recursive_free_SI(si->next);
+void TransSearcher::flattenMatches(SI *si) {
+    // copy the matches down to the minimum length into matchSI, in the order the
+    // former recursive evaluation visited them: the same-length tails of all lengths
+    // (each tail reversed), followed by the heads from the shortest to the longest length.
+    // the copies are unlinked, their next and samelen must not be followed.
+    matchSI.clear();
+    const int minLen = (int) mOptions->transSearch.minAAFragLength;
+    for (SI *level = si; level && level->ql >= minLen; level = level->next) {
+        size_t first = matchSI.size();
+        for (SI *it = level->samelen; it; it = it->samelen) {
+            matchSI.push_back(*it);
+        }
+        std::reverse(matchSI.begin() + first, matchSI.end());
+    }
+    size_t heads = matchSI.size();
+    for (SI *level = si; level && level->ql >= minLen; level = level->next) {
+        matchSI.push_back(*level);
+    }
+    std::reverse(matchSI.begin() + heads, matchSI.end());
+}
 
-    unsigned int score = calcScore(frag->seq, si->qi, si->ql, frag->diff);
+unsigned int TransSearcher::maxMatchScore(const Fragment *frag) {
+    // the same matches as visited by eval_match_scores
+    unsigned int max_score = 0;
+    for (const auto & it : matchSI) {
+        max_score = std::max(max_score, calcScore(frag->base->seq, it.qi, it.ql, frag->diff));
+    }
+    return max_score;
+}
 
-    if (mOptions->debug)
-        std::cerr << "Match " << frag->seq.substr(si->qi, si->ql) << " (length=" << (unsigned int) si->ql << " score=" << score << " num_mm=" << frag->num_mm << ")\n";
+void TransSearcher::eval_match_scores(Fragment *frag) {
+    for (const auto & it : matchSI) {
+        unsigned int score = calcScore(frag->base->seq, it.qi, it.ql, frag->diff);
 
-    if (score < mOptions->transSearch.minScore) {
-        free(si);
-        si = NULL;
-        return;
-    }
+        if (mOptions->debug)
+            std::cerr << "Match " << frag->str().substr(it.qi, it.ql) << " (length=" << (unsigned int) it.ql << " score=" << score << " num_mm=" << frag->num_mm << ")\n";
 
-    if (score > best_match_score) {
-        for (auto itm : best_matches_SI) {
-            //recursive_free_SI(itm);
-            free(itm);
+        if (score < mOptions->transSearch.minScore) {
+            continue;
         }
-        best_matches_SI.clear();
-        best_matches_SI.push_back(si);
-        best_match_score = score;
-        if (mOptions->verbose) {
-            best_matches.clear();
-            best_matches.push_back(frag->seq.substr(si->qi, si->ql));
+
+        if (score > best_match_score) {
+            best_matches_SI.clear();
+            best_matches_SI.push_back(it);
+            best_match_score = score;
+            if (mOptions->verbose) {
+                best_matches.clear();
+                best_matches.push_back(frag->str().substr(it.qi, it.ql));
+            }
+        } else if (score == best_match_score && best_matches_SI.size() < mOptions->transSearch.max_matches_SI) {
+            best_matches_SI.push_back(it);
+            if (mOptions->verbose)
+                best_matches.push_back(frag->str().substr(it.qi, it.ql));
         }
-    } else if (score == best_match_score && best_matches_SI.size() < mOptions->transSearch.max_matches_SI) {
-        best_matches_SI.push_back(si);
-        if (mOptions->verbose)
-            best_matches.push_back(frag->seq.substr(si->qi, si->ql));
-    } else {
-        free(si);
-        si = NULL;
     }
 }
 
@@ -1070,6 +1206,8 @@ void TransSearcher::flush_output(){
 }
 
 void TransSearcher::clearFragments() {
+    // whatever is left could not beat the best match anymore
+    nPrunedFragments += fragments.size();
     while (!fragments.empty()) {
         auto it = fragments.begin();
         Fragment *f = it->second;
@@ -1077,6 +1215,7 @@ void TransSearcher::clearFragments() {
         fragments.erase(it);
     }
     fragments.clear();
+    nFragmentSeqs = 0;
 }
 
 inline uint8_t TransSearcher::codon_to_int(const char *codon) {
@@ -1096,52 +1235,56 @@ void TransSearcher::classify_greedyblosum() {
         Fragment *t = getNextFragment(best_match_score);
         if (!t)
             break;
-        const std::string fragment = t->seq;
-        const size_t length = fragment.length();
+        const size_t length = t->len;
         const unsigned int num_mm = t->num_mm;
 
         if (mOptions->debug) {
-            std::cerr << "Searching fragment " << fragment << " (" << length << "," << num_mm << "," << t->diff << ")"
+            std::cerr << "Searching fragment " << t->str() << " (" << length << "," << num_mm << "," << t->diff << ")"
                     << "\n";
         }
-        char *seq = new char[length + 1];
-        std::strcpy(seq, fragment.c_str());
-        //stopped here.
-        translate2numbers((uchar *) seq, (unsigned int) length, tbwtfmiDB->tastruct);
+        // variants are only extended left of their last substitution,
+        // so the unsubstituted encoding of the shared sequence can be searched directly
+        char *seq = const_cast<char *> (t->base->encoded(tbwtfmiDB->tastruct));
         SI *si = NULL;
+        nSearchedFragments++;
         if (num_mm > 0) {
             if (num_mm == mOptions->transSearch.misMatches) { //after last mm has been done, we need to have at least reached the min_length
-                si = maxMatches_withStart(tbwtfmiDB->tfmi, seq, (unsigned int) length, mOptions->transSearch.minAAFragLength, 1, t->si0, t->si1, t->matchlen);
+                si = maxMatches_withStart(tfmi, seq, (unsigned int) length, mOptions->transSearch.minAAFragLength, 1, t->si0, t->si1, t->matchlen);
             } else {
-                si = maxMatches_withStart(tbwtfmiDB->tfmi, seq, (unsigned int) length, t->matchlen, 1, t->si0, t->si1, t->matchlen);
+                si = maxMatches_withStart(tfmi, seq, (unsigned int) length, t->matchlen, 1, t->si0, t->si1, t->matchlen);
             }
         } else {
-            si = maxMatches(tbwtfmiDB->tfmi, seq, (unsigned int) length, mOptions->transSearch.seedLength, 0); //initial matches
+            si = maxMatches(tfmi, seq, (unsigned int) length, mOptions->transSearch.seedLength, 0); //initial matches
         }
         if (!si) { // no match for this fragment
             if (mOptions->debug)
                 std::cerr << "No match for this fragment."
                     << "\n";
-            delete[] seq;
             delete t;
             continue; // continue with the next fragment
         }
         if (mOptions->debug)
             std::cerr << "Longest match has length " << (unsigned int) si->ql << "\n";
 
+        flattenMatches(si);
+
         if (mOptions->transSearch.misMatches > 0 && num_mm < mOptions->transSearch.misMatches) {
+            // the matches of this fragment raise best_match_score to at least their best score once
+            // evaluated below, variants that can not reach it would only be queued and never searched
+            unsigned int min_score = std::max(best_match_score, mOptions->transSearch.minScore);
+            min_score = std::max(min_score, maxMatchScore(t));
             SI *si_it = si;
             while (si_it) {
                 unsigned int match_right_end = si_it->qi + si_it->ql - 1;
                 if (num_mm > 0)
                     assert(match_right_end == length - 1); // greedy matches end always at the end
                 if (mOptions->debug)
-                    std::cerr << "Match from " << si_it->qi << " to " << match_right_end << ": " << fragment.substr(si_it->qi, match_right_end - si_it->qi + 1) << " (" << si_it->ql << ")\n";
+                    std::cerr << "Match from " << si_it->qi << " to " << match_right_end << ": " << t->str().substr(si_it->qi, match_right_end - si_it->qi + 1) << " (" << si_it->ql << ")\n";
                 if (si_it->qi > 0 && match_right_end + 1 >= mOptions->transSearch.minAAFragLength) {
                     //1. match must end before beginning of fragment, i.e. it is extendable
                     //2. remaining fragment, from zero to end of current match, must be longer than minimum length of accepted matches
                     const size_t erase_pos = (match_right_end < length - 1) ? match_right_end + 1 : std::string::npos;
-                    addAllMismatchVariantsAtPosSI(t, (unsigned int) (si_it->qi - 1), erase_pos, si_it);
+                    addAllMismatchVariantsAtPosSI(t, (unsigned int) (si_it->qi - 1), erase_pos, si_it, min_score);
                 }
                 si_it = si_it->samelen ? si_it->samelen : si_it->next;
             }
@@ -1151,15 +1294,14 @@ void TransSearcher::classify_greedyblosum() {
             if (mOptions->debug) {
                 std::cerr << "Match of length " << si->ql << " is too short\n";
             }
-            delete[] seq;
             delete t;
             recursive_free_SI(si);
             continue; // continue with the next fragment
         }
+        recursive_free_SI(si);
 
-        eval_match_scores(si, t);
+        eval_match_scores(t);
 
-        delete[] seq;
         delete t;
 
     } // end current fragment
@@ -1177,22 +1319,15 @@ void TransSearcher::classify_greedyblosum() {
             std::cerr << "E-value = " << Evalue << std::endl;
 
         if (Evalue > mOptions->transSearch.minEvalue) {
-            for (auto itm : best_matches_SI) {
-                free(itm);
-            }
             return;
         }
     }
 
-    match_ids.clear();
+    clearMatchSeqs();
 
-    for (auto itm : best_matches_SI) {
+    for (const auto & itm : best_matches_SI) {
         ids_from_SI(itm);
     }
-    for (auto itm : best_matches_SI) {
-        //recursive_free_SI(itm);
-        free(itm);
-    }
 }
 
 void TransSearcher::classify_length() {
@@ -1204,25 +1339,22 @@ void TransSearcher::classify_length() {
         Fragment *t = getNextFragment(longest_match_length);
         if (!t)
             break; // searched all fragments that are longer than best match length
-        const std::string fragment = t->seq;
-        const unsigned int length = (unsigned int) fragment.length();
+        const std::string & fragment = t->base->seq;
+        const unsigned int length = t->len;
 
         if (mOptions->debug) {
             std::cerr << "Searching fragment " << fragment << " (" << length << ")"
                     << "\n";
         }
-        char *seq = new char[length + 1];
-        std::strcpy(seq, fragment.c_str());
-
-        translate2numbers((uchar *) seq, length, tbwtfmiDB->tastruct);
+        char *seq = const_cast<char *> (t->base->encoded(tbwtfmiDB->tastruct));
+        nSearchedFragments++;
         //use longest_match_length here too:
-        SI *si = maxMatches(tbwtfmiDB->tfmi, seq, length, std::max(mOptions->transSearch.minAAFragLength, longest_match_length), 1);
+        SI *si = maxMatches(tfmi, seq, length, std::max(mOptions->transSearch.minAAFragLength, longest_match_length), 1);
 
         if (!si) { // no match for this fragment
             if (mOptions->debug)
                 std::cerr << "No match for this fragment."
                     << "\n";
-            delete[] seq;
             delete t;
             continue; // continue with the next fragment
         }
@@ -1248,7 +1380,6 @@ void TransSearcher::classify_length() {
             recursive_free_SI(si);
             si = NULL;
         }
-        delete[] seq;
         delete t;
 
     } // end current fragment
@@ -1256,7 +1387,7 @@ void TransSearcher::classify_length() {
     if (longest_matches_SI.empty()) {
         return;
     }
-    match_ids.clear();
+    clearMatchSeqs();
     for (auto itm : longest_matches_SI) {
         ids_from_SI_recursive(itm);
     }
@@ -1283,29 +1414,32 @@ void TransSearcher::doProcess(){
 
 }
 
-uint32 * TransSearcher::postProcess() {
+int TransSearcher::postProcess() {
 
-    for (const auto & it : match_ids) {
-        //std::cout << it << " ";
-        auto itd = mOptions->mHomoSearchOptions.idDbMap.find(it);
-        if (itd != mOptions->mHomoSearchOptions.idDbMap.end()){
-            tmpIdFreqMap[itd->second]++;
+    for (const auto & it : matchSeqs) {
+        int orth = tbwtfmiDB->tseqOrth[it];
+        if (orth >= 0) {
+            if (readVotes[orth]++ == 0) votedIds.push_back(orth);
         }
     }
-    match_ids.clear();
-    auto tmpId = std::max_element(tmpIdFreqMap.begin(), tmpIdFreqMap.end(), 
-            [](const std::pair<const uint32 *, uint32> & p1, const std::pair<const uint32 *, uint32> & p2){
-                return p1.second < p2.second;
-            });
-    
-    idFreqSubMap[tmpId->first]++;
-    tmpIdFreqMap.clear();
-    return const_cast<uint32 *>(tmpId->first);
+    clearMatchSeqs();
+    if (votedIds.empty()) return -1;
+
+    // most voted ortholog, ties go to the lowest id
+    uint32 best = votedIds[0];
+    for (const auto & it : votedIds) {
+        if (readVotes[it] > readVotes[best] || (readVotes[it] == readVotes[best] && it < best)) best = it;
+    }
+    for (const auto & it : votedIds)
+        readVotes[it] = 0;
+    votedIds.clear();
+    idFreqSubVec[best]++;
+    return best;
 }
 
-void TransSearcher::transSearch(Read *item, uint32* & orthId) {
+void TransSearcher::transSearch(Read *item, int & orthIndex) {
+    nSearchedReads++;
     //matched_genids.clear();
-    tmpIdFreqMap.clear();
     query_len = static_cast<double> (item->length()) / 3.0;
     if (item->mSeq.length() >= mOptions->transSearch.minAAFragLength * 3) {
         if (mOptions->debug)
@@ -1330,13 +1464,13 @@ void TransSearcher::transSearch(Read *item, uint32* & orthId) {
     }
 
     clearFragments();
-    if(!match_ids.empty()){
-      orthId = postProcess(); 
+    if(!matchSeqs.empty()){
+      orthIndex = postProcess(); 
     }
 }
 
-void TransSearcher::transSearch(Read *item1, Read *item2, uint32* & orthId) {
-    tmpIdFreqMap.clear();
+void TransSearcher::transSearch(Read *item1, Read *item2, int & orthIndex) {
+    nSearchedReads++;
     query_len = static_cast<double> (item1->length()) / 3.0;
     if (item1->length() >= mOptions->transSearch.minAAFragLength * 3) {
         if (mOptions->debug)
@@ -1372,20 +1506,20 @@ void TransSearcher::transSearch(Read *item1, Read *item2, uint32* & orthId) {
     }
     clearFragments();
     
-    if (!match_ids.empty()) {
-        orthId = postProcess();
+    if (!matchSeqs.empty()) {
+        orthIndex = postProcess();
     }
 }
 
-void TransSearcher::ids_from_SI(SI *si) {
+void TransSearcher::ids_from_SI(const SI & si) {
     IndexType k, pos;
     int iseq;
-    for (k = si->start; k < si->start + si->len; ++k) {
-        if (match_ids.size() > mOptions->transSearch.max_match_ids) {
+    for (k = si.start; k < si.start + si.len; ++k) {
+        if (matchSeqs.size() > mOptions->transSearch.max_match_ids) {
             break;
         }
-        get_suffix(tbwtfmiDB->tfmi, tbwtfmiDB->tbwt->s, k, &iseq, &pos);
-        match_ids.insert(tbwtfmiDB->tbwt->s->ids[iseq]);
+        get_suffix(tfmi, tsa, k, &iseq, &pos);
+        addMatchSeq(iseq);
     }
 }
 
@@ -1395,33 +1529,35 @@ void TransSearcher::ids_from_SI_recursive(SI *si) {
         IndexType k, pos;
         int iseq;
         for (k = si_it->start; k < si_it->start + si_it->len; ++k) {
-            if (match_ids.size() > mOptions->transSearch.max_match_ids) {
+            if (matchSeqs.size() > mOptions->transSearch.max_match_ids) {
                 break;
             }
-            get_suffix(tbwtfmiDB->tfmi, tbwtfmiDB->tbwt->s, k, &iseq, &pos);
-            match_ids.insert(tbwtfmiDB->tbwt->s->ids[iseq]);
+            get_suffix(tfmi, tsa, k, &iseq, &pos);
+            addMatchSeq(iseq);
         } // end for
         si_it = si_it->samelen;
     } // end while all SI with same length
 }
 
-std::map<const uint32 *, uint32> TransSearcher::merge(std::vector<std::map<const uint32 *, uint32>> & list){
-    std::map<const uint32*, uint32> idFreqMap;
-    std::map<const uint32*, uint32>::iterator itt;
+void TransSearcher::clearMatchSeqs() {
+    for (const auto & it : matchSeqs)
+        seenSeqs[it >> 6] = 0;
+    matchSeqs.clear();
+}
+
+std::map<const uint32 *, uint32> TransSearcher::merge(std::vector<const std::vector<uint32> *> & list, Options * opt){
+    const auto & orthIdVec = opt->db->orthIdVec;
+    std::vector<uint32> total(orthIdVec.size(), 0);
     for(const auto & it : list){
-        for(const auto & itr : it){
-            if (idFreqMap.empty()) {
-                idFreqMap.insert(std::pair<const uint32*, uint32>(itr.first, itr.second));
-            } else {
-                itt = idFreqMap.find(itr.first);
-                if (itt == idFreqMap.end()) {
-                    idFreqMap.insert(std::pair<const uint32*, uint32>(itr.first, itr.second));
-                } else {
-                    itt->second += itr.second;
-                }
-            }
+        const uint32 * counts = it->data();
+        for(size_t i = 0; i < total.size(); i++){
+            total[i] += counts[i];
         }
     }
+    std::map<const uint32*, uint32> idFreqMap;
+    for(size_t i = 0; i < total.size(); i++){
+        if(total[i] > 0) idFreqMap.insert(std::make_pair(orthIdVec[i], total[i]));
+    }
     return idFreqMap; 
 }
 
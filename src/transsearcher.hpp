@@ -59,7 +59,18 @@ protected:
 
     std::string translations[6];
     std::multimap<unsigned int, Fragment *, std::greater<unsigned int>> fragments;
-    std::vector<SI *> best_matches_SI;
+    // sequences of the current read's fragments, reused across reads
+    std::vector<FragmentSeq *> fragmentSeqs;
+    size_t nFragmentSeqs = 0;
+
+    // SEG low complexity regions of recently checked fragments
+    std::unordered_map<std::string, std::vector<std::pair<size_t, size_t> > > segCache;
+    size_t segWindow = 0;
+    double segTrigger = 0;
+    std::vector<double> segCLogC;
+    // matches of the current fragment, flattened from the SI lists of the FM index search
+    std::vector<SI> matchSI;
+    std::vector<SI> best_matches_SI;
     std::vector<SI *> longest_matches_SI;
     std::vector<std::string> best_matches;
     std::vector<std::string> longest_fragments;
@@ -70,38 +81,70 @@ protected:
     uint32 uniq_mapped_reads = 0;
     uint32 multi_mapped_reads = 0;
 
+    // fragments that went to the FM index vs. those dropped by the score bound
+    uint64 nSearchedFragments = 0;
+    uint64 nPrunedFragments = 0;
+    uint64 nSearchedReads = 0;
+
     void clearFragments();
+    FragmentSeq * newFragmentSeq(const std::string &);
+    FragmentSeq * newFragmentSeq(const std::string &, size_t, size_t);
     unsigned int calcScore(const std::string &);
     unsigned int calcScore(const std::string &, int);
     unsigned int calcScore(const std::string &, size_t, size_t, int);
-    void addAllMismatchVariantsAtPosSI(const Fragment *, unsigned int, size_t, SI *); // used in Greedy mode
+    void addAllMismatchVariantsAtPosSI(const Fragment *, unsigned int, size_t, SI *, unsigned int); // used in Greedy mode
     Fragment * getNextFragment(unsigned int);
-    void eval_match_scores(SI *si, Fragment *);
+    bool mayBeLowComplexity(const std::string &);
+    const std::vector<std::pair<size_t, size_t> > & getSEGRegions(const std::string &);
+    void flattenMatches(SI *si);
+    unsigned int maxMatchScore(const Fragment *);
+    void eval_match_scores(Fragment *);
     void getAllFragmentsBits(const std::string & line);
     void getLongestFragmentsBits(const std::string & line);
     void flush_output();
     void preProcess();
     void doProcess();
-    uint32 * postProcess();
+    int postProcess();
 
 protected:
     void classify_length();
     void classify_greedyblosum();
-    void ids_from_SI(SI *);
+    void ids_from_SI(const SI &);
     void ids_from_SI_recursive(SI *);
-    std::set<char *> match_ids;
+    inline void addMatchSeq(int iseq) {
+        uint64_t bit = 1ULL << (iseq & 63);
+        if (!(seenSeqs[iseq >> 6] & bit)) {
+            seenSeqs[iseq >> 6] |= bit;
+            matchSeqs.push_back(iseq);
+        }
+    }
+    void clearMatchSeqs();
+    // sequences matched by the current read, each once, and a bit per sequence of the index marking them
+    std::vector<int> matchSeqs;
+    std::vector<uint64_t> seenSeqs;
     std::set<const uint32 *> matched_genids;
-    std::map<const uint32 *, uint32> tmpIdFreqMap;
-    std::map<const uint32 *, uint32> idFreqSubMap;
+    // reads assigned to each ortholog, indexed like db->orthIdVec
+    std::vector<uint32> idFreqSubVec;
+    // per-read votes: dense counts plus the orthologs touched, reset after each read
+    std::vector<uint32> readVotes;
+    std::vector<uint32> votedIds;
     Options * mOptions;   
     BwtFmiDB * tbwtfmiDB;
+    // the copy of the index on the NUMA node of this worker
+    FMI * tfmi;
+    suffixArray * tsa;
     
 public:
-    TransSearcher(Options * & opt, BwtFmiDB * & mBwtfmiDB);
-    void transSearch(Read * item, uint32* & orthId);
-    void transSearch(Read * item1, Read * item2, uint32* & orthId);
-    inline std::map<const uint32 *, uint32> getIdFreqSubMap(){return idFreqSubMap;};
-    static std::map<const uint32 *, uint32> merge(std::vector<std::map<const uint32*, uint32>> & list);
+    TransSearcher(Options * & opt, BwtFmiDB * & mBwtfmiDB, int worker = 0);
+    ~TransSearcher();
+    // orthIndex is set to the index in db->orthIdVec of the ortholog the read maps to, it is left as is for unmapped reads
+    void transSearch(Read * item, int & orthIndex);
+    void transSearch(Read * item1, Read * item2, int & orthIndex);
+    inline const std::vector<uint32> & getIdFreqSubVec(){return idFreqSubVec;};
+    inline uint64 getSearchedFragments(){return nSearchedFragments;};
+    inline uint64 getPrunedFragments(){return nPrunedFragments;};
+    inline uint64 getSearchedReads(){return nSearchedReads;};
+    static std::map<const uint32 *, uint32> merge(std::vector<const std::vector<uint32> *> & list, Options * opt);
 };
 
 
@@ -9,6 +9,12 @@
 #include "polyx.h"
 #include "nucleotidetree.h"
 #include "evaluator.h"
+#include "stagescheduler.h"
+#include "numaindex.h"
+#include "bgzfcompressor.h"
+#include "progressmeter.h"
+#include "memoryplan.h"
+#include "packsizer.h"
 #include <time.h>
 
 UnitTest::UnitTest(){
@@ -26,6 +32,14 @@ void UnitTest::run(){
     passed &= report(PolyX::test(), "PolyX::test");
     passed &= report(NucleotideTree::test(), "NucleotideTree::test");
     passed &= report(Evaluator::test(), "Evaluator::test");
+    passed &= report(FastqReader::test(), "FastqReader::test");
+    passed &= report(FastqReaderPair::test(), "FastqReaderPair::test");
+    passed &= report(StageScheduler::test(), "StageScheduler::test");
+    passed &= report(NumaIndex::test(), "NumaIndex::test");
+    passed &= report(BgzfCompressor::test(), "BgzfCompressor::test");
+    passed &= report(ProgressMeter::test(), "ProgressMeter::test");
+    passed &= report(MemoryPlan::test(), "MemoryPlan::test");
+    passed &= report(PackSizer::test(), "PackSizer::test");
     printf("\n==========================\n");
     printf("%s\n\n", passed?"ALL PASSED":"FAILED");
 }
@@ -0,0 +1,312 @@
+#include "uringreader.h"
+#include "util.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <sys/stat.h>
+#if defined(__linux__)
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <linux/io_uring.h>
+#endif
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+  #define URING_READER_SYSCALLS
+#endif
+
+#ifdef URING_READER_SYSCALLS
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+#endif
+
+bool UringReader::available() {
+#ifdef URING_READER_SYSCALLS
+    // containers often block the syscalls with seccomp, so ask the kernel once
+    static const bool ok = [] {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = uringSetup(1, &params);
+        if (fd < 0)
+            return false;
+        ::close(fd);
+        return true;
+    }();
+    return ok;
+#else
+    return false;
+#endif
+}
+
+bool UringReader::canUse(string filename) {
+    if (filename.empty() || filename == "/dev/stdin")
+        return false;
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+UringReader::UringReader(string filename, int depth, size_t blockSize) {
+    mFilename = filename;
+    mBlockSize = blockSize;
+    mNextOffset = 0;
+    mConsumed = 0;
+    mHead = 0;
+    mLatencyUs = 0;
+    mRingFd = -1;
+    mSqRing = NULL;
+    mCqRing = NULL;
+    mSqes = NULL;
+    mSqRingSize = mCqRingSize = mSqesSize = 0;
+
+    mFd = open(filename.c_str(), O_RDONLY);
+    if (mFd < 0)
+        error_exit("Failed to open file: " + filename);
+    struct stat st;
+    if (fstat(mFd, &st) != 0)
+        error_exit("Failed to stat file: " + filename);
+    mFileSize = st.st_size;
+
+#ifdef URING_READER_SYSCALLS
+    if (!setupRing(depth))
+        return;
+#else
+    mError = "io_uring is not supported on this platform";
+    return;
+#endif
+
+    mBlocks.resize(depth);
+    for (size_t i = 0; i < mBlocks.size(); i++) {
+        mBlocks[i].data.resize(mBlockSize);
+        mBlocks[i].active = false;
+        mBlocks[i].inFlight = false;
+        mBlocks[i].ready = false;
+        mBlocks[i].len = 0;
+        mBlocks[i].used = 0;
+    }
+    for (size_t i = 0; i < mBlocks.size(); i++) {
+        if (!submit(i))
+            return;
+    }
+}
+
+#ifdef URING_READER_SYSCALLS
+// maps the rings of a new io_uring instance, false with mError set if the kernel refuses
+bool UringReader::setupRing(int depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    mRingFd = uringSetup(depth, &params);
+    if (mRingFd < 0) {
+        mError = "Failed to set up io_uring for " + mFilename + ": " + strerror(errno);
+        return false;
+    }
+
+    mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+        mSqRingSize = mCqRingSize = max(mSqRingSize, mCqRingSize);
+    void* sqRing = mmap(NULL, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        mError = "Failed to map the io_uring submission ring";
+        return false;
+    }
+    mSqRing = sqRing;
+    if (singleMmap) {
+        mCqRing = mSqRing;
+    } else {
+        void* cqRing = mmap(NULL, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            mError = "Failed to map the io_uring completion ring";
+            return false;
+        }
+        mCqRing = cqRing;
+    }
+    mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        mError = "Failed to map the io_uring submission entries";
+        return false;
+    }
+    mSqes = sqes;
+
+    char* sq = (char*) mSqRing;
+    char* cq = (char*) mCqRing;
+    mSqHead = (unsigned*) (sq + params.sq_off.head);
+    mSqTail = (unsigned*) (sq + params.sq_off.tail);
+    mSqMask = (unsigned*) (sq + params.sq_off.ring_mask);
+    mSqArray = (unsigned*) (sq + params.sq_off.array);
+    mCqHead = (unsigned*) (cq + params.cq_off.head);
+    mCqTail = (unsigned*) (cq + params.cq_off.tail);
+    mCqMask = (unsigned*) (cq + params.cq_off.ring_mask);
+    mCqes = cq + params.cq_off.cqes;
+    return true;
+}
+#endif
+
+UringReader::~UringReader() {
+#ifdef URING_READER_SYSCALLS
+    // the kernel may still write into the blocks, let the reads in flight finish first
+    for (size_t i = 0; i < mBlocks.size(); i++) {
+        if (mBlocks[i].inFlight)
+            waitFor(i);
+    }
+    if (mSqes)
+        munmap(mSqes, mSqesSize);
+    if (mCqRing && mCqRing != mSqRing)
+        munmap(mCqRing, mCqRingSize);
+    if (mSqRing)
+        munmap(mSqRing, mSqRingSize);
+    if (mRingFd >= 0)
+        ::close(mRingFd);
+#endif
+    if (mFd >= 0)
+        ::close(mFd);
+}
+
+// queues the read of the next part of the file into the block of slot, false with mError set if the kernel refuses
+bool UringReader::submit(size_t slot) {
+    Block& block = mBlocks[slot];
+    block.used = 0;
+    block.len = 0;
+    block.ready = false;
+    block.inFlight = false;
+    block.active = false;
+    if (mNextOffset >= mFileSize)
+        return true;
+    block.active = true;
+    block.offset = mNextOffset;
+    mNextOffset += mBlockSize;
+    block.submitted = std::chrono::steady_clock::now();
+#ifdef URING_READER_SYSCALLS
+    unsigned tail = *mSqTail;
+    unsigned index = tail & *mSqMask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*) mSqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    // READV is there since the first io_uring kernels, READ only since 5.6
+    block.iov.iov_base = block.data.data();
+    block.iov.iov_len = min(mBlockSize, mFileSize - block.offset);
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = mFd;
+    sqe->off = block.offset;
+    sqe->addr = (unsigned long) &block.iov;
+    sqe->len = 1;
+    sqe->user_data = slot;
+    mSqArray[index] = index;
+    __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+    if (uringEnter(mRingFd, 1, 0, 0) < 0) {
+        mError = "Failed to submit a read of " + mFilename + ": " + strerror(errno);
+        return false;
+    }
+    block.inFlight = true;
+#endif
+    return true;
+}
+
+// reaps completions until the read of slot is done
+void UringReader::waitFor(size_t slot) {
+#ifdef URING_READER_SYSCALLS
+    while (mBlocks[slot].inFlight) {
+        unsigned head = *mCqHead;
+        if (head == __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE)) {
+            if (uringEnter(mRingFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                error_exit("Failed to wait for a read of " + mFilename + ": " + strerror(errno));
+            continue;
+        }
+        struct io_uring_cqe* cqe = (struct io_uring_cqe*) mCqes + (head & *mCqMask);
+        Block& block = mBlocks[cqe->user_data];
+        if (cqe->res < 0)
+            error_exit("Failed to read file: " + mFilename + ": " + strerror(-cqe->res));
+        block.len = cqe->res;
+        block.inFlight = false;
+        __atomic_store_n(mCqHead, head + 1, __ATOMIC_RELEASE);
+    }
+#endif
+    Block& block = mBlocks[slot];
+    // a short read before the end of the file, e.g. from network storage, is completed in place
+    size_t expected = min(mBlockSize, mFileSize - block.offset);
+    while (block.len < expected) {
+        ssize_t n = pread(mFd, block.data.data() + block.len, expected - block.len, block.offset + block.len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            error_exit("Failed to read file: " + mFilename);
+        block.len += n;
+    }
+    if (mLatencyUs > 0)
+        std::this_thread::sleep_until(block.submitted + std::chrono::microseconds(mLatencyUs));
+    block.ready = true;
+}
+
+size_t UringReader::read(char* buf, size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        Block& block = mBlocks[mHead];
+        // the blocks are handed out in file order, so an idle head means the whole file was
+        if (!block.active)
+            break;
+        if (!block.ready)
+            waitFor(mHead);
+        size_t n = min(len - copied, block.len - block.used);
+        memcpy(buf + copied, block.data.data() + block.used, n);
+        copied += n;
+        block.used += n;
+        if (block.used == block.len) {
+            if (!submit(mHead))
+                error_exit(mError);
+            mHead = (mHead + 1) % mBlocks.size();
+        }
+    }
+    mConsumed += copied;
+    return copied;
+}
+
+void UringReader::benchmark(string filename, int depth, int latencyUs) {
+    if (!canUse(filename))
+        error_exit("the io_uring benchmark needs a regular file: " + filename);
+    if (!available())
+        error_exit("io_uring is not available on this system");
+    const size_t blockSize = 1<<20;
+    vector<char> buf(blockSize);
+    // a first pass puts the file into the page cache, so both readers see the same storage plus the latency
+    for (int pass = 0; pass < 2; pass++) {
+        FILE* fp = fopen(filename.c_str(), "rb");
+        if (fp == NULL)
+            error_exit("Failed to open file: " + filename);
+        size_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            if (pass > 0 && latencyUs > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(latencyUs));
+            size_t n = fread(buf.data(), 1, blockSize, fp);
+            total += n;
+            if (n < blockSize)
+                break;
+        }
+        fclose(fp);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (pass > 0)
+            cerr << "fread:    " << total << " bytes in " << seconds << " seconds, " << (seconds > 0 ? total / seconds / 1e9 : 0) << " GB/s" << endl;
+    }
+    UringReader reader(filename, depth, blockSize);
+    if (!reader.ok())
+        error_exit(reader.error());
+    reader.mLatencyUs = latencyUs;
+    // the reads queued by the constructor started before the latency was set, start over
+    for (size_t i = 0; i < reader.mBlocks.size(); i++) {
+        if (reader.mBlocks[i].inFlight)
+            reader.waitFor(i);
+        reader.mBlocks[i].submitted = std::chrono::steady_clock::now();
+    }
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (size_t n = reader.read(buf.data(), blockSize))
+        total += n;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cerr << "io_uring: " << total << " bytes in " << seconds << " seconds, " << (seconds > 0 ? total / seconds / 1e9 : 0) << " GB/s with "
+            << depth << " reads in flight, " << latencyUs << " us added to every read" << endl;
+}
@@ -0,0 +1,91 @@
+#ifndef URING_READER_H
+#define URING_READER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <sys/uio.h>
+
+using namespace std;
+
+// the most entries the kernel allows in one ring, IORING_MAX_ENTRIES
+static const int URING_MAX_DEPTH = 32768;
+
+// reads a regular file sequentially through Linux io_uring, keeping up to depth reads of
+// blockSize bytes in flight ahead of the caller, which hides the per-read latency of network storage.
+// the ring is set up with raw syscalls, so no liburing is needed.
+// callers check available() and canUse() first, and ok() after constructing, and keep their fread/gzread path otherwise
+class UringReader {
+public:
+    UringReader(string filename, int depth, size_t blockSize = 1<<20);
+    ~UringReader();
+
+    // false if the ring could not be set up, e.g. for the limits of a container or a depth the kernel refuses,
+    // with the reason in error(). the reader must not be used then
+    inline bool ok() {return mError.empty();}
+    inline string error() {return mError;}
+    // copies the next bytes of the file into buf, less than len only at the end of the file
+    size_t read(char* buf, size_t len);
+    // bytes handed out by read() so far, safe to call from other threads
+    inline size_t offset() {return mConsumed;}
+
+    // whether this kernel lets us set up a ring, probed once
+    static bool available();
+    // a regular file, not stdin or a pipe
+    static bool canUse(string filename);
+    // reads filename with fread and with io_uring, adding latencyUs to every read, and reports the throughput
+    static void benchmark(string filename, int depth, int latencyUs);
+
+private:
+    bool setupRing(int depth);
+    bool submit(size_t slot);
+    void waitFor(size_t slot);
+
+private:
+    struct Block {
+        vector<char> data;
+        size_t offset;
+        size_t len;
+        size_t used;
+        struct iovec iov;
+        // holds, or will hold once read, a part of the file not handed out yet
+        bool active;
+        bool inFlight;
+        bool ready;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    string mFilename;
+    string mError;
+    int mFd;
+    size_t mFileSize;
+    size_t mBlockSize;
+    size_t mNextOffset;
+    atomic<size_t> mConsumed;
+    vector<Block> mBlocks;
+    size_t mHead;
+    // added to every read by the benchmark, a stand-in for slow storage
+    int mLatencyUs;
+
+    // the rings shared with the kernel
+    int mRingFd;
+    void* mSqRing;
+    size_t mSqRingSize;
+    void* mCqRing;
+    size_t mCqRingSize;
+    void* mSqes;
+    size_t mSqesSize;
+    unsigned* mSqHead;
+    unsigned* mSqTail;
+    unsigned* mSqMask;
+    unsigned* mSqArray;
+    unsigned* mCqHead;
+    unsigned* mCqTail;
+    unsigned* mCqMask;
+    void* mCqes;
+};
+
+#endif
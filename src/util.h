@@ -656,6 +656,20 @@ inline std::string convertSeconds(const T & t) {
     return ss.str();
 }
 
+// how far the loading is into the input file and the time left at the current speed,
+// appended to the "loaded xM reads" log
+inline std::string loadingProgress(size_t bytesRead, size_t bytesTotal, long estimatedReads, time_t start) {
+    if (bytesRead == 0 || bytesTotal == 0 || bytesRead > bytesTotal)
+        return "";
+    double fraction = (double) bytesRead / (double) bytesTotal;
+    std::stringstream ss;
+    ss << ", " << (int) (fraction * 100) << "%";
+    if (estimatedReads > 0)
+        ss << " of about " << (estimatedReads + 500000) / 1000000 << "M";
+    ss << ", " << convertSeconds(difftime(time(NULL), start) * (1 - fraction) / fraction) << " left";
+    return ss.str();
+}
+
 template<typename T>
 vector<T> sliceVec(vector<T> vec, int x, int y) {
     auto start = vec.begin() + x;
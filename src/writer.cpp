@@ -3,10 +3,12 @@
 #include "fastqreader.h"
 #include <string.h>
 
-Writer::Writer(string filename, int compression) {
+Writer::Writer(string filename, int compression, int compressThreads) {
     mCompression = compression;
+    mCompressThreads = compressThreads;
     mFilename = filename;
     mZipFile = NULL;
+    mBgzf = NULL;
     mZipped = false;
     haveToClose = true;
     init();
@@ -14,6 +16,7 @@ Writer::Writer(string filename, int compression) {
 
 Writer::Writer(ofstream* stream) {
     mZipFile = NULL;
+    mBgzf = NULL;
     mZipped = false;
     mOutStream = stream;
     haveToClose = false;
@@ -22,6 +25,7 @@ Writer::Writer(ofstream* stream) {
 Writer::Writer(gzFile gzfile) {
     mOutStream = NULL;
     mZipFile = gzfile;
+    mBgzf = NULL;
     mZipped = true;
     haveToClose = false;
 }
@@ -37,7 +41,10 @@ string Writer::filename() {
 }
 
 void Writer::init() {
-    if (ends_with(mFilename, ".gz")) {
+    if (ends_with(mFilename, ".gz") && mCompressThreads > 1) {
+        mBgzf = new BgzfCompressor(mFilename, mCompression, mCompressThreads);
+        mZipped = true;
+    } else if (ends_with(mFilename, ".gz")) {
         mZipFile = gzopen(mFilename.c_str(), "w");
         gzsetparams(mZipFile, mCompression, Z_DEFAULT_STRATEGY);
         gzbuffer(mZipFile, 1024 * 1024);
@@ -54,7 +61,9 @@ bool Writer::writeLine(string& linestr) {
     size_t size = linestr.length();
     size_t written;
     bool status;
-    if (mZipped) {
+    if (mBgzf) {
+        status = mBgzf->write(line, size) && mBgzf->write("\n", 1);
+    } else if (mZipped) {
         written = gzwrite(mZipFile, line, size);
         gzputc(mZipFile, '\n');
         status = size == written;
@@ -72,7 +81,9 @@ bool Writer::writeString(string& str) {
     size_t size = str.length();
     size_t written;
     bool status;
-    if (mZipped) {
+    if (mBgzf) {
+        status = mBgzf->write(strdata, size);
+    } else if (mZipped) {
         written = gzwrite(mZipFile, strdata, size);
         status = size == written;
     } else {
@@ -87,7 +98,9 @@ bool Writer::write(char* strdata, size_t size) {
     size_t written;
     bool status;
 
-    if (mZipped) {
+    if (mBgzf) {
+        status = mBgzf->write(strdata, size);
+    } else if (mZipped) {
         written = gzwrite(mZipFile, strdata, size);
         status = size == written;
     } else {
@@ -98,7 +111,11 @@ bool Writer::write(char* strdata, size_t size) {
 }
 
 void Writer::close() {
-    if (mZipped) {
+    if (mBgzf) {
+        mBgzf->close();
+        delete mBgzf;
+        mBgzf = NULL;
+    } else if (mZipped) {
         if (mZipFile) {
             gzflush(mZipFile, Z_FINISH);
             gzclose(mZipFile);
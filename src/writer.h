@@ -9,6 +9,7 @@
   #include "zlib/zlib.h"
 #endif
 #include "common.h"
+#include "bgzfcompressor.h"
 #include <iostream>
 #include <fstream>
 
@@ -16,7 +17,8 @@ using namespace std;
 
 class Writer{
 public:
-	Writer(string filename, int compression = 3);
+	// with more than one compression thread a .gz file is written as BGZF by a pool of threads
+	Writer(string filename, int compression = 3, int compressThreads = 1);
 	Writer(ofstream* stream);
 	Writer(gzFile gzfile);
 	~Writer();
@@ -36,6 +38,8 @@ private:
 private:
 	string mFilename;
 	gzFile mZipFile;
+	BgzfCompressor* mBgzf;
+	int mCompressThreads;
 	ofstream* mOutStream;
 	bool mZipped;
 	int mCompression;
@@ -8,50 +8,54 @@ WriterThread::WriterThread(Options* & opt, string filename){
 
     mWriter1 = NULL;
 
-    mInputCounter = 0;
-    mOutputCounter = 0;
     mInputCompleted = false;
+    mDepth = opt->writerQueueDepth > 0 ? opt->writerQueueDepth : 1;
     mFilename = filename;
-
-    mRingBuffer = new char*[PACK_NUM_LIMIT];
-    memset(mRingBuffer, 0, sizeof(char*) * PACK_NUM_LIMIT);
-    mRingBufferSizes = new size_t[PACK_NUM_LIMIT];
-    memset(mRingBufferSizes, 0, sizeof(size_t) * PACK_NUM_LIMIT);
     initWriter(filename);
 }
 
 WriterThread::~WriterThread() {
     cleanup();
-    delete mRingBuffer;
 }
 
 bool WriterThread::isCompleted() 
 {
-    return mInputCompleted && (mOutputCounter == mInputCounter);
+    std::lock_guard<std::mutex> lock(mtx);
+    return mInputCompleted && mQueue.empty();
 }
 
 bool WriterThread::setInputCompleted() {
-    mInputCompleted = true;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        mInputCompleted = true;
+    }
+    mNotEmpty.notify_all();
     return true;
 }
 
-void WriterThread::output(){
-    if(mOutputCounter >= mInputCounter) {
-        usleep(100);
-    }
-    while( mOutputCounter < mInputCounter) 
+bool WriterThread::output(){
+    std::deque<string> batch;
     {
-        mWriter1->write(mRingBuffer[mOutputCounter], mRingBufferSizes[mOutputCounter]);
-        delete mRingBuffer[mOutputCounter];
-        mRingBuffer[mOutputCounter] = NULL;
-        mOutputCounter++;
+        std::unique_lock<std::mutex> lock(mtx);
+        mNotEmpty.wait(lock, [this] {return mInputCompleted || !mQueue.empty();});
+        if(mQueue.empty())
+            return false;
+        // everything queued is written outside the lock, the workers can queue more meanwhile
+        batch.swap(mQueue);
     }
+    mNotFull.notify_all();
+    for(size_t i = 0; i < batch.size(); i++)
+        mWriter1->write(const_cast<char*>(batch[i].data()), batch[i].size());
+    return true;
 }
 
-void  WriterThread::input(char* data, size_t size){
-    mRingBuffer[mInputCounter] = data;
-    mRingBufferSizes[mInputCounter] = size;
-    mInputCounter++;
+void WriterThread::input(string&& data){
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        mNotFull.wait(lock, [this] {return mQueue.size() < mDepth;});
+        mQueue.push_back(std::move(data));
+    }
+    mNotEmpty.notify_one();
 }
 
 void WriterThread::cleanup() {
@@ -67,7 +71,7 @@ void WriterThread::deleteWriter() {
 
 void WriterThread::initWriter(string filename1) {
     deleteWriter();
-    mWriter1 = new Writer(filename1, mOptions->compression);
+    mWriter1 = new Writer(filename1, mOptions->compression, mOptions->compressThreads);
 }
 
 void WriterThread::initWriter(ofstream* stream) {
@@ -81,5 +85,6 @@ void WriterThread::initWriter(gzFile gzfile) {
 }
 
 long WriterThread::bufferLength(){
-    return mInputCounter - mOutputCounter;
+    std::lock_guard<std::mutex> lock(mtx);
+    return mQueue.size();
 }
@@ -9,9 +9,14 @@
 #include "options.h"
 #include <atomic>
 #include <mutex>
+#include <deque>
+#include <condition_variable>
 
 using namespace std;
 
+// writes the output of the worker threads to one file on its own thread.
+// the workers hand over their output strings by move, at most writerQueueDepth of them wait in the queue,
+// and input() blocks while it is full, which holds back the workers and through them the reader
 class WriterThread{
 public:
     WriterThread(Options* & opt, string filename);
@@ -24,8 +29,10 @@ public:
     void cleanup();
 
     bool isCompleted();
-    void output();
-    void input(char* data, size_t size);
+    // writes what is queued, waiting for it if needed, false once the input is completed and all is written
+    bool output();
+    // takes the buffer over, data is left empty
+    void input(string&& data);
     bool setInputCompleted();
 
     long bufferLength();
@@ -39,14 +46,13 @@ private:
     Options* mOptions;
     string mFilename;
 
-    // for spliting output
     bool mInputCompleted;
-    atomic_long mInputCounter;
-    atomic_long mOutputCounter;
-    char** mRingBuffer;
-    size_t* mRingBufferSizes;
+    std::deque<string> mQueue;
+    size_t mDepth;
 
     mutex mtx;
+    condition_variable mNotEmpty;
+    condition_variable mNotFull;
 
 };
 